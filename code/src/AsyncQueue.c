@@ -0,0 +1,351 @@
+/*
+ * AsyncQueue.c
+ *
+ * Queue with a continuation API and the reference executor resuming its callbacks.
+ *
+ * An operation which cannot complete at once is kept in the queue as a waiter: a deq on an empty queue waits for the next
+ * element, which the enq hands over directly, and an enq on a full queue waits for the next deq to move its element into the
+ * freed slot. Completed operations are posted to the executor of their caller and their callbacks run there, never inside the
+ * queue's mutex nor on the stack of the operation which completed them.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "AsyncQueue.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function prints the error message and terminates the program with EXIT_FAILURE status. The structure is left as it is,
+ * since the executor and the queue may be locked by the failing thread.
+*/
+static void cleanup_exit(char *error_mesg) {
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function appending a task to a list.
+*/
+static void list_append(AsyncTask** head, AsyncTask** tail, AsyncTask* task) {
+    task->next = NULL;
+    if (*tail == NULL) {
+        *head = task;
+    } else {
+        (*tail)->next = task;
+    }
+    *tail = task;
+}
+
+/**
+ * Private function removing the first task of a non-empty list.
+*/
+static AsyncTask* list_pop(AsyncTask** head, AsyncTask** tail) {
+    AsyncTask *task = *head;
+    *head = task->next;
+    if (*head == NULL) {
+        *tail = NULL;
+    }
+    return task;
+}
+
+/**
+ * Private function freeing every task of a list.
+*/
+static void list_free(AsyncTask* task) {
+    while (task != NULL) {
+        AsyncTask *next = task->next;
+        free(task);
+        task = next;
+    }
+}
+
+/**
+ * Private function allocating a task.
+ * Returns the task, or NULL if memory runs out.
+*/
+static AsyncTask* new_task(AsyncExecutor* executor, AsyncCallback callback, void* element, void* ctx) {
+    AsyncTask *task = malloc(sizeof(AsyncTask));
+    if (task == NULL) {
+        perror("Error: Failed to allocate memory for AsyncTask");
+        return NULL;
+    }
+    task->callback = callback;
+    task->ctx = ctx;
+    task->element = element;
+    task->executor = executor;
+    task->next = NULL;
+    return task;
+}
+
+/**
+ * Private function posting a completed task to its executor, or freeing it when nobody waits for its callback.
+*/
+static void submit(AsyncTask* task) {
+    if (task == NULL) {
+        return;
+    }
+    if (task->callback == NULL) {
+        free(task);
+        return;
+    }
+    AsyncExecutor *executor = task->executor;
+    if (pthread_mutex_lock(&executor->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before posting a task");}
+    list_append(&executor->head, &executor->tail, task);
+    if (pthread_cond_signal(&executor->has_tasks)) { cleanup_exit("Error: pthread_cond_signal() failed for has_tasks");}
+    if (pthread_mutex_unlock(&executor->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after posting a task");}
+}
+
+/**
+ * Private function running and freeing every task of a list.
+ * Returns the number of tasks run.
+*/
+static int run_tasks(AsyncTask* task) {
+    int count = ZERO;
+    while (task != NULL) {
+        AsyncTask *next = task->next;
+        task->callback(task->element, task->ctx);
+        free(task);
+        task = next;
+        count++;
+    }
+    return count;
+}
+
+AsyncExecutor* new_AsyncExecutor(void) {
+
+    /** Allocate memory for the AsyncExecutor structure.*/
+    AsyncExecutor *this = malloc(sizeof(AsyncExecutor));
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for AsyncExecutor");
+        return NULL;
+    }
+    this->head = this->tail = NULL;
+    this->stopped = false;
+    if (pthread_mutex_init(&this->mutex, NULL) || pthread_cond_init(&this->has_tasks, NULL)) {
+        perror("Error: failed to initialize AsyncExecutor synchronization");
+        free(this);
+        return NULL;
+    }
+    return this;
+}
+
+bool AsyncExecutor_post(AsyncExecutor* this, AsyncCallback callback, void* element, void* ctx) {
+    if (callback == NULL) {
+        return false;
+    }
+    AsyncTask *task = new_task(this, callback, element, ctx);
+    if (task == NULL) {
+        return false;
+    }
+    submit(task);
+    return true;
+}
+
+int AsyncExecutor_poll(AsyncExecutor* this) {
+
+    /** Takes the whole run queue at once, so that tasks run without the mutex and new ones wait for the next call.*/
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before polling");}
+    AsyncTask *tasks = this->head;
+    this->head = this->tail = NULL;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after polling");}
+    return run_tasks(tasks);
+}
+
+void AsyncExecutor_run(AsyncExecutor* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before running");}
+    while (true) {
+        while (this->head == NULL && !this->stopped) {
+            if (pthread_cond_wait(&this->has_tasks, &this->mutex)) { cleanup_exit("Error: pthread_cond_wait() failed for has_tasks");}
+        }
+
+        /** Returns once stopped and every posted task has run, ready to run again.*/
+        if (this->head == NULL) {
+            this->stopped = false;
+            break;
+        }
+        AsyncTask *tasks = this->head;
+        this->head = this->tail = NULL;
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed before running tasks");}
+        run_tasks(tasks);
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed after running tasks");}
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after running");}
+}
+
+void AsyncExecutor_stop(AsyncExecutor* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before stopping");}
+    this->stopped = true;
+    if (pthread_cond_broadcast(&this->has_tasks)) { cleanup_exit("Error: pthread_cond_broadcast() failed for has_tasks");}
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after stopping");}
+}
+
+void AsyncExecutor_destroy(AsyncExecutor* this) {
+    /** Frees the tasks which have not run, then the executor.*/
+    list_free(this->head);
+    pthread_cond_destroy(&this->has_tasks);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
+
+AsyncQueue* new_AsyncQueue(int max_size) {
+
+    /** Checks that the given max_size is a valid maximum capacity.*/
+    if (max_size <= ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the AsyncQueue structure and its slots in one block.*/
+    AsyncQueue *this = malloc(sizeof(AsyncQueue) + Queue_storageSize(max_size));
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for AsyncQueue");
+        return NULL;
+    }
+    Queue_init(&this->queue, max_size, this + ONE);
+    this->deq_head = this->deq_tail = NULL;
+    this->enq_head = this->enq_tail = NULL;
+    if (pthread_mutex_init(&this->mutex, NULL)) {
+        perror("Error: failed to initialize AsyncQueue mutex");
+        free(this);
+        return NULL;
+    }
+    return this;
+}
+
+/**
+ * Private function offering an element, called with the mutex held: hands it to the oldest waiting deq, or puts it in the queue.
+ * Returns false if the queue is full, and sets resumed to the deq to post, if any.
+*/
+static bool offer(AsyncQueue* this, void* element, AsyncTask** resumed) {
+    *resumed = NULL;
+    if (this->deq_head != NULL) {
+        *resumed = list_pop(&this->deq_head, &this->deq_tail);
+        (*resumed)->element = element;
+        return true;
+    }
+    return Queue_enq(&this->queue, element);
+}
+
+/**
+ * Private function taking an element, called with the mutex held, and moving the oldest waiting enq into the freed slot.
+ * Returns the element, or NULL if the queue is empty, and sets resumed to the enq to post, if any.
+*/
+static void* take(AsyncQueue* this, AsyncTask** resumed) {
+    *resumed = NULL;
+    if (Queue_isEmpty(&this->queue)) {
+        return NULL;
+    }
+    void *element = Queue_deq(&this->queue);
+    if (this->enq_head != NULL) {
+        *resumed = list_pop(&this->enq_head, &this->enq_tail);
+        Queue_enq(&this->queue, (*resumed)->element);
+    }
+    return element;
+}
+
+bool AsyncQueue_enqAsync(AsyncQueue* this, void* element, AsyncExecutor* executor, AsyncCallback callback, void* ctx) {
+
+    /** Check that the element and the executor are not NULL.*/
+    if (element == NULL || executor == NULL) {
+        return false;
+    }
+    AsyncTask *task = new_task(executor, callback, element, ctx);
+    if (task == NULL) {
+        return false;
+    }
+
+    AsyncTask *resumed;
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before enqueueing");}
+    bool done = offer(this, element, &resumed);
+    if (!done) {
+        /** The queue is full: the enq waits for a deq to free a slot.*/
+        list_append(&this->enq_head, &this->enq_tail, task);
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after enqueueing");}
+
+    submit(resumed);
+    if (done) {
+        submit(task);
+    }
+    return true;
+}
+
+bool AsyncQueue_deqAsync(AsyncQueue* this, AsyncExecutor* executor, AsyncCallback callback, void* ctx) {
+
+    /** Check that the executor and the callback are not NULL, the dequeued element is only ever given to the callback.*/
+    if (executor == NULL || callback == NULL) {
+        return false;
+    }
+    AsyncTask *task = new_task(executor, callback, NULL, ctx);
+    if (task == NULL) {
+        return false;
+    }
+
+    AsyncTask *resumed;
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before dequeueing");}
+    task->element = take(this, &resumed);
+    bool done = task->element != NULL;
+    if (!done) {
+        /** The queue is empty: the deq waits for the next enq to hand its element over.*/
+        list_append(&this->deq_head, &this->deq_tail, task);
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after dequeueing");}
+
+    submit(resumed);
+    if (done) {
+        submit(task);
+    }
+    return true;
+}
+
+bool AsyncQueue_tryEnq(AsyncQueue* this, void* element) {
+    if (element == NULL) {
+        return false;
+    }
+    AsyncTask *resumed;
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before enqueueing");}
+    bool done = offer(this, element, &resumed);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after enqueueing");}
+    submit(resumed);
+    return done;
+}
+
+void* AsyncQueue_tryDeq(AsyncQueue* this) {
+    AsyncTask *resumed;
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before dequeueing");}
+    void *element = take(this, &resumed);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after dequeueing");}
+    submit(resumed);
+    return element;
+}
+
+int AsyncQueue_size(AsyncQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before getting the current size");}
+    int size = Queue_size(&this->queue);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after getting the current size");}
+    return size;
+}
+
+int AsyncQueue_waitingDeqs(AsyncQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_lock() failed before counting waiting deqs");}
+    int count = ZERO;
+    for (AsyncTask *task = this->deq_head; task != NULL; task = task->next) {
+        count++;
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit("Error: pthread_mutex_unlock() failed after counting waiting deqs");}
+    return count;
+}
+
+void AsyncQueue_destroy(AsyncQueue* this) {
+    /** Frees the waiting operations, then the mutex and the queue with its slots.*/
+    list_free(this->deq_head);
+    list_free(this->enq_head);
+    pthread_mutex_destroy(&this->mutex);
+    Queue_deinit(&this->queue);
+    free(this);
+}
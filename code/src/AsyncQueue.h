@@ -0,0 +1,155 @@
+/*
+ * AsyncQueue.h
+ *
+ * Module interface for a fixed-size Queue with a non-blocking continuation API, for event loops where a thread must never
+ * block: deqAsync and enqAsync register a callback which the queue resumes once data or space is available, and a small
+ * AsyncExecutor runs the resumed callbacks, so that thousands of logical consumers can wait without an OS thread each.
+ *
+ */
+
+#ifndef ASYNC_QUEUE_H_
+#define ASYNC_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "Queue.h"
+
+/*
+ * Continuation resumed by an AsyncExecutor. element is the dequeued element for a deq, the enqueued element for an enq,
+ * and ctx the context given with the callback.
+ */
+typedef void (*AsyncCallback)(void* element, void* ctx);
+
+typedef struct AsyncTask AsyncTask;
+typedef struct AsyncExecutor AsyncExecutor;
+typedef struct AsyncQueue AsyncQueue;
+
+/*
+ * Pending operation: a waiter while it sits in an AsyncQueue, then a task once posted to its executor, which frees it after running it.
+ */
+struct AsyncTask {
+    AsyncCallback callback;
+    void *ctx;
+
+    /** Element enqueued, or dequeued once the operation completed.*/
+    void *element;
+
+    /** Executor resuming the callback.*/
+    AsyncExecutor *executor;
+
+    /** Next task, in the executor's run queue or in the queue's list of waiters.*/
+    AsyncTask *next;
+};
+
+struct AsyncExecutor {
+
+    /** Mutex protecting the run queue, tasks may be posted from any thread.*/
+    pthread_mutex_t mutex;
+
+    /** Condition variable signalled when a task is posted or the executor is stopped.*/
+    pthread_cond_t has_tasks;
+
+    /** Tasks ready to run, oldest first.*/
+    AsyncTask *head, *tail;
+
+    /** Set by AsyncExecutor_stop to make AsyncExecutor_run return.*/
+    bool stopped;
+};
+
+struct AsyncQueue {
+
+    /** Internal non-thread-safe Queue holding the elements. Its slots follow this struct.*/
+    Queue queue;
+
+    /** Mutex ensuring thread safety, only ever held for a few instructions.*/
+    pthread_mutex_t mutex;
+
+    /** Deqs waiting for an element and enqs waiting for space, oldest first. At most one of the lists is non-empty.*/
+    AsyncTask *deq_head, *deq_tail;
+    AsyncTask *enq_head, *enq_tail;
+};
+
+/*
+ * Creates a new AsyncExecutor with an empty run queue.
+ * Returns a pointer to a new AsyncExecutor on success and NULL on failure.
+ */
+AsyncExecutor* new_AsyncExecutor(void);
+
+/*
+ * Posts callback(element, ctx) to run on this executor. Safe to call from any thread.
+ * Returns false when callback is NULL or memory runs out, true on success.
+ */
+bool AsyncExecutor_post(AsyncExecutor* this, AsyncCallback callback, void* element, void* ctx);
+
+/*
+ * Runs the tasks ready when it is called, without blocking. Tasks posted by those tasks run on the next call.
+ * Returns the number of tasks run.
+ */
+int AsyncExecutor_poll(AsyncExecutor* this);
+
+/*
+ * Runs tasks as they are posted, blocking while there is none, until AsyncExecutor_stop is called.
+ */
+void AsyncExecutor_run(AsyncExecutor* this);
+
+/*
+ * Makes AsyncExecutor_run return once the tasks already posted have run. Safe to call from any thread, including from a task.
+ */
+void AsyncExecutor_stop(AsyncExecutor* this);
+
+/*
+ * Destroys this executor, dropping the tasks which have not run.
+ */
+void AsyncExecutor_destroy(AsyncExecutor* this);
+
+/*
+ * Creates a new AsyncQueue for at most max_size void* elements.
+ * Returns a pointer to a new AsyncQueue on success and NULL on failure.
+ */
+AsyncQueue* new_AsyncQueue(int max_size);
+
+/*
+ * Enqueues the given void* element without blocking. Once the element is in the queue, or handed to a waiting deq,
+ * callback(element, ctx) is posted to executor. When the queue is full, the element waits for space in arrival order.
+ * callback may be NULL when the caller does not need to know.
+ * Returns false when element or executor is NULL or memory runs out, true on success.
+ */
+bool AsyncQueue_enqAsync(AsyncQueue* this, void* element, AsyncExecutor* executor, AsyncCallback callback, void* ctx);
+
+/*
+ * Dequeues an element without blocking. Once an element is available, callback(element, ctx) is posted to executor.
+ * Callbacks never run inside AsyncQueue calls, only inside the executor.
+ * Returns false when executor or callback is NULL or memory runs out, true on success.
+ */
+bool AsyncQueue_deqAsync(AsyncQueue* this, AsyncExecutor* executor, AsyncCallback callback, void* ctx);
+
+/*
+ * Enqueues the given void* element if there is space, without blocking.
+ * Returns true on success, false when element is NULL or the queue is full.
+ */
+bool AsyncQueue_tryEnq(AsyncQueue* this, void* element);
+
+/*
+ * Dequeues an element if there is one, without blocking.
+ * Returns the dequeued void* element, or NULL if the queue is empty.
+ */
+void* AsyncQueue_tryDeq(AsyncQueue* this);
+
+/*
+ * Returns the number of elements currently in this Queue.
+ */
+int AsyncQueue_size(AsyncQueue* this);
+
+/*
+ * Returns the number of deqs currently waiting for an element.
+ */
+int AsyncQueue_waitingDeqs(AsyncQueue* this);
+
+/*
+ * Destroys this Queue by freeing the memory used by the Queue and its waiting operations, whose callbacks never run.
+ */
+void AsyncQueue_destroy(AsyncQueue* this);
+
+#endif /* ASYNC_QUEUE_H_ */
@@ -11,6 +11,11 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "BlockingQueue.h"
 
@@ -25,8 +30,12 @@
  * The function destroys the BlockingQueue, prints the error message and terminates the program with EXIT_FAILURE status.
 */
 static void cleanup_exit(BlockingQueue* this, char *error_mesg) {
-    /** Cleanup the BlockingQueue ressources.*/
-    BlockingQueue_destroy(this);
+    /** Cleanup the BlockingQueue ressources, only freeing the memory if new_BlockingQueue allocated it.*/
+    if (this->allocated) {
+        BlockingQueue_destroy(this);
+    } else {
+        BlockingQueue_deinit(this);
+    }
 
     /** Prints out the provided error message.*/
     perror(error_mesg);
@@ -38,33 +47,79 @@ static void cleanup_exit(BlockingQueue* this, char *error_mesg) {
 
 BlockingQueue *new_BlockingQueue(int max_size) {
 
-    /** Allocate memory for the BlockingQueue structure.*/
-    BlockingQueue *this = malloc(sizeof(BlockingQueue));
+    /** Checks that the given max_size is a valid maximum capacity.*/
+    if (max_size <= ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the BlockingQueue structure and the elements of its Queue in a single block.*/
+    BlockingQueue *this = malloc(sizeof(BlockingQueue) + BlockingQueue_storageSize(max_size));
     if (this == NULL) {
         /** If the initialized BlockingQueue is NULL, indicates to the user that that memory allocation failed.*/
         perror("Error: Failed to allocate memory for BlockingQueue");
         return this;
     }
 
+    /** Initializes the BlockingQueue over the array following it, then marks it as allocated so that destroy frees it.*/
+    BlockingQueue_init(this, max_size, this + ONE);
+    this->allocated = true;
+
+    /** Return the initialized BlockingQueue.*/
+    return this;
+}
+
+size_t BlockingQueue_storageSize(int max_size) {
+    /** The only storage needed is the array of the internal Queue.*/
+    return Queue_storageSize(max_size);
+}
+
+bool BlockingQueue_init(BlockingQueue* this, int max_size, void* storage) {
+
+    /** Checks that the memory is provided and that the given max_size is a valid maximum capacity.*/
+    if (this == NULL || storage == NULL || max_size <= ZERO) {
+        return false;
+    }
+
+    /** The caller owns the memory unless new_BlockingQueue says otherwise.*/
+    this->allocated = false;
+
     /** Sets the maximum size of the Queue.*/
     this->max_size = max_size;
 
     /** Initializes the count of initialized variables (excluding max_size) to 0.*/
     this->initialized = ZERO;
 
+    /** The queue starts empty, with no consumer waiting.*/
+    this->occupied = this->null_slots = ZERO;
+    this->waiters_head = this->waiters_tail = NULL;
+    atomic_init(&this->waiting, ZERO);
+    atomic_init(&this->handoffs, ZERO);
+    atomic_init(&this->current_size, ZERO);
+    atomic_init(&this->rate_tat, ZERO);
+    atomic_init(&this->rate_interval, ZERO);
+    atomic_init(&this->rate_tolerance, ZERO);
+
+    /** No watermarks are set and no eventfd is open.*/
+    this->high_watermark = this->low_watermark = ZERO;
+    this->above_high = false;
+    this->watermark_callback = NULL;
+    this->watermark_ctx = NULL;
+    this->watermark_fd = -1;
+
+    /** The bytes are not limited, nor counted until a byte budget is first set.*/
+    atomic_init(&this->byte_budget, ZERO);
+    this->queued_bytes = this->reserved_bytes = ZERO;
+    this->sizes = NULL;
+    this->sizes_head = ZERO;
+    this->byte_waiters_head = this->byte_waiters_tail = NULL;
+
     /**
-     * Initializes the internal Queue struct.
+     * Initializes the internal Queue struct over the given storage.
      * 
      * Increment the initialization counter
     */
     this->initialized += ONE;
-    this->queue = new_Queue(max_size);
-
-    if (this->queue == NULL) {
-        /** Free the BlockingQueue structure if queue initialization fails.*/
-        free(this);
-        return NULL;
-    }
+    Queue_init(&this->queue, max_size, storage);
 
     /**
      * Initializes the mutex ensuring thread-safety.
@@ -76,157 +131,549 @@ BlockingQueue *new_BlockingQueue(int max_size) {
     if (pthread_mutex_init(&this->mutex, NULL)) { cleanup_exit(this, "Error: failed to initialize mutex.");}
 
     /**
-     * Initializes the semaphore indicating the number of full slots in the queue to 0 full slots.
+     * Initializes the condition variable producers wait on while the queue is full.
      * 
      * Increments the number of initialized variables to 3.
-     * Cleanup and terminates if the semaphore initialization failed.
+     * Cleanup and terminates if the condition variable initialization failed.
     */
     this->initialized += ONE;
-    if (sem_init(&this->full_slots, ZERO, ZERO)) { cleanup_exit(this, "Error: Failed to initialize full_slots semaphore");}
+    if (pthread_cond_init(&this->not_full, NULL)) { cleanup_exit(this, "Error: Failed to initialize not_full condition variable");}
 
     /**
-     * Initializes the semaphore indicating the number of empty slots in the queue to max_size empty slots.
-     * 
+     * Initializes the mutex protecting the list of consumers waiting for a hand-off.
+     *
      * Increments the number of initialized variables to 4.
-     * Cleanup and terminates if the semaphore initialization failed.
+     * Cleanup and terminates if the mutex initialization failed.
     */
     this->initialized += ONE;
-    if (sem_init(&this->empty_slots, ZERO, max_size)) { cleanup_exit(this, "Error: Failed to initialize empty_slots semaphore");}
+    if (pthread_mutex_init(&this->handoff_lock, NULL)) { cleanup_exit(this, "Error: failed to initialize handoff_lock mutex.");}
 
-    /** Return the initialized BlockingQueue.*/
-    return this;
+    return true;
+}
+
+/**
+ * Private function removing the oldest waiting consumer under handoff_lock, if any.
+ * Returns the waiter, to be handed an element by the caller, or NULL if no consumer is waiting.
+*/
+static BlockingQueueWaiter* pop_waiter(BlockingQueue* this) {
+    if (pthread_mutex_lock(&this->handoff_lock)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed for handoff_lock");}
+    BlockingQueueWaiter *waiter = this->waiters_head;
+    if (waiter != NULL) {
+        this->waiters_head = waiter->next;
+        if (this->waiters_head == NULL) {
+            this->waiters_tail = NULL;
+        }
+        atomic_fetch_sub(&this->waiting, ONE);
+    }
+    if (pthread_mutex_unlock(&this->handoff_lock)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed for handoff_lock");}
+    return waiter;
+}
+
+/**
+ * Private function handing an element to a waiter removed from the list, and waking it.
+*/
+static void hand_off(BlockingQueue* this, BlockingQueueWaiter* waiter, void* element) {
+    if (element != NULL) {
+        atomic_fetch_add_explicit(&this->handoffs, ONE, memory_order_relaxed);
+    }
+    waiter->element = element;
+    if (sem_post(&waiter->ready)) { cleanup_exit(this, "Error: sem_post() failed for waiter semaphore");}
+}
+
+/**
+ * Private function publishing the size of the internal Queue for the lock-free readers, called with the mutex held after each change.
+*/
+static void publish_size(BlockingQueue* this) {
+    atomic_store_explicit(&this->current_size, Queue_size(&this->queue), memory_order_release);
+}
+
+/**
+ * Private function signaling a watermark crossing after a change of the occupancy, called with the mutex held.
+ * The occupancy must reach the other watermark before the next crossing is signaled.
+*/
+static void check_watermarks(BlockingQueue* this) {
+    if (this->high_watermark == ZERO) {
+        return;
+    }
+    if (!this->above_high && this->occupied >= this->high_watermark) {
+        this->above_high = true;
+    } else if (this->above_high && this->occupied <= this->low_watermark) {
+        this->above_high = false;
+    } else {
+        return;
+    }
+
+    if (this->watermark_callback != NULL) {
+        this->watermark_callback(this, this->above_high, this->watermark_ctx);
+    }
+    if (this->watermark_fd >= ZERO) {
+        /** The eventfd only counts crossings, a full counter simply fails with EAGAIN while the reader is behind.*/
+        uint64_t one = ONE;
+        if (write(this->watermark_fd, &one, sizeof(one)) < ZERO && errno != EAGAIN) {
+            cleanup_exit(this, "Error: write() failed for watermark eventfd");
+        }
+    }
+}
+
+/**
+ * Private function returning true if an element of the given size fits in the byte budget, called with the mutex held.
+*/
+static bool bytes_fit(BlockingQueue* this, size_t bytes) {
+    return this->byte_budget == ZERO || this->queued_bytes + this->reserved_bytes + bytes <= this->byte_budget;
+}
+
+/**
+ * Private function waking the waiting producers whose element now fits, called with the mutex held after bytes were released
+ * or the budget changed.
+ *
+ * Walks the whole list oldest first, reserving the bytes of each waiter which fits before waking it, so that a woken producer
+ * never has to check the budget again and a waiter which does not fit never holds back the ones behind it. Waiters larger than
+ * the whole budget are woken without a reservation.
+*/
+static void grant_bytes(BlockingQueue* this) {
+    BlockingQueueByteWaiter **link = &this->byte_waiters_head, *last = NULL;
+    while (*link != NULL) {
+        BlockingQueueByteWaiter *waiter = *link;
+        bool too_large = this->byte_budget != ZERO && waiter->bytes > this->byte_budget;
+        if (!too_large && !bytes_fit(this, waiter->bytes)) {
+            last = waiter;
+            link = &waiter->next;
+            continue;
+        }
+        *link = waiter->next;
+        waiter->granted = !too_large;
+        if (waiter->granted) {
+            this->reserved_bytes += waiter->bytes;
+        }
+        if (sem_post(&waiter->ready)) { cleanup_exit(this, "Error: sem_post() failed for byte waiter semaphore");}
+    }
+    this->byte_waiters_tail = last;
+}
+
+/**
+ * Private function releasing the given reserved or queued bytes and waking the producers whose element now fits.
+*/
+static void release_bytes(BlockingQueue* this, size_t* counter, size_t bytes) {
+    *counter -= bytes;
+    if (this->byte_waiters_head != NULL) {
+        grant_bytes(this);
+    }
+}
+
+/**
+ * Private function reserving the bytes of an element, sleeping until they fit in the budget, called with the mutex held.
+ * Returns false if the budget was lowered below them while waiting.
+*/
+static bool reserve_bytes(BlockingQueue* this, size_t bytes) {
+    if (bytes_fit(this, bytes)) {
+        this->reserved_bytes += bytes;
+        return true;
+    }
+
+    /** Does not fit: registers as waiting, and sleeps until a thread releasing bytes reserves them for it.*/
+    BlockingQueueByteWaiter waiter;
+    waiter.bytes = bytes;
+    waiter.granted = false;
+    waiter.next = NULL;
+    if (sem_init(&waiter.ready, ZERO, ZERO)) { cleanup_exit(this, "Error: Failed to initialize byte waiter semaphore");}
+    if (this->byte_waiters_tail == NULL) {
+        this->byte_waiters_head = &waiter;
+    } else {
+        this->byte_waiters_tail->next = &waiter;
+    }
+    this->byte_waiters_tail = &waiter;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed before waiting for bytes");}
+
+    if (sem_wait(&waiter.ready)) { cleanup_exit(this, "Error: sem_wait() failed for byte waiter semaphore");}
+    sem_destroy(&waiter.ready);
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed after waiting for bytes");}
+    return waiter.granted;
 }
 
 bool BlockingQueue_enq(BlockingQueue* this, void* element) {
+    return BlockingQueue_enqSized(this, element, ZERO);
+}
 
-    /** Waits until there is at least one empty slot in the blocking queue.*/
-    if (sem_wait(&this->empty_slots)) { cleanup_exit(this, "Error: sem_wait() failed for empty_slots semaphore");}
+bool BlockingQueue_enqSized(BlockingQueue* this, void* element, size_t bytes) {
 
     /**
-     * When space becomes available...
+     * Consumers only wait on an empty queue, and register under the mutex: when one is waiting, hands the element straight to
+     * the oldest one under handoff_lock alone, skipping the ring and the queue's mutex. A producer missing a consumer which is
+     * registering goes through the mutex below, where it finds it. An element larger than the whole budget is still refused.
     */
+    if (element != NULL && atomic_load(&this->waiting) > ZERO) {
+        size_t budget = atomic_load(&this->byte_budget);
+        if (budget != ZERO && bytes > budget) {
+            return false;
+        }
+        BlockingQueueWaiter *waiter = pop_waiter(this);
+        if (waiter != NULL) {
+            hand_off(this, waiter, element);
+            return true;
+        }
+    }
 
     /** Locks the mutex to ensure thread safety.*/
     if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before enqueueing");}
 
-    /** Attempt to enqueue the element at the rear of the queue.*/
-    bool success = Queue_enq(this->queue, element);
+    /** Sizes are only counted for elements once a byte budget was set, which the mutex orders with this enq, and never for NULL elements.*/
+    if (element == NULL || this->sizes == NULL) {
+        bytes = ZERO;
+    }
 
-    /** Unlocks the mutex.*/
-    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
+    /** Refuses an element which can never fit, then reserves its bytes, waiting for them to be released if needed.*/
+    if (bytes > ZERO && ((this->byte_budget != ZERO && bytes > this->byte_budget) || !reserve_bytes(this, bytes))) {
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed on a refused element");}
+        return false;
+    }
 
-    /** Signals that there is one more full slot in the blocking queue.*/
-    if (sem_post(&this->full_slots)) { cleanup_exit(this, "Error: sem_post() failed for full_slots semaphore");}
+    while (true) {
+
+        /** A consumer registered since the check above, or the element is NULL: hands it over here, NULL included.*/
+        BlockingQueueWaiter *waiter = atomic_load(&this->waiting) > ZERO ? pop_waiter(this) : NULL;
+        if (waiter != NULL) {
+
+            /** The element never enters the queue, so its bytes are released at once.*/
+            if (bytes > ZERO) {
+                release_bytes(this, &this->reserved_bytes, bytes);
+            }
+            if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after a hand-off");}
+            hand_off(this, waiter, element);
+            return element != NULL;
+        }
+
+        /** Otherwise waits until there is at least one empty slot in the blocking queue.*/
+        if (this->occupied < this->max_size) {
+            break;
+        }
+        if (pthread_cond_wait(&this->not_full, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_full");}
+    }
+
+    /**
+     * Enqueues the element at the rear of the queue.
+     * A NULL element is refused but, as it always has, still takes a slot, which the deq reaching it frees by returning NULL.
+    */
+    bool success = Queue_enq(&this->queue, element);
+    if (!success) {
+        this->null_slots += ONE;
+    } else if (this->sizes != NULL) {
+        /** Records the size of the element behind the queued ones, its reserved bytes becoming queued bytes.*/
+        this->sizes[(this->sizes_head + Queue_size(&this->queue) - ONE) % this->max_size] = bytes;
+        this->reserved_bytes -= bytes;
+        this->queued_bytes += bytes;
+    }
+    this->occupied += ONE;
+    publish_size(this);
+    check_watermarks(this);
 
-    /** Return the result of the enqueue operation.*/
+    /** Unlocks the mutex and return the result of the enqueue operation.*/
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
     return success;
 }
 
-void* BlockingQueue_deq(BlockingQueue* this) {
-
-    /** Waits until there is at least one full slot in the blocking queue.*/
-    if (sem_wait(&this->full_slots)) { cleanup_exit(this, "Error: sem_wait() failed for full_slots semaphore");}
-
-    /**
-     * When there are elements in the queue...
-    */
+/**
+ * Private function dequeuing up to max_count elements, blocking while the queue is empty.
+ * Returns the number of elements dequeued, at least one.
+*/
+static int take_elements(BlockingQueue* this, void** elements, int max_count) {
 
     /** Locks the mutex to ensure thread safety.*/
     if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
 
-    /** Dequeues the front element*/
-    void *element = Queue_deq(this->queue);
+    if (this->occupied == ZERO) {
+
+        /** The queue is empty: registers as waiting and sleeps until a producer hands an element over.*/
+        BlockingQueueWaiter waiter;
+        waiter.element = NULL;
+        waiter.next = NULL;
+        if (sem_init(&waiter.ready, ZERO, ZERO)) { cleanup_exit(this, "Error: Failed to initialize waiter semaphore");}
+        if (pthread_mutex_lock(&this->handoff_lock)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed for handoff_lock");}
+        if (this->waiters_tail == NULL) {
+            this->waiters_head = &waiter;
+        } else {
+            this->waiters_tail->next = &waiter;
+        }
+        this->waiters_tail = &waiter;
+        atomic_fetch_add(&this->waiting, ONE);
+        if (pthread_mutex_unlock(&this->handoff_lock)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed for handoff_lock");}
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed before waiting for a hand-off");}
+
+        if (sem_wait(&waiter.ready)) { cleanup_exit(this, "Error: sem_wait() failed for waiter semaphore");}
+        sem_destroy(&waiter.ready);
+        elements[ZERO] = waiter.element;
+        return ONE;
+    }
+
+    /** Dequeues the front element, or frees the slot of a NULL element when only those are left.*/
+    int count = ZERO;
+    if (Queue_isEmpty(&this->queue)) {
+        this->null_slots -= ONE;
+        elements[count++] = NULL;
+    } else {
+        while (count < max_count && !Queue_isEmpty(&this->queue)) {
+            elements[count++] = Queue_deq(&this->queue);
+        }
+
+        /** Releases the bytes of the dequeued elements, waking the producers whose element now fits.*/
+        if (this->sizes != NULL) {
+            size_t released = ZERO;
+            for (int i = ZERO; i < count; i++) {
+                released += this->sizes[this->sizes_head];
+                this->sizes_head = (this->sizes_head + ONE) % this->max_size;
+            }
+            release_bytes(this, &this->queued_bytes, released);
+        }
+    }
+    this->occupied -= count;
+    publish_size(this);
+    check_watermarks(this);
+
+    /** Wakes as many producers as slots were freed.*/
+    int error = (count == ONE) ? pthread_cond_signal(&this->not_full) : pthread_cond_broadcast(&this->not_full);
+    if (error) { cleanup_exit(this, "Error: failed to signal not_full");}
 
     /** Unlocks the mutex.*/
     if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeuing");}
+    return count;
+}
+
+/**
+ * Private function returning the current time in nanoseconds of the monotonic clock.
+*/
+static uint64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+/**
+ * Private function acquiring count tokens from the rate limit, sleeping until they are due.
+*/
+static void acquire_tokens(BlockingQueue* this, int count) {
+    uint64_t interval = atomic_load_explicit(&this->rate_interval, memory_order_relaxed);
+    if (interval == ZERO) {
+        return;
+    }
 
-    /** Signals that there is one more empty slot in the blocking queue.*/
-    if (sem_post(&(this->empty_slots))) { cleanup_exit(this, "Error: sem_post() failed for empty_slots semaphore");}
+    /** Reserves the tokens by moving the theoretical arrival time forward, from now when the bucket has refilled.*/
+    uint64_t now = now_ns();
+    uint64_t tat = atomic_load(&this->rate_tat);
+    uint64_t next;
+    do {
+        next = (tat > now ? tat : now) + (uint64_t)count * interval;
+    } while (!atomic_compare_exchange_weak(&this->rate_tat, &tat, next));
+
+    /** The bucket covers the reservation up to its tolerance, sleeps until the rest is due.*/
+    uint64_t tolerance = atomic_load_explicit(&this->rate_tolerance, memory_order_relaxed);
+    if (next > now + tolerance) {
+        uint64_t wake_at = next - tolerance;
+        struct timespec deadline;
+        deadline.tv_sec = (time_t)(wake_at / 1000000000);
+        deadline.tv_nsec = (long)(wake_at % 1000000000);
+        int error;
+        while ((error = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL)) == EINTR);
+        if (error) { errno = error; cleanup_exit(this, "Error: clock_nanosleep() failed for rate limit");}
+    }
+}
+
+/**
+ * Private function returning count tokens acquired but not used to the rate limit, by moving the theoretical arrival time back.
+*/
+static void return_tokens(BlockingQueue* this, int count) {
+    uint64_t interval = atomic_load_explicit(&this->rate_interval, memory_order_relaxed);
+    if (interval == ZERO || count <= ZERO) {
+        return;
+    }
+    uint64_t tat = atomic_load(&this->rate_tat);
+    uint64_t returned;
+    do {
+        returned = (uint64_t)count * interval;
+        returned = tat < returned ? tat : returned;
+    } while (!atomic_compare_exchange_weak(&this->rate_tat, &tat, tat - returned));
+}
 
-    /** Return the dequeued element.*/
+void* BlockingQueue_deq(BlockingQueue* this) {
+    /** Acquires the token first, so that the element stays in the queue, for any consumer, while this one sleeps for the rate.*/
+    void *element;
+    acquire_tokens(this, ONE);
+    take_elements(this, &element, ONE);
     return element;
 }
 
-int BlockingQueue_size(BlockingQueue* this) {
-    /** Locks the mutex to ensure thread safety.*/
-    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before getting the current size");}
+int BlockingQueue_deqBatch(BlockingQueue* this, void** elements, int max_count) {
 
-    /** Retrieve the current size of the internal Queue.*/
-    int size = Queue_size(this->queue);
+    /** Checks that there is room for at least one element.*/
+    if (elements == NULL || max_count <= ZERO) {
+        return ZERO;
+    }
 
-    /** Unlocks the mutex and return the size of the Queue.*/
-    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after getting the current size");}
-    return size;
+    /**
+     * Acquires the tokens before taking any element, at once for as many elements as are queued, at least one. Then blocks for
+     * the first element, takes the ones already queued under the same lock up to the tokens held, and returns the tokens of the
+     * elements other consumers took meanwhile.
+    */
+    int wanted = max_count;
+    if (atomic_load_explicit(&this->rate_interval, memory_order_relaxed) != ZERO) {
+        int queued = atomic_load_explicit(&this->current_size, memory_order_acquire);
+        wanted = queued < ONE ? ONE : (queued < max_count ? queued : max_count);
+        acquire_tokens(this, wanted);
+    }
+    int count = take_elements(this, elements, wanted);
+    return_tokens(this, wanted - count);
+    return count;
 }
 
-bool BlockingQueue_isEmpty(BlockingQueue* this) {
-    /** Locks the mutex to ensure thread safety.*/
-    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed during isEmpty()");}
+bool BlockingQueue_setRateLimit(BlockingQueue* this, double tokens_per_second, int burst) {
+
+    /** Checks that the rate and the burst are valid.*/
+    if (tokens_per_second < ZERO || burst <= ZERO) {
+        return false;
+    }
+
+    /** Sets the interval between two tokens, or removes the limit, and starts from a full bucket.*/
+    uint64_t interval = tokens_per_second == ZERO ? ZERO : (uint64_t)(1e9 / tokens_per_second);
+    if (tokens_per_second != ZERO && interval == ZERO) {
+        interval = ONE;
+    }
+    atomic_store(&this->rate_tolerance, interval * (uint64_t)burst);
+    atomic_store(&this->rate_tat, ZERO);
+    atomic_store(&this->rate_interval, interval);
+    return true;
+}
 
-    /** Check if the internal Queue is empty.*/
-    bool empty = Queue_isEmpty(this->queue);
+bool BlockingQueue_setWatermarks(BlockingQueue* this, int high, int low, BlockingQueueWatermark callback, void* ctx) {
 
-    /** Unlocks the mutex and return true if the queue is empty, false otherwise.*/
-    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed during isEmpty()");}
+    /** Checks that the watermarks leave room for hysteresis within the capacity, unless they are removed.*/
+    if (high != ZERO && (low < ZERO || low >= high || high > this->max_size)) {
+        return false;
+    }
 
-    /** Return true if empty, false otherwise.*/
-    return empty;
+    /** Sets the watermarks under the mutex, starting from the side of the high watermark the occupancy is on.*/
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before setting watermarks");}
+    this->high_watermark = high;
+    this->low_watermark = high == ZERO ? ZERO : low;
+    this->above_high = high != ZERO && this->occupied >= high;
+    this->watermark_callback = callback;
+    this->watermark_ctx = ctx;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after setting watermarks");}
+    return true;
 }
 
-/**
- * Important: This function is NOT thread safe, use with CAUTION.
- * 
- * While it resets the value of the two semaphores used for the BlockingQueue allowing for new threads to be created,
- * if an enqueuing or deqeuing thread is already waiting on the semaphores, calling this function will result in having two threads concurrently waiting on
- * the same semaphore and modifying its value. This can cause a segmentation fault.
- * 
- * Before clearing a BlockingQueue, ensure that no thread to enqueue elements are still waiting for slots to be emptied.
-*/
-void BlockingQueue_clear(BlockingQueue* this) {
+bool BlockingQueue_isAboveHighWatermark(BlockingQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before reading the watermark state");}
+    bool above_high = this->above_high;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after reading the watermark state");}
+    return above_high;
+}
 
-    /** Locks the mutex to ensure thread safety.*/
-    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed during isEmpty()");}
+int BlockingQueue_watermarkFd(BlockingQueue* this) {
+    /** Creates the eventfd under the mutex, so that concurrent callers share a single one.*/
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before creating the watermark eventfd");}
+    if (this->watermark_fd < ZERO) {
+        this->watermark_fd = eventfd(ZERO, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    int fd = this->watermark_fd;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after creating the watermark eventfd");}
+    return fd;
+}
 
-    /** Clear the internal Queue, resetting the current size and the front and rear indexes.*/
-    Queue_clear(this->queue);
+bool BlockingQueue_setByteBudget(BlockingQueue* this, size_t budget) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before setting a byte budget");}
+
+    /** Allocates the ring of sizes on the first call, the elements already queued counting for 0 bytes.*/
+    if (this->sizes == NULL) {
+        this->sizes = calloc(this->max_size, sizeof(size_t));
+        this->sizes_head = ZERO;
+        if (this->sizes == NULL) {
+            if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after a failed allocation");}
+            return false;
+        }
+    }
+
+    /** A raised budget may let waiting producers in, a lowered one refuses those which can no longer fit.*/
+    this->byte_budget = budget;
+    grant_bytes(this);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after setting a byte budget");}
+    return true;
+}
 
-    /** When initialized, holds the current number of empty slots in the blocking queue.*/
-    int value_empty_slots;
+size_t BlockingQueue_bytes(BlockingQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before reading the bytes");}
+    size_t bytes = this->queued_bytes;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after reading the bytes");}
+    return bytes;
+}
 
-    /** Grabs the value of the empty_slots semaphore and saves it in the value_empty_slots int variable.*/
-    if (sem_getvalue(&this->empty_slots, &value_empty_slots)) { cleanup_exit(this, "Error: sem_getvalue(&this->empty_slots, &value_empty_slots) failed in BlockingQueue_clear");}
+int BlockingQueue_size(BlockingQueue* this) {
+    /** Reads the size published by the last change of the internal Queue, without taking the mutex.*/
+    return atomic_load_explicit(&this->current_size, memory_order_acquire);
+}
 
-    /**
-     * This while loop resets the value of the full_slots semaphore to zero.
-     * This is important since after being cleared, the Blocking Queue should have zero slots occupied.
-    */
-    while (sem_trywait(&this->full_slots) == 0); // sem_trywait returns -1 when the value of full_slots is 0.
+long BlockingQueue_handoffs(BlockingQueue* this) {
+    return atomic_load(&this->handoffs);
+}
+
+bool BlockingQueue_isEmpty(BlockingQueue* this) {
+    /** Same lock-free read as BlockingQueue_size.*/
+    return BlockingQueue_size(this) == ZERO;
+}
+
+void BlockingQueue_clear(BlockingQueue* this) {
+
+    /** Locks the mutex to ensure thread safety.*/
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed during clear");}
 
     /**
-     * This for loop resets the value of the empty_slots semaphore to the maximum size.
-     * This is important since after being cleared, the Blocking Queue should have max_size free slots.
+     * Clears the internal Queue and the slot count in constant time, whatever the capacity.
+     * Waiting consumers keep waiting, the queue being empty, and producers keep handing them elements under handoff_lock
+     * alone, without racing with the clear: the list of waiters is not part of the cleared state. Every producer waiting for
+     * space rechecks for it.
     */
-    for (int i = value_empty_slots; i < ((this->max_size) + 1); i++) {
-        if(sem_post(&this->empty_slots)) { cleanup_exit(this, "Error: sem_post(&this->empty_slots) failed in BlockingQueue_clear");}
-    }
+    Queue_clear(&this->queue);
+    this->occupied = this->null_slots = ZERO;
+    publish_size(this);
+    check_watermarks(this);
+
+    /** Releases the bytes of the cleared elements, the reserved ones still belonging to their producers.*/
+    this->sizes_head = ZERO;
+    release_bytes(this, &this->queued_bytes, this->queued_bytes);
+    if (pthread_cond_broadcast(&this->not_full)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed for not_full");}
 
-    /** Unlocks the mutex and return true if the queue is empty, false otherwise.*/
-    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed during isEmpty()");}
+    /** Unlocks the mutex.*/
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed during clear");}
 }
 
-void BlockingQueue_destroy(BlockingQueue* this) {
-    /** Destroy the internal Queue if initialized.*/
-    if (this->initialized >= ONE) { Queue_destroy(this->queue);}
+void BlockingQueue_deinit(BlockingQueue* this) {
+    /** Release the internal Queue if initialized.*/
+    if (this->initialized >= ONE) { Queue_deinit(&this->queue);}
 
     /** Destroy the mutex if initialized.*/
     if (this->initialized >= TWO) { pthread_mutex_destroy(&this->mutex);}
 
-    /** Destroy the full_slots semaphore if initialized.*/
-    if (this->initialized >= THREE) { sem_destroy(&this->full_slots);}
+    /** Destroy the not_full condition variable if initialized.*/
+    if (this->initialized >= THREE) { pthread_cond_destroy(&this->not_full);}
+
+    /** Destroy the handoff_lock mutex if initialized.*/
+    if (this->initialized >= FOUR) { pthread_mutex_destroy(&this->handoff_lock);}
+
+    /** Close the watermark eventfd if one was created.*/
+    if (this->watermark_fd >= ZERO) {
+        close(this->watermark_fd);
+        this->watermark_fd = -1;
+    }
+
+    /** Free the ring of element sizes if a byte budget was set.*/
+    free(this->sizes);
+    this->sizes = NULL;
 
-    /** Destroy the empty_slots semaphore if initialized.*/
-    if (this->initialized >= FOUR) { sem_destroy(&this->empty_slots);}
+    /** Nothing is left to release.*/
+    this->initialized = ZERO;
+}
+
+void BlockingQueue_destroy(BlockingQueue* this) {
+    /** Release the internal Queue, the mutex and the condition variable.*/
+    BlockingQueue_deinit(this);
 
-    /** Free the memory allocated for the BlockingQueue.*/
+    /** Free the memory allocated for the BlockingQueue and the elements of its Queue.*/
     free(this);
 }
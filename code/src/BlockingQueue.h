@@ -10,28 +10,130 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include <semaphore.h>
 
 #include "Queue.h"
 
+typedef struct BlockingQueueWaiter BlockingQueueWaiter;
+typedef struct BlockingQueueByteWaiter BlockingQueueByteWaiter;
 typedef struct BlockingQueue BlockingQueue;
 
+/*
+ * Callback told that the occupancy of a BlockingQueue crossed a watermark: high is true when it rose to the high watermark,
+ * false when it fell back to the low watermark. It runs under the queue's mutex, so it must return quickly and must not call
+ * back into the queue.
+ */
+typedef void (*BlockingQueueWatermark)(BlockingQueue* queue, bool high, void* ctx);
+
+/*
+ * Consumer blocked on an empty BlockingQueue, waiting for a producer to hand an element over directly.
+ * It lives on the stack of the waiting consumer, is linked under the queue's mutex and handoff_lock, and unlinked under
+ * handoff_lock alone.
+ */
+struct BlockingQueueWaiter {
+
+    /** Element handed over by the producer.*/
+    void *element;
+
+    /** Semaphore the consumer sleeps on, posted by the producer handing the element over.*/
+    sem_t ready;
+
+    /** Next waiter, in arrival order.*/
+    BlockingQueueWaiter *next;
+};
+
+/*
+ * Producer blocked until its element fits in the byte budget of a BlockingQueue.
+ * It lives on the stack of the waiting producer, and the thread releasing bytes reserves them for it before waking it.
+ */
+struct BlockingQueueByteWaiter {
+
+    /** Size of the element waiting to be enqueued.*/
+    size_t bytes;
+
+    /** True when its bytes were reserved, false when the budget was lowered below them.*/
+    bool granted;
+
+    /** Semaphore the producer sleeps on, posted once its bytes are reserved or refused.*/
+    sem_t ready;
+
+    /** Next waiter, in arrival order.*/
+    BlockingQueueByteWaiter *next;
+};
+
 /* You should define your struct BlockingQueue here */
 struct BlockingQueue {
 
-    /** Internal non-thread-safe Queue object.*/
-    Queue *queue;
+    /** Internal non-thread-safe Queue object, embedded so that it needs no allocation of its own.*/
+    Queue queue;
 
     /** Mutex ensuring thread safety.*/
     pthread_mutex_t mutex;
 
-    /** Semaphore counting the number of occupied slots inside of the Queue. Initialized to zero when creating a new BlockingQueue.*/
-    sem_t full_slots;
+    /** Condition variable producers wait on while the queue is full, broadcast by clear.*/
+    pthread_cond_t not_full;
+
+    /** Number of occupied slots, the elements of the internal Queue plus the slots taken by NULL elements.*/
+    int occupied;
+
+    /** Number of slots taken by NULL elements, which the internal Queue refuses.*/
+    int null_slots;
+
+    /**
+     * Mutex protecting the list of waiting consumers, so that a producer can hand an element over without taking the queue's
+     * mutex. It is taken after the queue's mutex when both are needed.
+    */
+    pthread_mutex_t handoff_lock;
+
+    /** Consumers waiting for a hand-off, oldest first. Consumers only wait on an empty queue.*/
+    BlockingQueueWaiter *waiters_head, *waiters_tail;
+
+    /** Number of consumers registered as waiting, read by producers without taking any lock.*/
+    _Atomic int waiting;
+
+    /** Number of elements handed directly to a waiting consumer, without going through the queue.*/
+    _Atomic long handoffs;
+
+    /** Size of the internal Queue, stored under the mutex after each change so that size and isEmpty can read it without the mutex.*/
+    _Atomic int current_size;
+
+    /**
+     * Token bucket shared by every consumer, kept as a generic cell rate algorithm so that no lock is needed: rate_tat is the
+     * time, in nanoseconds of the monotonic clock, at which the tokens already reserved are all emitted, and consumers reserve
+     * tokens by moving it forward with a compare and swap. rate_interval is the time between two tokens, zero when the rate is
+     * not limited, and rate_tolerance the time covered by a full bucket.
+    */
+    _Atomic uint64_t rate_tat, rate_interval, rate_tolerance;
+
+    /** Occupancy watermarks, high_watermark being 0 when none are set.*/
+    int high_watermark, low_watermark;
+
+    /** True from the crossing of the high watermark until the crossing of the low one, so that each crossing is signaled once.*/
+    bool above_high;
+
+    /** Callback told of the crossings and its context, NULL when none is set.*/
+    BlockingQueueWatermark watermark_callback;
+    void *watermark_ctx;
+
+    /** Eventfd counting the crossings, -1 until BlockingQueue_watermarkFd creates it.*/
+    int watermark_fd;
+
+    /** Byte budget, 0 when the bytes are not limited, written under the mutex and read without it by the hand-off path.*/
+    _Atomic size_t byte_budget;
+
+    /** Bytes of the queued elements, and bytes reserved by producers which are still to enqueue their element.*/
+    size_t queued_bytes, reserved_bytes;
+
+    /** Sizes of the queued elements in queue order from sizes_head, NULL until a byte budget is first set.*/
+    size_t *sizes;
+    int sizes_head;
 
-    /** Semaphore counting the number of free slots inside of the Queue. Initialized to the maximum capacity when creating a new BlockingQueue.*/
-    sem_t empty_slots;
+    /** Producers waiting for their element to fit in the byte budget, oldest first.*/
+    BlockingQueueByteWaiter *byte_waiters_head, *byte_waiters_tail;
 
     /** Maximum capacity of the BlockingQueue.*/
     int max_size;
@@ -41,6 +143,9 @@ struct BlockingQueue {
      * Useful when freeing dynamically allocated memory.
     */
     int initialized;
+
+    /** True when new_BlockingQueue allocated this BlockingQueue, false when the caller provided the memory to BlockingQueue_init.*/
+    bool allocated;
 };
 
 /*
@@ -49,37 +154,133 @@ struct BlockingQueue {
  */
 BlockingQueue* new_BlockingQueue(int max_size);
 
+/*
+ * Returns the number of bytes of slot storage needed by a BlockingQueue of max_size elements, or 0 if max_size is not positive.
+ */
+size_t BlockingQueue_storageSize(int max_size);
+
+/*
+ * Initializes the BlockingQueue pointed to by this, which the caller allocated, for at most max_size void* elements.
+ * storage must point to at least BlockingQueue_storageSize(max_size) bytes aligned for void*, and must outlive the BlockingQueue.
+ * Nothing is allocated, so the BlockingQueue can be embedded in another struct, placed on the stack or in an arena.
+ * Returns true on success and false when this or storage is NULL or max_size is not positive.
+ */
+bool BlockingQueue_init(BlockingQueue* this, int max_size, void* storage);
+
 /*
  * Enqueues the given void* element at the back of this Queue.
+ * When a consumer is blocked on the empty queue, the element is handed to it directly, without going through the queue nor
+ * taking its mutex.
  * If the queue is full, the function will block the calling thread until there is space in the queue.
  * Returns false when element is NULL and true on success.
  */
 bool BlockingQueue_enq(BlockingQueue* this, void* element);
 
+/*
+ * Enqueues the given void* element of the given size in bytes at the back of this Queue, like BlockingQueue_enq.
+ * When a byte budget is set, the function also blocks while the bytes of the queued elements plus bytes would exceed it.
+ * The size is only counted once BlockingQueue_setByteBudget was first called, it is ignored before and for a NULL element.
+ * Returns false when element is NULL or bytes is above the whole budget, and true on success.
+ */
+bool BlockingQueue_enqSized(BlockingQueue* this, void* element, size_t bytes);
+
 /*
  * Dequeues an element from the front of this Queue.
  * If the queue is empty, the function will block until an element can be dequeued.
+ * When a rate limit is set, the function first sleeps until a token is available, leaving the element in the queue meanwhile.
  * Returns the dequeued void* element.
  */
 void* BlockingQueue_deq(BlockingQueue* this);
 
 /*
- * Returns the number of elements currently in this Queue.
+ * Dequeues up to max_count elements from the front of this Queue into elements, oldest first.
+ * The function blocks until one element can be dequeued, then takes the elements already in the queue without blocking again.
+ * When a rate limit is set, it first acquires at once the tokens of as many elements as are queued, and takes no more elements
+ * than it holds tokens for, returning the tokens of the elements other consumers took meanwhile.
+ * Returns the number of dequeued elements, or 0 when elements is NULL or max_count is not positive.
+ */
+int BlockingQueue_deqBatch(BlockingQueue* this, void** elements, int max_count);
+
+/*
+ * Limits the dequeues of this Queue, shared by all its consumers, to tokens_per_second elements per second, with bursts of at
+ * most burst elements after an idle period. A consumer over the limit sleeps until its token is due before its deq returns.
+ * A tokens_per_second of 0 removes the limit.
+ * Returns true on success and false when tokens_per_second is negative or burst is not positive.
+ */
+bool BlockingQueue_setRateLimit(BlockingQueue* this, double tokens_per_second, int burst);
+
+/*
+ * Sets the occupancy watermarks of this Queue, counting the slots taken by queued elements.
+ * When the occupancy rises to high, callback is called with high set to true; it is then not called again until the occupancy
+ * falls to low, where it is called with high set to false, and so on, so a producer reading from a socket can pause its reads
+ * at the high watermark, before enq starts blocking, and resume them at the low one. Each crossing is also signaled on the
+ * eventfd of BlockingQueue_watermarkFd. callback may be NULL when only the eventfd is used, and a high of 0 removes the
+ * watermarks. The queue starts above the high watermark if its occupancy is already there, without a call.
+ * Returns true on success and false unless 0 <= low < high <= the capacity of the queue, or high is 0.
+ */
+bool BlockingQueue_setWatermarks(BlockingQueue* this, int high, int low, BlockingQueueWatermark callback, void* ctx);
+
+/*
+ * Returns true if the occupancy of this Queue crossed the high watermark and did not fall back to the low one since.
+ */
+bool BlockingQueue_isAboveHighWatermark(BlockingQueue* this);
+
+/*
+ * Returns a non-blocking eventfd, created on the first call and closed with the queue, whose counter is incremented on each
+ * watermark crossing, so that an event loop can poll it along with its sockets and then read BlockingQueue_isAboveHighWatermark.
+ * Returns -1 if the eventfd could not be created.
+ */
+int BlockingQueue_watermarkFd(BlockingQueue* this);
+
+/*
+ * Limits the total size of the elements in this Queue to budget bytes, on top of its capacity in elements, the sizes being
+ * given to BlockingQueue_enqSized. When bytes are released, every waiting producer whose element now fits has its bytes
+ * reserved and is woken, oldest first, skipping the ones which still do not fit, so a large element never holds back smaller
+ * ones; under a steady flow of small elements a large one may in turn wait longer. Producers waiting with an element larger
+ * than a lowered budget return false. The first call allocates the ring of element sizes, the elements already queued counting
+ * for 0 bytes. A budget of 0 removes the limit, sizes still being counted.
+ * Returns true on success and false if the ring of sizes could not be allocated.
+ */
+bool BlockingQueue_setByteBudget(BlockingQueue* this, size_t budget);
+
+/*
+ * Returns the total size in bytes of the elements in this Queue, as given to BlockingQueue_enqSized.
+ */
+size_t BlockingQueue_bytes(BlockingQueue* this);
+
+/*
+ * Returns the number of elements currently in this Queue, with a single atomic read which never takes the mutex nor blocks.
+ * The value is the size after the last enq, deq or clear which changed the queue: an operation still in progress, or an element
+ * handed directly to a waiting consumer, is not counted. It is always between 0 and the capacity of the queue.
  */
 int BlockingQueue_size(BlockingQueue* this);
 
 /*
- * Returns true if this Queue is empty, false otherwise.
+ * Returns true if this Queue is empty, false otherwise, with the same lock-free read as BlockingQueue_size.
  */
 bool BlockingQueue_isEmpty(BlockingQueue* this);
 
 /*
- * Clears this Queue returning it to an empty state.
+ * Returns the number of elements handed directly from a producer to a waiting consumer.
+ */
+long BlockingQueue_handoffs(BlockingQueue* this);
+
+/*
+ * Clears this Queue returning it to an empty state, in constant time whatever its capacity.
+ * Safe to call while producers and consumers are blocked on the queue: blocked producers get the freed slots, blocked consumers keep waiting.
  */
 void BlockingQueue_clear(BlockingQueue* this);
 
+/*
+ * Releases a BlockingQueue initialized with BlockingQueue_init by destroying its mutexes and condition variable, closing
+ * its watermark eventfd if one was created and freeing the ring of element sizes of a byte budget.
+ * The BlockingQueue and its storage belong to the caller and are not freed.
+ */
+void BlockingQueue_deinit(BlockingQueue* this);
+
 /*
  * Destroys this Queue by freeing the memory used by the Queue.
+ * Must only be called on a BlockingQueue created by new_BlockingQueue.
  */
 void BlockingQueue_destroy(BlockingQueue* this);
 
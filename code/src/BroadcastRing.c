@@ -0,0 +1,202 @@
+/*
+ * BroadcastRing.c
+ *
+ * Single-producer, multi-reader broadcast ring where each reader keeps its own cursor.
+ *
+ * Nothing is locked: the producer publishes by moving its sequence number forward and each reader releases slots by moving
+ * its own cursor forward. A side that has to sleep sets its waiting flag, checks the other side's counter again and only then
+ * waits on its semaphore; the other side checks the flag after moving its counter. All of these accesses are sequentially
+ * consistent, so either the sleeper sees the new counter or the other side sees the flag and posts the semaphore.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <semaphore.h>
+
+#include "BroadcastRing.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the BroadcastRing, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(BroadcastRing* this, char *error_mesg) {
+    BroadcastRing_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function returning the smallest cursor among the registered readers.
+*/
+static uint64_t slowest_cursor(BroadcastRing* this) {
+    uint64_t slowest = atomic_load(&this->published);
+    int count = atomic_load(&this->reader_count);
+    for (int i = ZERO; i < count; i++) {
+        uint64_t cursor = atomic_load(&this->readers[i].cursor);
+        if (cursor < slowest) {
+            slowest = cursor;
+        }
+    }
+    return slowest;
+}
+
+BroadcastRing* new_BroadcastRing(int max_size, int max_readers) {
+
+    /** Checks that the given sizes are valid.*/
+    if (max_size <= ZERO || max_readers <= ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the ring, its slots and its cache line aligned readers.*/
+    BroadcastRing *this = aligned_alloc(BROADCAST_RING_CACHE_LINE, sizeof(BroadcastRing));
+    void **slots = malloc(max_size * sizeof(void*));
+    BroadcastReader *readers = aligned_alloc(BROADCAST_RING_CACHE_LINE, max_readers * sizeof(BroadcastReader));
+    if (this == NULL || slots == NULL || readers == NULL) {
+        perror("Error: Failed to allocate memory for BroadcastRing");
+        free(this);
+        free(slots);
+        free(readers);
+        return NULL;
+    }
+
+    this->slots = slots;
+    this->readers = readers;
+    this->max_size = max_size;
+    this->max_readers = max_readers;
+    this->slowest_cursor = ZERO;
+    atomic_init(&this->published, ZERO);
+    atomic_init(&this->readers_claimed, ZERO);
+    atomic_init(&this->reader_count, ZERO);
+    atomic_init(&this->producer_waiting, false);
+
+    /** Initializes every semaphore at zero, they are only posted to wake a sleeper.*/
+    if (sem_init(&this->producer_wake, ZERO, ZERO)) { cleanup_exit(this, "Error: Failed to initialize producer_wake semaphore");}
+    for (int i = ZERO; i < max_readers; i++) {
+        atomic_init(&readers[i].cursor, ZERO);
+        atomic_init(&readers[i].waiting, false);
+        if (sem_init(&readers[i].wake, ZERO, ZERO)) { cleanup_exit(this, "Error: Failed to initialize reader wake semaphore");}
+    }
+    return this;
+}
+
+int BroadcastRing_register(BroadcastRing* this) {
+    /** Claims the next reader identifier, never going past max_readers, so the producer never scans beyond the readers.*/
+    int reader = atomic_load(&this->readers_claimed);
+    do {
+        if (reader >= this->max_readers) {
+            return -1;
+        }
+    } while (!atomic_compare_exchange_weak(&this->readers_claimed, &reader, reader + ONE));
+
+    /** Starts the cursor at the next element to be published, before the producer can see the reader.*/
+    atomic_store(&this->readers[reader].cursor, atomic_load(&this->published));
+
+    /** Makes the reader visible once the readers with smaller identifiers are, so every visible reader has its cursor set.*/
+    int expected = reader;
+    while (!atomic_compare_exchange_weak(&this->reader_count, &expected, reader + ONE)) {
+        expected = reader;
+        sched_yield();
+    }
+    return reader;
+}
+
+bool BroadcastRing_publish(BroadcastRing* this, void* element) {
+
+    /** Check that the element is not NULL.*/
+    if (element == NULL) {
+        return false;
+    }
+    uint64_t sequence = atomic_load_explicit(&this->published, memory_order_relaxed);
+
+    /** Waits while the slot to write still holds an element the slowest reader has not read.*/
+    while (sequence - this->slowest_cursor >= (uint64_t)this->max_size) {
+        this->slowest_cursor = slowest_cursor(this);
+        if (sequence - this->slowest_cursor < (uint64_t)this->max_size) {
+            break;
+        }
+        atomic_store(&this->producer_waiting, true);
+        this->slowest_cursor = slowest_cursor(this);
+        if (sequence - this->slowest_cursor < (uint64_t)this->max_size) {
+            atomic_store(&this->producer_waiting, false);
+            break;
+        }
+        if (sem_wait(&this->producer_wake)) { cleanup_exit(this, "Error: sem_wait() failed for producer_wake semaphore");}
+    }
+
+    /** Writes the slot once, then publishes it to every reader.*/
+    this->slots[sequence % this->max_size] = element;
+    atomic_store(&this->published, sequence + ONE);
+
+    /** Wakes the readers which went to sleep waiting for this element.*/
+    int count = atomic_load(&this->reader_count);
+    for (int i = ZERO; i < count; i++) {
+        BroadcastReader *reader = &this->readers[i];
+        if (atomic_load(&reader->waiting) && atomic_exchange(&reader->waiting, false)) {
+            if (sem_post(&reader->wake)) { cleanup_exit(this, "Error: sem_post() failed for reader wake semaphore");}
+        }
+    }
+    return true;
+}
+
+void* BroadcastRing_tryRead(BroadcastRing* this, int reader) {
+    BroadcastReader *self = &this->readers[reader];
+    uint64_t cursor = atomic_load_explicit(&self->cursor, memory_order_relaxed);
+
+    /** Nothing to read if the reader has caught up with the producer.*/
+    if (cursor >= atomic_load(&this->published)) {
+        return NULL;
+    }
+
+    /** Reads the slot, then releases it by moving the cursor forward.*/
+    void *element = this->slots[cursor % this->max_size];
+    atomic_store(&self->cursor, cursor + ONE);
+
+    /** Wakes the producer if it went to sleep waiting for the readers to free a slot.*/
+    if (atomic_load(&this->producer_waiting) && atomic_exchange(&this->producer_waiting, false)) {
+        if (sem_post(&this->producer_wake)) { cleanup_exit(this, "Error: sem_post() failed for producer_wake semaphore");}
+    }
+    return element;
+}
+
+void* BroadcastRing_read(BroadcastRing* this, int reader) {
+    BroadcastReader *self = &this->readers[reader];
+
+    while (true) {
+        void *element = BroadcastRing_tryRead(this, reader);
+        if (element != NULL) {
+            return element;
+        }
+
+        /** Announces that this reader is going to sleep, then checks once more before sleeping.*/
+        atomic_store(&self->waiting, true);
+        if (atomic_load(&self->cursor) < atomic_load(&this->published)) {
+            atomic_store(&self->waiting, false);
+            continue;
+        }
+
+        /** A post left over from a previous wake-up only causes one more check.*/
+        if (sem_wait(&self->wake)) { cleanup_exit(this, "Error: sem_wait() failed for reader wake semaphore");}
+    }
+}
+
+int BroadcastRing_available(BroadcastRing* this, int reader) {
+    return (int)(atomic_load(&this->published) - atomic_load(&this->readers[reader].cursor));
+}
+
+void BroadcastRing_destroy(BroadcastRing* this) {
+    /** Destroys every semaphore and frees the readers, the slots and the ring.*/
+    for (int i = ZERO; i < this->max_readers; i++) {
+        sem_destroy(&this->readers[i].wake);
+    }
+    sem_destroy(&this->producer_wake);
+    free(this->readers);
+    free(this->slots);
+    free(this);
+}
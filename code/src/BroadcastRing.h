@@ -0,0 +1,113 @@
+/*
+ * BroadcastRing.h
+ *
+ * Module interface for a fixed-size broadcast ring: one producer publishes each void* element once and every registered
+ * reader sees every element, in order, through its own cursor.
+ *
+ */
+
+#ifndef BROADCAST_RING_H_
+#define BROADCAST_RING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+
+#include "Queue.h"
+
+/** Size of a cache line, readers are aligned on it so that advancing one cursor never invalidates another.*/
+#define BROADCAST_RING_CACHE_LINE 64
+
+typedef struct BroadcastReader BroadcastReader;
+typedef struct BroadcastRing BroadcastRing;
+
+/*
+ * State owned by a single reader.
+ */
+struct BroadcastReader {
+
+    /** Sequence number of the next element this reader will read. Only written by the reader.*/
+    _Alignas(BROADCAST_RING_CACHE_LINE) _Atomic uint64_t cursor;
+
+    /** Set by the reader before sleeping on wake, cleared by whoever wakes it.*/
+    atomic_bool waiting;
+
+    /** Semaphore the reader sleeps on when it has read every published element.*/
+    sem_t wake;
+};
+
+struct BroadcastRing {
+
+    /** Number of elements published so far, the next element gets this sequence number. Only written by the producer.*/
+    _Alignas(BROADCAST_RING_CACHE_LINE) _Atomic uint64_t published;
+
+    /** Smallest reader cursor the producer saw the last time it looked, so it only scans the readers when it might be a ring ahead.*/
+    uint64_t slowest_cursor;
+
+    /** Set by the producer before sleeping on producer_wake, cleared by the reader which wakes it.*/
+    atomic_bool producer_waiting;
+
+    /** Semaphore the producer sleeps on when the slowest reader is a full ring behind.*/
+    sem_t producer_wake;
+
+    /** Maximum number of unread elements per reader, and maximum number of readers.*/
+    int max_size, max_readers;
+
+    /**
+     * Number of reader identifiers handed out, and number of registered readers, the prefix of them whose cursor is initialized
+     * and which the producer scans. reader_count never exceeds max_readers.
+    */
+    _Atomic int readers_claimed;
+    _Atomic int reader_count;
+
+    /** Slots holding the published elements, the element with sequence number s is in slot s % max_size.*/
+    void **slots;
+
+    /** Per-reader state, one cache line each.*/
+    BroadcastReader *readers;
+};
+
+/*
+ * Creates a new BroadcastRing of max_size slots for at most max_readers readers.
+ * Returns a pointer to a new BroadcastRing on success and NULL on failure.
+ */
+BroadcastRing* new_BroadcastRing(int max_size, int max_readers);
+
+/*
+ * Registers a new reader, which will read every element published from now on.
+ * Readers must be registered before the producer starts publishing.
+ * Returns the identifier of the reader, or -1 if max_readers readers are already registered.
+ */
+int BroadcastRing_register(BroadcastRing* this);
+
+/*
+ * Publishes the given void* element to every reader. Must only be called by a single producer thread.
+ * If the slowest reader has not yet read the element published max_size elements ago, the function blocks until it does.
+ * Returns false when element is NULL and true on success.
+ */
+bool BroadcastRing_publish(BroadcastRing* this, void* element);
+
+/*
+ * Returns the next element for the given reader, blocking until one is published.
+ * Each reader must only be used by one thread at a time.
+ */
+void* BroadcastRing_read(BroadcastRing* this, int reader);
+
+/*
+ * Returns the next element for the given reader, or NULL if the reader has read every published element.
+ */
+void* BroadcastRing_tryRead(BroadcastRing* this, int reader);
+
+/*
+ * Returns the number of published elements the given reader has not read yet.
+ */
+int BroadcastRing_available(BroadcastRing* this, int reader);
+
+/*
+ * Destroys this BroadcastRing by freeing the memory it uses.
+ */
+void BroadcastRing_destroy(BroadcastRing* this);
+
+#endif /* BROADCAST_RING_H_ */
@@ -0,0 +1,252 @@
+/*
+ * ByteQueue.c
+ *
+ * Thread-safe ring buffer of length-prefixed, 8 byte aligned frames.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "ByteQueue.h"
+
+/** Flag set in the header of the frame filling the end of the ring before a wrap around.*/
+#define PADDING_FRAME 1u
+
+/*
+ * Header written at the start of every frame.
+ */
+typedef struct FrameHeader {
+    /** Length of the payload in bytes.*/
+    uint32_t length;
+    /** PADDING_FRAME for padding frames, zero otherwise.*/
+    uint32_t flags;
+} FrameHeader;
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the ByteQueue, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(ByteQueue* this, char *error_mesg) {
+    ByteQueue_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function returning the size of the frame holding a payload of the given length.
+*/
+static size_t frame_size(size_t length) {
+    return sizeof(FrameHeader) + ((length + BYTE_QUEUE_ALIGNMENT - ONE) & ~(size_t)(BYTE_QUEUE_ALIGNMENT - ONE));
+}
+
+/**
+ * Private function returning the header of the frame starting at the given position.
+*/
+static FrameHeader* frame_at(ByteQueue* this, uint64_t position) {
+    return (FrameHeader*)(this->buffer + position % this->capacity);
+}
+
+/**
+ * Private function skipping the padding frame at the head, if any, so that the head is on a message.
+*/
+static void skip_padding(ByteQueue* this) {
+    if (this->head != this->tail && (frame_at(this, this->head)->flags & PADDING_FRAME)) {
+        this->head += frame_size(frame_at(this, this->head)->length);
+    }
+}
+
+/**
+ * Private function copying a message into the ring if there is room for it, called with the mutex held.
+ * Returns false when the frame does not fit right now.
+*/
+static bool try_write(ByteQueue* this, const void* message, size_t length) {
+    size_t size = frame_size(length);
+
+    /** An empty ring restarts at a boundary so that any frame up to the capacity fits without padding.*/
+    if (this->head == this->tail) {
+        this->head = this->tail = ((this->tail + this->capacity - ONE) / this->capacity) * this->capacity;
+    }
+
+    /** A frame which would cross the end of the ring is preceded by a padding frame filling that end.*/
+    size_t contiguous = this->capacity - this->tail % this->capacity;
+    size_t padding = (contiguous < size) ? contiguous : ZERO;
+    if ((this->tail - this->head) + padding + size > this->capacity) {
+        return false;
+    }
+    if (padding > ZERO) {
+        FrameHeader *pad = frame_at(this, this->tail);
+        pad->length = (uint32_t)(padding - sizeof(FrameHeader));
+        pad->flags = PADDING_FRAME;
+        this->tail += padding;
+    }
+
+    /** Writes the header and the payload, then publishes the frame by moving the tail.*/
+    FrameHeader *header = frame_at(this, this->tail);
+    header->length = (uint32_t)length;
+    header->flags = ZERO;
+    memcpy(header + ONE, message, length);
+    this->tail += size;
+    this->current_size = this->current_size + ONE;
+    return true;
+}
+
+/**
+ * Private function copying the front message out of the ring, called with the mutex held on a non-empty ring.
+ * Returns the length of the message or -1 when it does not fit in the buffer.
+*/
+static ssize_t read_front(ByteQueue* this, void* buffer, size_t buffer_size) {
+    skip_padding(this);
+    FrameHeader *header = frame_at(this, this->head);
+    if (buffer == NULL || header->length > buffer_size) {
+        return -1;
+    }
+    memcpy(buffer, header + ONE, header->length);
+    this->head += frame_size(header->length);
+    this->current_size = this->current_size - ONE;
+    return (ssize_t)header->length;
+}
+
+ByteQueue* new_ByteQueue(size_t capacity) {
+
+    /** Rounds the capacity up to the alignment and checks that a frame fits.*/
+    capacity = (capacity + BYTE_QUEUE_ALIGNMENT - ONE) & ~(size_t)(BYTE_QUEUE_ALIGNMENT - ONE);
+    if (capacity < TWO * sizeof(FrameHeader)) {
+        return NULL;
+    }
+
+    /** Allocate memory for the ByteQueue structure and the ring in one block.*/
+    ByteQueue *this = malloc(sizeof(ByteQueue) + capacity);
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for ByteQueue");
+        return NULL;
+    }
+    this->buffer = (unsigned char*)(this + ONE);
+    this->capacity = capacity;
+    this->head = this->tail = ZERO;
+    this->current_size = ZERO;
+
+    if (pthread_mutex_init(&this->mutex, NULL)
+            || pthread_cond_init(&this->not_empty, NULL)
+            || pthread_cond_init(&this->not_full, NULL)) {
+        perror("Error: failed to initialize ByteQueue synchronization");
+        free(this);
+        return NULL;
+    }
+    return this;
+}
+
+bool ByteQueue_enq(ByteQueue* this, const void* message, size_t length) {
+
+    /** Refuses NULL messages and messages which could not fit even in an empty ring.*/
+    if (message == NULL || length > UINT32_MAX || frame_size(length) > this->capacity) {
+        return false;
+    }
+
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before enqueueing");}
+
+    /** Waits until enough bytes have been dequeued for the frame to fit.*/
+    while (!try_write(this, message, length)) {
+        if (pthread_cond_wait(&this->not_full, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_full");}
+    }
+
+    if (pthread_cond_signal(&this->not_empty)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_empty");}
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
+    return true;
+}
+
+bool ByteQueue_tryEnq(ByteQueue* this, const void* message, size_t length) {
+
+    if (message == NULL || length > UINT32_MAX || frame_size(length) > this->capacity) {
+        return false;
+    }
+
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before enqueueing");}
+    bool success = try_write(this, message, length);
+    if (success && pthread_cond_signal(&this->not_empty)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_empty");}
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
+    return success;
+}
+
+ssize_t ByteQueue_deq(ByteQueue* this, void* buffer, size_t buffer_size) {
+
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+
+    /** Waits until there is at least one message in the ring.*/
+    while (this->current_size == ZERO) {
+        if (pthread_cond_wait(&this->not_empty, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_empty");}
+    }
+
+    /** Copies the message out and wakes the producers, which may be waiting for frames of different sizes.*/
+    ssize_t length = read_front(this, buffer, buffer_size);
+    if (length >= ZERO && pthread_cond_broadcast(&this->not_full)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed for not_full");}
+
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return length;
+}
+
+ssize_t ByteQueue_tryDeq(ByteQueue* this, void* buffer, size_t buffer_size) {
+
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    ssize_t length = -1;
+    if (this->current_size > ZERO) {
+        length = read_front(this, buffer, buffer_size);
+    }
+    if (length >= ZERO && pthread_cond_broadcast(&this->not_full)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed for not_full");}
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return length;
+}
+
+ssize_t ByteQueue_peekLength(ByteQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before peeking");}
+    ssize_t length = -1;
+    if (this->current_size > ZERO) {
+        skip_padding(this);
+        length = (ssize_t)frame_at(this, this->head)->length;
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after peeking");}
+    return length;
+}
+
+int ByteQueue_size(ByteQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before getting the current size");}
+    int size = this->current_size;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after getting the current size");}
+    return size;
+}
+
+size_t ByteQueue_bytesUsed(ByteQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before getting the bytes used");}
+    size_t used = (size_t)(this->tail - this->head);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after getting the bytes used");}
+    return used;
+}
+
+bool ByteQueue_isEmpty(ByteQueue* this) {
+    return ByteQueue_size(this) == ZERO;
+}
+
+void ByteQueue_clear(ByteQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed during clear");}
+
+    /** Releases every byte at once and wakes every producer.*/
+    this->head = this->tail;
+    this->current_size = ZERO;
+    if (pthread_cond_broadcast(&this->not_full)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed for not_full");}
+
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed during clear");}
+}
+
+void ByteQueue_destroy(ByteQueue* this) {
+    /** Destroys the synchronization primitives and frees the queue and its ring.*/
+    pthread_cond_destroy(&this->not_full);
+    pthread_cond_destroy(&this->not_empty);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
@@ -0,0 +1,114 @@
+/*
+ * ByteQueue.h
+ *
+ * Module interface for a thread-safe ring buffer of variable-length messages.
+ *
+ * Messages are copied into the ring as frames: an 8 byte header holding the length followed by the payload padded to 8 bytes.
+ * A frame never wraps around the end of the ring, the space left at the end is filled with a padding frame instead,
+ * so memory use is proportional to the bytes in flight rather than to a number of slots times the largest message.
+ *
+ */
+
+#ifndef BYTE_QUEUE_H_
+#define BYTE_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "Queue.h"
+
+/** Size in bytes of a frame header and alignment of every frame.*/
+#define BYTE_QUEUE_ALIGNMENT 8
+
+typedef struct ByteQueue ByteQueue;
+
+struct ByteQueue {
+
+    /** Mutex ensuring thread safety.*/
+    pthread_mutex_t mutex;
+
+    /** Condition signalled when a frame is added to the ring.*/
+    pthread_cond_t not_empty;
+
+    /** Condition signalled when bytes are released from the ring.*/
+    pthread_cond_t not_full;
+
+    /** Size in bytes of the ring, a multiple of BYTE_QUEUE_ALIGNMENT.*/
+    size_t capacity;
+
+    /** Total number of bytes ever consumed and produced: the ring holds the bytes between head and tail.*/
+    uint64_t head, tail;
+
+    /** Number of messages (padding frames excluded) currently in the ring.*/
+    int current_size;
+
+    /** The ring itself, allocated together with the ByteQueue.*/
+    unsigned char *buffer;
+};
+
+/*
+ * Creates a new ByteQueue holding at most capacity bytes of frames (rounded up to a multiple of BYTE_QUEUE_ALIGNMENT).
+ * Returns a pointer to a new ByteQueue on success and NULL on failure.
+ */
+ByteQueue* new_ByteQueue(size_t capacity);
+
+/*
+ * Copies the length bytes pointed to by message into a new frame at the back of this Queue.
+ * If there is not enough room, the function will block the calling thread until enough bytes are dequeued.
+ * Returns false when message is NULL or the frame could never fit in the ring, and true on success.
+ */
+bool ByteQueue_enq(ByteQueue* this, const void* message, size_t length);
+
+/*
+ * Non-blocking version of ByteQueue_enq.
+ * Returns false when message is NULL or there is not enough room for the frame right now, and true on success.
+ */
+bool ByteQueue_tryEnq(ByteQueue* this, const void* message, size_t length);
+
+/*
+ * Copies the front message of this Queue into buffer and removes it.
+ * If the queue is empty, the function will block until a message can be dequeued.
+ * Returns the length of the message, or -1 (leaving the message in the queue) when buffer is NULL or smaller than the message.
+ */
+ssize_t ByteQueue_deq(ByteQueue* this, void* buffer, size_t buffer_size);
+
+/*
+ * Non-blocking version of ByteQueue_deq.
+ * Returns the length of the message, or -1 when the queue is empty or buffer is NULL or smaller than the message.
+ */
+ssize_t ByteQueue_tryDeq(ByteQueue* this, void* buffer, size_t buffer_size);
+
+/*
+ * Returns the length of the front message of this Queue, or -1 if it is empty.
+ */
+ssize_t ByteQueue_peekLength(ByteQueue* this);
+
+/*
+ * Returns the number of messages currently in this Queue.
+ */
+int ByteQueue_size(ByteQueue* this);
+
+/*
+ * Returns the number of bytes (frame headers and padding included) currently used in the ring.
+ */
+size_t ByteQueue_bytesUsed(ByteQueue* this);
+
+/*
+ * Returns true if this Queue is empty, false otherwise.
+ */
+bool ByteQueue_isEmpty(ByteQueue* this);
+
+/*
+ * Clears this Queue returning it to an empty state and waking blocked producers.
+ */
+void ByteQueue_clear(ByteQueue* this);
+
+/*
+ * Destroys this Queue by freeing the memory used by the Queue.
+ */
+void ByteQueue_destroy(ByteQueue* this);
+
+#endif /* BYTE_QUEUE_H_ */
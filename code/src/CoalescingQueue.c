@@ -0,0 +1,219 @@
+/*
+ * CoalescingQueue.c
+ *
+ * Keyed Blocking Queue coalescing the updates of pending keys.
+ *
+ * Entries never move once in the ring, so the hash index maps a key to its ring slot for as long as it is pending. The index
+ * is kept at most half full, and deletions shift the following cells of the probe sequence back instead of leaving tombstones,
+ * so lookups stay short however many keys come and go.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "CoalescingQueue.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the CoalescingQueue, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(CoalescingQueue* this, char *error_mesg) {
+    CoalescingQueue_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function returning the home cell of a key in the index, mixing its bits so that sequential keys spread out.
+*/
+static int home_cell(CoalescingQueue* this, uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (int)(key & (uint64_t)this->index_mask);
+}
+
+/**
+ * Private function returning the cell of the index holding the given key or, when the key is not pending, the empty cell
+ * where it would be inserted.
+*/
+static int find_cell(CoalescingQueue* this, uint64_t key) {
+    int cell = home_cell(this, key);
+    while (this->index[cell] != ZERO && this->entries[this->index[cell] - ONE].key != key) {
+        cell = (cell + ONE) & this->index_mask;
+    }
+    return cell;
+}
+
+/**
+ * Private function emptying the given cell of the index, shifting back the cells after it which would no longer be reachable
+ * from their home cell.
+*/
+static void remove_cell(CoalescingQueue* this, int cell) {
+    int next = cell;
+    while (true) {
+        next = (next + ONE) & this->index_mask;
+        if (this->index[next] == ZERO) {
+            break;
+        }
+        int home = home_cell(this, this->entries[this->index[next] - ONE].key);
+
+        /** The cell at next can move to the hole unless its home lies cyclically between the hole (excluded) and next.*/
+        bool reachable = cell <= next ? (home > cell && home <= next) : (home > cell || home <= next);
+        if (!reachable) {
+            this->index[cell] = this->index[next];
+            cell = next;
+        }
+    }
+    this->index[cell] = ZERO;
+}
+
+CoalescingQueue* new_CoalescingQueue(int max_size, CoalescingMerge merge, void* ctx) {
+
+    /** Checks that the given max_size is a valid maximum capacity, small enough for an index of twice its size.*/
+    if (max_size <= ZERO || max_size > INT_MAX / FOUR) {
+        return NULL;
+    }
+    int index_size = ONE;
+    while (index_size < TWO * max_size) {
+        index_size *= TWO;
+    }
+
+    /** Allocate memory for the structure, the ring and the index in one block.*/
+    CoalescingQueue *this = malloc(sizeof(CoalescingQueue) + max_size * sizeof(CoalescingEntry) + index_size * sizeof(int));
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for CoalescingQueue");
+        return NULL;
+    }
+    this->entries = (CoalescingEntry*)(this + ONE);
+    this->index = (int*)(this->entries + max_size);
+    for (int i = ZERO; i < index_size; i++) {
+        this->index[i] = ZERO;
+    }
+    this->index_mask = index_size - ONE;
+    this->head = ZERO;
+    this->current_size = ZERO;
+    this->max_size = max_size;
+    this->merge = merge;
+    this->ctx = ctx;
+    this->coalesced = ZERO;
+
+    if (pthread_mutex_init(&this->mutex, NULL)
+            || pthread_cond_init(&this->not_empty, NULL)
+            || pthread_cond_init(&this->not_full, NULL)) {
+        perror("Error: failed to initialize CoalescingQueue synchronization");
+        free(this);
+        return NULL;
+    }
+    return this;
+}
+
+bool CoalescingQueue_enq(CoalescingQueue* this, uint64_t key, void* value) {
+
+    /** Check that the value is not NULL.*/
+    if (value == NULL) {
+        return false;
+    }
+
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before enqueueing");}
+    int cell;
+    while (true) {
+        cell = find_cell(this, key);
+        if (this->index[cell] != ZERO) {
+            /** The key is pending: folds the update into its entry, which keeps its position.*/
+            CoalescingEntry *entry = &this->entries[this->index[cell] - ONE];
+            entry->value = this->merge == NULL ? value : this->merge(entry->value, value, this->ctx);
+            this->coalesced++;
+            if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after coalescing");}
+            return true;
+        }
+        if (this->current_size < this->max_size) {
+            break;
+        }
+        /** A new key needs a slot: waits for a deq, then looks the key up again as another thread may have enqueued it.*/
+        if (pthread_cond_wait(&this->not_full, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_full");}
+    }
+
+    int slot = (this->head + this->current_size) % this->max_size;
+    this->entries[slot].key = key;
+    this->entries[slot].value = value;
+    this->index[cell] = slot + ONE;
+    this->current_size++;
+
+    if (pthread_cond_signal(&this->not_empty)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_empty");}
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
+    return true;
+}
+
+/**
+ * Private function removing the front entry of a non-empty queue, under the mutex.
+ * Returns its value, and stores its key at the given address when key is not NULL.
+*/
+static void* take_front(CoalescingQueue* this, uint64_t* key) {
+    CoalescingEntry *entry = &this->entries[this->head];
+    remove_cell(this, find_cell(this, entry->key));
+    if (key != NULL) {
+        *key = entry->key;
+    }
+    this->head = (this->head + ONE) % this->max_size;
+    this->current_size--;
+
+    /** Wakes every producer, as those whose key was enqueued meanwhile coalesce without using the slot.*/
+    if (pthread_cond_broadcast(&this->not_full)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed for not_full");}
+    return entry->value;
+}
+
+void* CoalescingQueue_deq(CoalescingQueue* this, uint64_t* key) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    while (this->current_size == ZERO) {
+        if (pthread_cond_wait(&this->not_empty, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_empty");}
+    }
+    void *value = take_front(this, key);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return value;
+}
+
+void* CoalescingQueue_tryDeq(CoalescingQueue* this, uint64_t* key) {
+    void *value = NULL;
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    if (this->current_size > ZERO) {
+        value = take_front(this, key);
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return value;
+}
+
+int CoalescingQueue_size(CoalescingQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before reading the size");}
+    int size = this->current_size;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after reading the size");}
+    return size;
+}
+
+bool CoalescingQueue_isEmpty(CoalescingQueue* this) {
+    return CoalescingQueue_size(this) == ZERO;
+}
+
+long CoalescingQueue_coalesced(CoalescingQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before reading the coalesced count");}
+    long coalesced = this->coalesced;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after reading the coalesced count");}
+    return coalesced;
+}
+
+void CoalescingQueue_destroy(CoalescingQueue* this) {
+    /** Destroys the synchronization, then frees the queue with its ring and index.*/
+    pthread_cond_destroy(&this->not_full);
+    pthread_cond_destroy(&this->not_empty);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
@@ -0,0 +1,115 @@
+/*
+ * CoalescingQueue.h
+ *
+ * Module interface for a fixed-size keyed Blocking Queue which coalesces updates: an enq for a key already in the queue
+ * replaces its pending value in place, or merges the two values with a callback, and the key keeps its original FIFO position.
+ * The queue therefore holds at most one entry per distinct key, and its capacity bounds the number of distinct pending keys
+ * rather than the number of events.
+ *
+ * Entries live in a ring of slots, found by key through an open-addressing hash index (linear probing, backward-shift deletion)
+ * holding the ring slot of each pending key.
+ *
+ */
+
+#ifndef COALESCING_QUEUE_H_
+#define COALESCING_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "Queue.h"
+
+/*
+ * Callback merging an update into the value pending for the same key, returning the value to keep in the queue.
+ * It runs under the queue's mutex, with the ctx given at creation.
+ */
+typedef void* (*CoalescingMerge)(void* pending, void* update, void* ctx);
+
+typedef struct CoalescingEntry CoalescingEntry;
+typedef struct CoalescingQueue CoalescingQueue;
+
+/*
+ * Slot of the ring: a pending key and its value.
+ */
+struct CoalescingEntry {
+    uint64_t key;
+    void *value;
+};
+
+struct CoalescingQueue {
+
+    /** Mutex ensuring thread safety.*/
+    pthread_mutex_t mutex;
+
+    /** Condition variables consumers wait on while the queue is empty, and producers of new keys while it is full.*/
+    pthread_cond_t not_empty, not_full;
+
+    /** Ring of pending entries, in FIFO order from head.*/
+    CoalescingEntry *entries;
+    int head;
+    int current_size;
+    int max_size;
+
+    /** Hash index of the pending keys: each cell holds a ring slot plus one, or 0 when empty. Its size is a power of two.*/
+    int *index;
+    int index_mask;
+
+    /** Merge callback and its context, NULL to replace the pending value.*/
+    CoalescingMerge merge;
+    void *ctx;
+
+    /** Number of enqs folded into an entry already pending.*/
+    long coalesced;
+};
+
+/*
+ * Creates a new CoalescingQueue for at most max_size distinct pending keys.
+ * merge combines an update with the value pending for its key, with ctx as last argument; NULL replaces the pending value.
+ * Returns a pointer to a new CoalescingQueue on success and NULL on failure.
+ */
+CoalescingQueue* new_CoalescingQueue(int max_size, CoalescingMerge merge, void* ctx);
+
+/*
+ * Enqueues the given void* value for the given key. If the key is already pending, its value is replaced, or merged with
+ * the merge callback, at its current position. Otherwise the key goes to the back of this Queue and, if the queue is
+ * full, the function will block the calling thread until there is space in the queue.
+ * Returns false when value is NULL, true on success.
+ */
+bool CoalescingQueue_enq(CoalescingQueue* this, uint64_t key, void* value);
+
+/*
+ * Dequeues the entry at the front of this Queue, storing its key at the given address when key is not NULL.
+ * If the queue is empty, the function will block until an entry can be dequeued.
+ * Returns the dequeued void* value.
+ */
+void* CoalescingQueue_deq(CoalescingQueue* this, uint64_t* key);
+
+/*
+ * Non-blocking version of CoalescingQueue_deq.
+ * Returns the dequeued void* value, or NULL when the queue is empty.
+ */
+void* CoalescingQueue_tryDeq(CoalescingQueue* this, uint64_t* key);
+
+/*
+ * Returns the number of distinct keys pending in this Queue.
+ */
+int CoalescingQueue_size(CoalescingQueue* this);
+
+/*
+ * Returns true if this Queue is empty, false otherwise.
+ */
+bool CoalescingQueue_isEmpty(CoalescingQueue* this);
+
+/*
+ * Returns the number of enqs folded into an entry which was already pending.
+ */
+long CoalescingQueue_coalesced(CoalescingQueue* this);
+
+/*
+ * Destroys this Queue by freeing the memory used by the Queue.
+ */
+void CoalescingQueue_destroy(CoalescingQueue* this);
+
+#endif /* COALESCING_QUEUE_H_ */
@@ -0,0 +1,316 @@
+/*
+ * CombiningBlockingQueue.c
+ *
+ * Flat combining Blocking Queue.
+ *
+ * Combining adapts to contention: a thread finding no active combiner sets the combining flag and applies its operation directly,
+ * like a plain lock, and only publishes it in a record if the flag is taken or the ring cannot satisfy the operation yet.
+ *
+ * A thread publishes its operation in a record, then tries to become the combiner by setting the combining flag. The combiner
+ * makes passes over the records, applying every pending operation the ring can satisfy, until a pass makes no progress.
+ * Blocking comes for free: an enq on a full ring or a deq on an empty ring stays pending until a later pass can apply it.
+ *
+ * When the combiner clears the flag it checks the records once more. Both this check and the publication of a record are
+ * sequentially consistent, so either the combiner sees a record published while it was releasing the flag, or the publisher
+ * finds the flag cleared and combines itself: no pending operation the ring could satisfy is left without a combiner.
+ *
+ * Threads finding every record in use read the epoch, try to claim a record or to apply their operation as the combiner, and
+ * sleep until the epoch changes if both fail: freeing a record and releasing the combining flag increment it, so a thread never
+ * sleeps through the event that would let it through, and never spins while the ring cannot satisfy its operation.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "CombiningBlockingQueue.h"
+
+/** Index of the record the calling thread claimed last, tried first so that a thread tends to keep the same record.*/
+static _Thread_local int record_hint;
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the CombiningBlockingQueue, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(CombiningBlockingQueue* this, char *error_mesg) {
+    CombiningBlockingQueue_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function claiming a free publication record.
+ * Returns NULL when every record is in use.
+*/
+static CombiningRecord* claim_record(CombiningBlockingQueue* this) {
+    for (int i = ZERO; i < this->max_threads; i++) {
+        int index = (record_hint + i) % this->max_threads;
+        int expected = COMBINING_RECORD_FREE;
+        if (atomic_compare_exchange_strong(&this->records[index].state, &expected, COMBINING_RECORD_CLAIMED)) {
+            record_hint = index;
+            return &this->records[index];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Private function applying the operation of a record to the ring, called by the combiner.
+ * Returns false if the ring cannot satisfy the operation yet.
+*/
+static bool apply(CombiningBlockingQueue* this, CombiningRecord* record) {
+    switch (atomic_load_explicit(&record->op, memory_order_relaxed)) {
+        case COMBINING_OP_ENQ:
+            if (!Queue_enq(&this->queue, atomic_load_explicit(&record->element, memory_order_relaxed))) {
+                return false;
+            }
+            break;
+        case COMBINING_OP_DEQ:
+            if (Queue_isEmpty(&this->queue)) {
+                return false;
+            }
+            atomic_store_explicit(&record->element, Queue_deq(&this->queue), memory_order_relaxed);
+            break;
+        default:
+            Queue_clear(&this->queue);
+            break;
+    }
+    atomic_store_explicit(&this->current_size, Queue_size(&this->queue), memory_order_relaxed);
+    return true;
+}
+
+/**
+ * Private function returning true if a pending record could be applied to the ring as it is now.
+*/
+static bool has_satisfiable(CombiningBlockingQueue* this) {
+    int size = atomic_load(&this->current_size);
+    for (int i = ZERO; i < this->max_threads; i++) {
+        CombiningRecord *record = &this->records[i];
+        if (atomic_load(&record->state) == COMBINING_RECORD_PENDING) {
+            /** The record may have been served and claimed again since, which at worst makes the caller combine for nothing.*/
+            int op = atomic_load_explicit(&record->op, memory_order_relaxed);
+            if (op == COMBINING_OP_CLEAR
+                    || (op == COMBINING_OP_ENQ && size < this->max_size)
+                    || (op == COMBINING_OP_DEQ && size > ZERO)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Private function applying the pending operations until a pass makes no progress, called by the combiner.
+*/
+static void combine_passes(CombiningBlockingQueue* this) {
+    /** An enq may let a deq through and the other way round, so a pass with progress is followed by another one.*/
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int i = ZERO; i < this->max_threads; i++) {
+            CombiningRecord *record = &this->records[i];
+            if (atomic_load_explicit(&record->state, memory_order_acquire) == COMBINING_RECORD_PENDING && apply(this, record)) {
+                atomic_store_explicit(&record->state, COMBINING_RECORD_DONE, memory_order_release);
+                if (sem_post(&record->served)) { cleanup_exit(this, "Error: sem_post() failed for served semaphore");}
+                progress = true;
+            }
+        }
+    }
+}
+
+/**
+ * Private function moving the epoch on after a record was freed or the combining flag released, and waking the threads without
+ * a record if any sleep.
+*/
+static void advance_epoch(CombiningBlockingQueue* this) {
+    atomic_fetch_add(&this->epoch, ONE);
+    if (atomic_load(&this->overflow_waiting) > ZERO) {
+        if (pthread_mutex_lock(&this->overflow_mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waking threads without a record");}
+        if (pthread_cond_broadcast(&this->overflow_changed)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed for overflow_changed");}
+        if (pthread_mutex_unlock(&this->overflow_mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waking threads without a record");}
+    }
+}
+
+/**
+ * Private function releasing the combining flag.
+*/
+static void release_combining(CombiningBlockingQueue* this) {
+    atomic_store(&this->combining, false);
+    advance_epoch(this);
+}
+
+/**
+ * Private function combining the pending operations, unless another thread is already the combiner.
+*/
+static void combine(CombiningBlockingQueue* this) {
+    do {
+        /** Another combiner will see the pending records, including those found by the check below.*/
+        if (atomic_exchange(&this->combining, true)) {
+            return;
+        }
+        combine_passes(this);
+        release_combining(this);
+    } while (has_satisfiable(this));
+}
+
+/**
+ * Private function applying an operation which has no publication record directly, if the calling thread can become the
+ * combiner, then serving the records it may have unblocked.
+ * Returns true if the operation was applied.
+*/
+static bool apply_directly(CombiningBlockingQueue* this, CombiningRecord* operation) {
+    if (atomic_exchange(&this->combining, true)) {
+        return false;
+    }
+    bool applied = apply(this, operation);
+    if (applied) {
+        atomic_fetch_add_explicit(&this->direct_ops, ONE, memory_order_relaxed);
+    }
+    combine_passes(this);
+    release_combining(this);
+    if (has_satisfiable(this)) {
+        combine(this);
+    }
+    return applied;
+}
+
+/**
+ * Private function publishing an operation, combining if possible, and waiting until it is applied.
+ * Returns the element held by the record once the operation is done.
+*/
+static void* run_operation(CombiningBlockingQueue* this, int op, void* element) {
+    CombiningRecord operation;
+    atomic_init(&operation.op, op);
+    atomic_init(&operation.element, element);
+
+    /** Uncontended: no combiner is active, so applies the operation directly instead of publishing it and waiting on a semaphore.*/
+    if (!atomic_load_explicit(&this->combining, memory_order_relaxed) && apply_directly(this, &operation)) {
+        return atomic_load_explicit(&operation.element, memory_order_relaxed);
+    }
+
+    CombiningRecord *record;
+    unsigned int epoch = atomic_load(&this->epoch);
+    while ((record = claim_record(this)) == NULL) {
+        /**
+         * Every record is in use, possibly by operations the ring cannot satisfy until this one is applied, as when all of
+         * them are deqs on an empty ring: rather than only waiting for a free record, applies the operation without one.
+        */
+        if (apply_directly(this, &operation)) {
+            return atomic_load_explicit(&operation.element, memory_order_relaxed);
+        }
+
+        /** Sleeps until a record is freed or a combiner is done, unless one of them happened since the epoch was read.*/
+        if (pthread_mutex_lock(&this->overflow_mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waiting for a record");}
+        atomic_fetch_add(&this->overflow_waiting, ONE);
+        while (atomic_load(&this->epoch) == epoch) {
+            if (pthread_cond_wait(&this->overflow_changed, &this->overflow_mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for overflow_changed");}
+        }
+        atomic_fetch_sub(&this->overflow_waiting, ONE);
+        epoch = atomic_load(&this->epoch);
+        if (pthread_mutex_unlock(&this->overflow_mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waiting for a record");}
+    }
+    atomic_store_explicit(&record->op, op, memory_order_relaxed);
+    atomic_store_explicit(&record->element, element, memory_order_relaxed);
+    atomic_store(&record->state, COMBINING_RECORD_PENDING);
+
+    combine(this);
+
+    /** Every operation is posted exactly once, by whichever thread applied it.*/
+    if (sem_wait(&record->served)) { cleanup_exit(this, "Error: sem_wait() failed for served semaphore");}
+    void *result = atomic_load_explicit(&record->element, memory_order_relaxed);
+    atomic_store_explicit(&record->state, COMBINING_RECORD_FREE, memory_order_release);
+    advance_epoch(this);
+    return result;
+}
+
+CombiningBlockingQueue* new_CombiningBlockingQueue(int max_size, int max_threads) {
+
+    /** Checks that the given sizes are valid.*/
+    if (max_size <= ZERO || max_threads <= ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the structure and the slots in one block, and for the cache line aligned records.*/
+    CombiningBlockingQueue *this = malloc(sizeof(CombiningBlockingQueue) + Queue_storageSize(max_size));
+    CombiningRecord *records = aligned_alloc(COMBINING_CACHE_LINE, max_threads * sizeof(CombiningRecord));
+    if (this == NULL || records == NULL) {
+        perror("Error: Failed to allocate memory for CombiningBlockingQueue");
+        free(this);
+        free(records);
+        return NULL;
+    }
+
+    Queue_init(&this->queue, max_size, this + ONE);
+    this->max_size = max_size;
+    this->max_threads = max_threads;
+    this->records = records;
+    atomic_init(&this->combining, false);
+    atomic_init(&this->current_size, ZERO);
+    atomic_init(&this->epoch, ZERO);
+    atomic_init(&this->overflow_waiting, ZERO);
+    atomic_init(&this->direct_ops, ZERO);
+
+    if (pthread_mutex_init(&this->overflow_mutex, NULL) || pthread_cond_init(&this->overflow_changed, NULL)) {
+        perror("Error: failed to initialize CombiningBlockingQueue synchronization");
+        free(this);
+        free(records);
+        return NULL;
+    }
+
+    for (int i = ZERO; i < max_threads; i++) {
+        atomic_init(&records[i].state, COMBINING_RECORD_FREE);
+        atomic_init(&records[i].op, COMBINING_OP_ENQ);
+        atomic_init(&records[i].element, NULL);
+        if (sem_init(&records[i].served, ZERO, ZERO)) { cleanup_exit(this, "Error: Failed to initialize served semaphore");}
+    }
+    return this;
+}
+
+bool CombiningBlockingQueue_enq(CombiningBlockingQueue* this, void* element) {
+
+    /** Check that the element is not NULL.*/
+    if (element == NULL) {
+        return false;
+    }
+    run_operation(this, COMBINING_OP_ENQ, element);
+    return true;
+}
+
+void* CombiningBlockingQueue_deq(CombiningBlockingQueue* this) {
+    return run_operation(this, COMBINING_OP_DEQ, NULL);
+}
+
+int CombiningBlockingQueue_size(CombiningBlockingQueue* this) {
+    return atomic_load(&this->current_size);
+}
+
+bool CombiningBlockingQueue_isEmpty(CombiningBlockingQueue* this) {
+    return CombiningBlockingQueue_size(this) == ZERO;
+}
+
+long CombiningBlockingQueue_directOps(CombiningBlockingQueue* this) {
+    return atomic_load(&this->direct_ops);
+}
+
+void CombiningBlockingQueue_clear(CombiningBlockingQueue* this) {
+    /** The combiner applies the clear between two passes, then the pending enqs fill the freed slots.*/
+    run_operation(this, COMBINING_OP_CLEAR, NULL);
+}
+
+void CombiningBlockingQueue_destroy(CombiningBlockingQueue* this) {
+    /** Destroys the semaphore of every record, then frees the records and the queue with its slots.*/
+    for (int i = ZERO; i < this->max_threads; i++) {
+        sem_destroy(&this->records[i].served);
+    }
+    pthread_cond_destroy(&this->overflow_changed);
+    pthread_mutex_destroy(&this->overflow_mutex);
+    Queue_deinit(&this->queue);
+    free(this->records);
+    free(this);
+}
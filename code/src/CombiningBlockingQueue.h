@@ -0,0 +1,143 @@
+/*
+ * CombiningBlockingQueue.h
+ *
+ * Module interface for a fixed-size Blocking Queue using flat combining: threads publish their operations in publication
+ * records and whichever thread becomes the combiner applies every pending operation to the ring in one pass, so that the
+ * ring's cache lines stay with one core instead of following each lock handoff. Without contention a thread applies its
+ * operation directly, as with a lock, and combining only starts once threads find a combiner already active.
+ *
+ */
+
+#ifndef COMBINING_BLOCKING_QUEUE_H_
+#define COMBINING_BLOCKING_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "Queue.h"
+
+/** Size of a cache line, publication records are aligned on it so that publishing one never invalidates another.*/
+#define COMBINING_CACHE_LINE 64
+
+/** States of a publication record.*/
+#define COMBINING_RECORD_FREE 0
+#define COMBINING_RECORD_CLAIMED 1
+#define COMBINING_RECORD_PENDING 2
+#define COMBINING_RECORD_DONE 3
+
+/** Operations a publication record can hold.*/
+#define COMBINING_OP_ENQ 0
+#define COMBINING_OP_DEQ 1
+#define COMBINING_OP_CLEAR 2
+
+typedef struct CombiningRecord CombiningRecord;
+typedef struct CombiningBlockingQueue CombiningBlockingQueue;
+
+/*
+ * Publication record holding the operation of one thread.
+ */
+struct CombiningRecord {
+
+    /** COMBINING_RECORD_FREE until a thread claims it, PENDING once its operation is published, DONE once the combiner applied it.*/
+    _Alignas(COMBINING_CACHE_LINE) _Atomic int state;
+
+    /**
+     * Operation to apply, COMBINING_OP_ENQ, DEQ or CLEAR. Atomic because the combiner may read it from a record it saw pending
+     * while the record is being freed and claimed again.
+    */
+    _Atomic int op;
+
+    /** Element to enqueue, or dequeued element once the operation is done, atomic for the same reason as op.*/
+    void* _Atomic element;
+
+    /** Semaphore posted by the combiner once it applied the operation, the owner of the record waits on it.*/
+    sem_t served;
+};
+
+struct CombiningBlockingQueue {
+
+    /** Internal non-thread-safe Queue, only used by the combiner. Its slots follow this struct.*/
+    Queue queue;
+
+    /** True while a thread is combining, the combiner is the only thread touching queue.*/
+    _Atomic bool combining;
+
+    /** Number of elements in the queue, written by the combiner so that size and isEmpty need no lock.*/
+    _Atomic int current_size;
+
+    /** Maximum capacity of the queue.*/
+    int max_size;
+
+    /** Number of publication records, the maximum number of operations in progress at once.*/
+    int max_threads;
+
+    /** Publication records, one cache line each.*/
+    CombiningRecord *records;
+
+    /**
+     * Incremented whenever a record is freed or a combiner releases the combining flag, the only events which can let a thread
+     * without a record make progress, and number of such threads sleeping until it changes.
+    */
+    _Atomic unsigned int epoch;
+    _Atomic int overflow_waiting;
+
+    /** Mutex and condition variable the threads without a record sleep on.*/
+    pthread_mutex_t overflow_mutex;
+    pthread_cond_t overflow_changed;
+
+    /** Number of operations applied directly by their own thread, without publishing a record.*/
+    _Atomic long direct_ops;
+};
+
+/*
+ * Creates a new CombiningBlockingQueue for at most max_size void* elements, used by at most max_threads threads at once.
+ * More threads may use it, the extra ones apply their operations themselves whenever they can become the combiner, and
+ * otherwise sleep until a record is freed or a combiner is done.
+ * Returns a pointer to a new CombiningBlockingQueue on success and NULL on failure.
+ */
+CombiningBlockingQueue* new_CombiningBlockingQueue(int max_size, int max_threads);
+
+/*
+ * Enqueues the given void* element at the back of this Queue.
+ * If the queue is full, the function will block the calling thread until there is space in the queue.
+ * Returns false when element is NULL and true on success.
+ */
+bool CombiningBlockingQueue_enq(CombiningBlockingQueue* this, void* element);
+
+/*
+ * Dequeues an element from the front of this Queue.
+ * If the queue is empty, the function will block until an element can be dequeued.
+ * Returns the dequeued void* element.
+ */
+void* CombiningBlockingQueue_deq(CombiningBlockingQueue* this);
+
+/*
+ * Returns the number of elements currently in this Queue, without taking any lock.
+ */
+int CombiningBlockingQueue_size(CombiningBlockingQueue* this);
+
+/*
+ * Returns true if this Queue is empty, false otherwise, without taking any lock.
+ */
+bool CombiningBlockingQueue_isEmpty(CombiningBlockingQueue* this);
+
+/*
+ * Returns the number of operations applied directly by their own thread, because no combiner was active, without publishing
+ * a record nor waiting to be served.
+ */
+long CombiningBlockingQueue_directOps(CombiningBlockingQueue* this);
+
+/*
+ * Clears this Queue returning it to an empty state. Safe to call while other threads are blocked on the queue.
+ */
+void CombiningBlockingQueue_clear(CombiningBlockingQueue* this);
+
+/*
+ * Destroys this Queue by freeing the memory used by the Queue.
+ */
+void CombiningBlockingQueue_destroy(CombiningBlockingQueue* this);
+
+#endif /* COMBINING_BLOCKING_QUEUE_H_ */
@@ -0,0 +1,343 @@
+/*
+ * DelayQueue.c
+ *
+ * Delayed Blocking Queue backed by a hierarchical timing wheel with 1 millisecond ticks.
+ *
+ * A node is placed at the level of the highest 6 bit group in which its ready_at time differs from the time of the wheel,
+ * in the slot given by that group of ready_at. Its slot is therefore ahead of the wheel at its level, and every node of a
+ * slot of level L shares the same higher groups. When the wheel reaches the start of such a slot, the slot is cascaded: its
+ * nodes are placed again, now at lower levels. Level 0 slots hold nodes due at one exact millisecond, which move to the
+ * ready list when the wheel reaches it.
+ *
+ * The wheel never ticks through empty milliseconds: the occupancy bitmaps give the next time a slot needs attention,
+ * and the wheel jumps there directly, then to the current time.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "DelayQueue.h"
+
+/** Bits of time covered by the wheel, times further away than its span go to the overflow list.*/
+#define WHEEL_BITS (DELAY_QUEUE_LEVELS * DELAY_QUEUE_SLOT_BITS)
+
+/** Time returned when no slot needs attention.*/
+#define NO_EVENT UINT64_MAX
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the DelayQueue, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(DelayQueue* this, char *error_mesg) {
+    DelayQueue_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function appending a node to a list.
+*/
+static void list_append(DelayList* list, DelayNode* node) {
+    node->next = NULL;
+    if (list->tail == NULL) {
+        list->head = node;
+    } else {
+        list->tail->next = node;
+    }
+    list->tail = node;
+}
+
+/**
+ * Private function removing every node from a list and returning the first one.
+*/
+static DelayNode* list_take(DelayList* list) {
+    DelayNode *head = list->head;
+    list->head = list->tail = NULL;
+    return head;
+}
+
+/**
+ * Private function returning the group of 6 bits of the given time used by the given level.
+*/
+static unsigned int group_of(uint64_t time, int level) {
+    return (unsigned int)(time >> (level * DELAY_QUEUE_SLOT_BITS)) & (DELAY_QUEUE_SLOTS - ONE);
+}
+
+/**
+ * Private function placing a node in the ready list, the wheel or the overflow list according to its ready_at time.
+*/
+static void place(DelayQueue* this, DelayNode* node) {
+    if (node->ready_at <= this->current) {
+        list_append(&this->ready, node);
+        return;
+    }
+
+    /** The level is given by the highest bit in which ready_at and the time of the wheel differ.*/
+    int level = (63 - __builtin_clzll(node->ready_at ^ this->current)) / DELAY_QUEUE_SLOT_BITS;
+    if (level >= DELAY_QUEUE_LEVELS) {
+        list_append(&this->overflow, node);
+        if (node->ready_at < this->overflow_at) {
+            this->overflow_at = node->ready_at;
+        }
+        return;
+    }
+    unsigned int slot = group_of(node->ready_at, level);
+    list_append(&this->slots[level][slot], node);
+    this->occupied[level] |= (uint64_t)ONE << slot;
+}
+
+/**
+ * Private function returning the next time at which a slot must be cascaded or made ready, or NO_EVENT if the wheel is empty.
+*/
+static uint64_t next_event(DelayQueue* this) {
+    uint64_t next = NO_EVENT;
+    for (int level = ZERO; level < DELAY_QUEUE_LEVELS; level++) {
+        unsigned int group = group_of(this->current, level);
+
+        /** Level 0 slots are due at their own millisecond, higher slots need attention once the wheel enters them.*/
+        uint64_t ahead = (level == ZERO) ? ~(uint64_t)ZERO << group
+                : (group == DELAY_QUEUE_SLOTS - ONE) ? ZERO : ~(uint64_t)ZERO << (group + ONE);
+        uint64_t pending = this->occupied[level] & ahead;
+        if (pending != ZERO) {
+            int shift = level * DELAY_QUEUE_SLOT_BITS;
+            uint64_t block = this->current & ~((((uint64_t)ONE) << (shift + DELAY_QUEUE_SLOT_BITS)) - ONE);
+            uint64_t time = block | ((uint64_t)__builtin_ctzll(pending) << shift);
+            if (time < next) {
+                next = time;
+            }
+        }
+    }
+
+    /** Overflow nodes are placed again when the wheel enters the span of the earliest one.*/
+    if (this->overflow.head != NULL) {
+        uint64_t time = this->overflow_at & ~((((uint64_t)ONE) << WHEEL_BITS) - ONE);
+        if (time < next) {
+            next = time;
+        }
+    }
+    return next;
+}
+
+/**
+ * Private function placing again every node of a list.
+*/
+static void place_all(DelayQueue* this, DelayNode* node) {
+    while (node != NULL) {
+        DelayNode *next = node->next;
+        place(this, node);
+        node = next;
+    }
+}
+
+/**
+ * Private function moving the wheel forward to the given time, making every node due by then ready.
+*/
+static void advance(DelayQueue* this, uint64_t now) {
+    uint64_t time;
+    while ((time = next_event(this)) <= now) {
+        this->current = time;
+
+        /** Cascades, from the top, the slots the wheel enters at this time.*/
+        if (this->overflow.head != NULL && time == (this->overflow_at & ~((((uint64_t)ONE) << WHEEL_BITS) - ONE))) {
+            this->overflow_at = NO_EVENT;
+            place_all(this, list_take(&this->overflow));
+        }
+        for (int level = DELAY_QUEUE_LEVELS - ONE; level >= ZERO; level--) {
+            int shift = level * DELAY_QUEUE_SLOT_BITS;
+            unsigned int slot = group_of(time, level);
+            if ((time & ((((uint64_t)ONE) << shift) - ONE)) == ZERO && (this->occupied[level] & ((uint64_t)ONE << slot))) {
+                this->occupied[level] &= ~((uint64_t)ONE << slot);
+                place_all(this, list_take(&this->slots[level][slot]));
+            }
+        }
+    }
+    if (now > this->current) {
+        this->current = now;
+    }
+}
+
+/**
+ * Private function removing the first ready node and returning its element to the free list, called with the mutex held.
+ * Returns the element, or NULL if no node is ready.
+*/
+static void* take_ready(DelayQueue* this) {
+    DelayNode *node = this->ready.head;
+    if (node == NULL) {
+        return NULL;
+    }
+    this->ready.head = node->next;
+    if (this->ready.head == NULL) {
+        this->ready.tail = NULL;
+    }
+    void *element = node->element;
+    node->next = this->free_nodes;
+    this->free_nodes = node;
+    this->current_size = this->current_size - ONE;
+
+    /** Wakes a producer waiting for a node, and another consumer if more elements are ready.*/
+    if (pthread_cond_signal(&this->not_full)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_full");}
+    if (this->ready.head != NULL && pthread_cond_signal(&this->not_empty)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_empty");}
+    return element;
+}
+
+/**
+ * Private function resetting the wheel and putting every node back in the free list.
+*/
+static void reset(DelayQueue* this) {
+    for (int level = ZERO; level < DELAY_QUEUE_LEVELS; level++) {
+        for (int slot = ZERO; slot < DELAY_QUEUE_SLOTS; slot++) {
+            this->slots[level][slot].head = this->slots[level][slot].tail = NULL;
+        }
+        this->occupied[level] = ZERO;
+    }
+    this->overflow.head = this->overflow.tail = NULL;
+    this->overflow_at = NO_EVENT;
+    this->ready.head = this->ready.tail = NULL;
+    this->free_nodes = NULL;
+    for (int i = this->max_size - ONE; i >= ZERO; i--) {
+        this->nodes[i].next = this->free_nodes;
+        this->free_nodes = &this->nodes[i];
+    }
+    this->current_size = ZERO;
+}
+
+uint64_t DelayQueue_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000 + (uint64_t)time.tv_nsec / 1000000;
+}
+
+DelayQueue* new_DelayQueue(int max_size) {
+
+    /** Checks that the given max_size is a valid maximum capacity.*/
+    if (max_size <= ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the DelayQueue structure and its pool of nodes in one block.*/
+    DelayQueue *this = malloc(sizeof(DelayQueue) + max_size * sizeof(DelayNode));
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for DelayQueue");
+        return NULL;
+    }
+    this->nodes = (DelayNode*)(this + ONE);
+    this->max_size = max_size;
+    this->current = DelayQueue_now();
+    reset(this);
+
+    /** The not_empty condition variable times out on the monotonic clock, the clock of ready_at times.*/
+    pthread_condattr_t attributes;
+    if (pthread_condattr_init(&attributes)
+            || pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC)
+            || pthread_mutex_init(&this->mutex, NULL)
+            || pthread_cond_init(&this->not_empty, &attributes)
+            || pthread_cond_init(&this->not_full, NULL)) {
+        perror("Error: failed to initialize DelayQueue synchronization");
+        free(this);
+        return NULL;
+    }
+    pthread_condattr_destroy(&attributes);
+    return this;
+}
+
+bool DelayQueue_enq(DelayQueue* this, void* element, uint64_t ready_at) {
+
+    /** Check that the element is not NULL.*/
+    if (element == NULL) {
+        return false;
+    }
+
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before enqueueing");}
+
+    /** Waits until a node is free.*/
+    while (this->free_nodes == NULL) {
+        if (pthread_cond_wait(&this->not_full, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_full");}
+    }
+
+    /** Brings the wheel up to date, then places the element in O(1).*/
+    advance(this, DelayQueue_now());
+    DelayNode *node = this->free_nodes;
+    this->free_nodes = node->next;
+    node->element = element;
+    node->ready_at = ready_at;
+    place(this, node);
+    this->current_size = this->current_size + ONE;
+
+    /** Wakes a consumer, which either takes the element or sleeps again until the new earliest due time.*/
+    if (pthread_cond_signal(&this->not_empty)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_empty");}
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
+    return true;
+}
+
+void* DelayQueue_deq(DelayQueue* this) {
+
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+
+    void *element;
+    while (true) {
+        advance(this, DelayQueue_now());
+        if ((element = take_ready(this)) != NULL) {
+            break;
+        }
+
+        /** Sleeps until the next slot needs attention, or until an element is enqueued.*/
+        uint64_t wake_at = next_event(this);
+        if (wake_at == NO_EVENT) {
+            if (pthread_cond_wait(&this->not_empty, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_empty");}
+        } else {
+            struct timespec deadline;
+            deadline.tv_sec = (time_t)(wake_at / 1000);
+            deadline.tv_nsec = (long)(wake_at % 1000) * 1000000;
+            int error = pthread_cond_timedwait(&this->not_empty, &this->mutex, &deadline);
+            if (error && error != ETIMEDOUT) { cleanup_exit(this, "Error: pthread_cond_timedwait() failed for not_empty");}
+        }
+    }
+
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return element;
+}
+
+void* DelayQueue_tryDeq(DelayQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    advance(this, DelayQueue_now());
+    void *element = take_ready(this);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return element;
+}
+
+int DelayQueue_size(DelayQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before getting the current size");}
+    int size = this->current_size;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after getting the current size");}
+    return size;
+}
+
+bool DelayQueue_isEmpty(DelayQueue* this) {
+    return DelayQueue_size(this) == ZERO;
+}
+
+void DelayQueue_clear(DelayQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed during clear");}
+
+    /** Drops every element at once and wakes every producer.*/
+    reset(this);
+    if (pthread_cond_broadcast(&this->not_full)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed for not_full");}
+
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed during clear");}
+}
+
+void DelayQueue_destroy(DelayQueue* this) {
+    /** Destroys the synchronization primitives and frees the queue and its nodes.*/
+    pthread_cond_destroy(&this->not_full);
+    pthread_cond_destroy(&this->not_empty);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
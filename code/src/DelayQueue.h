@@ -0,0 +1,128 @@
+/*
+ * DelayQueue.h
+ *
+ * Module interface for a fixed-size Blocking Queue of delayed elements: each element is enqueued with the time at which
+ * it becomes ready, and deq blocks until the earliest element is due. Pending elements are kept in a hierarchical
+ * timing wheel, so enqueueing costs O(1) whatever the delay.
+ *
+ */
+
+#ifndef DELAY_QUEUE_H_
+#define DELAY_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "Queue.h"
+
+/** Shape of the timing wheel: 4 levels of 64 slots, a slot of level L covering 64^L milliseconds.*/
+#define DELAY_QUEUE_LEVELS 4
+#define DELAY_QUEUE_SLOT_BITS 6
+#define DELAY_QUEUE_SLOTS (1 << DELAY_QUEUE_SLOT_BITS)
+
+typedef struct DelayNode DelayNode;
+typedef struct DelayList DelayList;
+typedef struct DelayQueue DelayQueue;
+
+/*
+ * Element waiting in the wheel, taken from a pool allocated with the queue.
+ */
+struct DelayNode {
+    void *element;
+    /** Time at which the element becomes ready, in milliseconds of DelayQueue_now.*/
+    uint64_t ready_at;
+    DelayNode *next;
+};
+
+/*
+ * FIFO list of nodes.
+ */
+struct DelayList {
+    DelayNode *head, *tail;
+};
+
+struct DelayQueue {
+
+    /** Mutex ensuring thread safety.*/
+    pthread_mutex_t mutex;
+
+    /** Condition variables signalled when an element may be due, and when a node is freed. not_empty uses the monotonic clock.*/
+    pthread_cond_t not_empty, not_full;
+
+    /** Time of the wheel, in milliseconds: every element due at or before it is in ready.*/
+    uint64_t current;
+
+    /** Slots of each level, and a bitmap per level of the slots holding nodes.*/
+    DelayList slots[DELAY_QUEUE_LEVELS][DELAY_QUEUE_SLOTS];
+    uint64_t occupied[DELAY_QUEUE_LEVELS];
+
+    /** Nodes due beyond the span of the wheel, and the earliest of their times. They are placed again when the wheel
+     * enters the span holding that time.*/
+    DelayList overflow;
+    uint64_t overflow_at;
+
+    /** Nodes which are due, in the order they became due.*/
+    DelayList ready;
+
+    /** Number of elements in the queue, due or not, and maximum capacity.*/
+    int current_size, max_size;
+
+    /** Pool of max_size nodes allocated with the queue, and list of the free ones.*/
+    DelayNode *nodes, *free_nodes;
+};
+
+/*
+ * Returns the current time in milliseconds of the monotonic clock, the clock of every ready_at time.
+ */
+uint64_t DelayQueue_now(void);
+
+/*
+ * Creates a new DelayQueue for at most max_size void* elements.
+ * Returns a pointer to a new DelayQueue on success and NULL on failure.
+ */
+DelayQueue* new_DelayQueue(int max_size);
+
+/*
+ * Enqueues the given void* element, to become ready at the time ready_at given in milliseconds of DelayQueue_now.
+ * A time in the past makes the element ready at once.
+ * If the queue is full, the function will block the calling thread until there is space in the queue.
+ * Returns false when element is NULL and true on success.
+ */
+bool DelayQueue_enq(DelayQueue* this, void* element, uint64_t ready_at);
+
+/*
+ * Dequeues the element which became ready first.
+ * If no element is ready, the function will block until the earliest element is due.
+ * Returns the dequeued void* element.
+ */
+void* DelayQueue_deq(DelayQueue* this);
+
+/*
+ * Dequeues the element which became ready first, without blocking.
+ * Returns the dequeued void* element, or NULL if no element is ready.
+ */
+void* DelayQueue_tryDeq(DelayQueue* this);
+
+/*
+ * Returns the number of elements currently in this Queue, ready or not.
+ */
+int DelayQueue_size(DelayQueue* this);
+
+/*
+ * Returns true if this Queue is empty, false otherwise.
+ */
+bool DelayQueue_isEmpty(DelayQueue* this);
+
+/*
+ * Clears this Queue returning it to an empty state, dropping the elements which are not due yet as well.
+ */
+void DelayQueue_clear(DelayQueue* this);
+
+/*
+ * Destroys this Queue by freeing the memory used by the Queue.
+ */
+void DelayQueue_destroy(DelayQueue* this);
+
+#endif /* DELAY_QUEUE_H_ */
@@ -0,0 +1,412 @@
+/*
+ * DurableQueue.c
+ *
+ * Fixed-size Queue of fixed-size records kept in a memory-mapped file.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "DurableQueue.h"
+
+/** Offset of the first slot in the file, leaving room for the header.*/
+#define HEADER_SIZE 64
+
+/** Bytes stored before the record in each slot: the sequence number and the checksum (plus padding).*/
+#define SLOT_HEADER_SIZE 16
+
+/** FNV-1a 32 bit parameters used for the record checksums.*/
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/**
+ * Private function run by the flusher thread of DURABLE_QUEUE_SYNC_INTERVAL: every interval_ms until the queue is destroyed,
+ * flushes the whole file if it changed since the previous flush.
+ *
+ * It only reads the mapping, so it needs no lock against the queue's operations: a flush overlapping a write may store a
+ * partial record, which recovery drops by its checksum, and the write marks the file dirty again for the next flush.
+*/
+static void* flush_periodically(void* queue) {
+    DurableQueue *this = queue;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    if (pthread_mutex_lock(&this->flusher_mutex)) { perror("Error: pthread_mutex_lock() failed in the DurableQueue flusher"); exit(EXIT_FAILURE);}
+    while (!this->stopping) {
+        deadline.tv_nsec += (long)(this->interval_ms % 1000) * 1000000L;
+        deadline.tv_sec += this->interval_ms / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        int error;
+        while (!this->stopping && (error = pthread_cond_timedwait(&this->flusher_stop, &this->flusher_mutex, &deadline)) != ETIMEDOUT) {
+            if (error) { perror("Error: pthread_cond_timedwait() failed in the DurableQueue flusher"); exit(EXIT_FAILURE);}
+        }
+
+        /** The handle belongs to the queue's thread, so a failure terminates the program without releasing it.*/
+        if (!this->stopping && atomic_exchange_explicit(&this->dirty, false, memory_order_acquire)
+                && msync(this->header, this->mapping_size, MS_SYNC)) {
+            perror("Error: msync() failed in the DurableQueue flusher");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (pthread_mutex_unlock(&this->flusher_mutex)) { perror("Error: pthread_mutex_unlock() failed in the DurableQueue flusher"); exit(EXIT_FAILURE);}
+    return NULL;
+}
+
+/**
+ * Private function starting the flusher thread of DURABLE_QUEUE_SYNC_INTERVAL, waiting on the monotonic clock.
+ * Returns false if it could not be started.
+*/
+static bool start_flusher(DurableQueue* this) {
+    this->stopping = false;
+    pthread_condattr_t attributes;
+    if (pthread_condattr_init(&attributes)
+            || pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC)
+            || pthread_mutex_init(&this->flusher_mutex, NULL)
+            || pthread_cond_init(&this->flusher_stop, &attributes)) {
+        return false;
+    }
+    pthread_condattr_destroy(&attributes);
+    if (pthread_create(&this->flusher, NULL, flush_periodically, this)) {
+        pthread_cond_destroy(&this->flusher_stop);
+        pthread_mutex_destroy(&this->flusher_mutex);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Private function stopping the flusher thread and waiting for it to return.
+*/
+static void stop_flusher(DurableQueue* this) {
+    pthread_mutex_lock(&this->flusher_mutex);
+    this->stopping = true;
+    pthread_cond_signal(&this->flusher_stop);
+    pthread_mutex_unlock(&this->flusher_mutex);
+    pthread_join(this->flusher, NULL);
+    pthread_cond_destroy(&this->flusher_stop);
+    pthread_mutex_destroy(&this->flusher_mutex);
+}
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function prints the error message, closes the queue and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(DurableQueue* this, char *error_mesg) {
+    /** Prints out the provided error message.*/
+    perror(error_mesg);
+
+    /** Stops the flusher thread, then releases the mapping and the file descriptor.*/
+    if (this->flushing) {
+        stop_flusher(this);
+    }
+    munmap(this->header, this->mapping_size);
+    close(this->fd);
+    free(this);
+
+    /** Terminates the program with EXIT_FAILURE status.*/
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function returning the address of the slot holding the record with the given sequence number.
+*/
+static unsigned char* slot_for(DurableQueue* this, uint64_t sequence) {
+    return (unsigned char*)this->header + HEADER_SIZE + (sequence % this->header->max_size) * this->slot_size;
+}
+
+/**
+ * Private function computing the checksum of a record and of the sequence number it was written with.
+*/
+static uint32_t checksum(uint64_t sequence, const unsigned char* record, size_t record_size) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = ZERO; i < sizeof(sequence); i++) {
+        hash = (hash ^ (unsigned char)(sequence >> (8 * i))) * FNV_PRIME;
+    }
+    for (size_t i = ZERO; i < record_size; i++) {
+        hash = (hash ^ record[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Private function returning true if the slot for the given sequence number holds a complete record written with it.
+*/
+static bool is_valid(DurableQueue* this, uint64_t sequence) {
+    unsigned char *slot = slot_for(this, sequence);
+    uint64_t stored_sequence;
+    uint32_t stored_checksum;
+    memcpy(&stored_sequence, slot, sizeof(stored_sequence));
+    memcpy(&stored_checksum, slot + sizeof(stored_sequence), sizeof(stored_checksum));
+    return stored_sequence == sequence
+        && stored_checksum == checksum(sequence, slot + SLOT_HEADER_SIZE, this->header->record_size);
+}
+
+/**
+ * Private function writing a record and its checksum into the slot for the given sequence number.
+*/
+static void write_slot(DurableQueue* this, uint64_t sequence, const unsigned char* record) {
+    unsigned char *slot = slot_for(this, sequence);
+    uint32_t record_checksum = checksum(sequence, record, this->header->record_size);
+    memcpy(slot + SLOT_HEADER_SIZE, record, this->header->record_size);
+    memcpy(slot, &sequence, sizeof(sequence));
+    memcpy(slot + sizeof(sequence), &record_checksum, sizeof(record_checksum));
+}
+
+/**
+ * Private function flushing the pages covering length bytes at the given offset in the file.
+*/
+static void flush_range(DurableQueue* this, size_t offset, size_t length) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = offset & ~(page_size - ONE);
+    if (msync((char*)this->header + start, offset + length - start, MS_SYNC)) { cleanup_exit(this, "Error: msync() failed in DurableQueue");}
+}
+
+/**
+ * Private function flushing the slots of count records starting at sequence, and the header.
+*/
+static void flush_records(DurableQueue* this, uint64_t sequence, int count) {
+    uint64_t max_size = this->header->max_size;
+    uint64_t first = sequence % max_size;
+
+    /** The records may wrap around the end of the slot array, in which case two ranges are flushed.*/
+    uint64_t before_wrap = (first + count <= max_size) ? (uint64_t)count : max_size - first;
+    if (before_wrap > ZERO) {
+        flush_range(this, HEADER_SIZE + first * this->slot_size, before_wrap * this->slot_size);
+    }
+    if (before_wrap < (uint64_t)count) {
+        flush_range(this, HEADER_SIZE, (count - before_wrap) * this->slot_size);
+    }
+    flush_range(this, ZERO, sizeof(DurableQueueHeader));
+}
+
+/**
+ * Private function applying the durability mode after count records starting at sequence have been written or removed.
+*/
+static void after_update(DurableQueue* this, uint64_t sequence, int count) {
+    if (this->sync == DURABLE_QUEUE_SYNC_BATCH) {
+        flush_records(this, sequence, count);
+    }
+    else if (this->sync == DURABLE_QUEUE_SYNC_INTERVAL && !this->flushing) {
+        DurableQueue_sync(this);
+    }
+    else {
+        atomic_store_explicit(&this->dirty, true, memory_order_release);
+    }
+}
+
+/**
+ * Private function rebuilding head and tail from the records found in the file.
+ *
+ * The queue restarts at the oldest valid record whose sequence number is not below the stored head (the stored head may be
+ * stale if the machine failed before it was flushed, in which case records are delivered again rather than lost) and ends
+ * before the first slot that does not hold the next sequence number with a matching checksum. Valid records past that slot
+ * are dropped rather than delivered after a gap.
+*/
+static void recover(DurableQueue* this) {
+    DurableQueueHeader *header = this->header;
+
+    /** Finds the oldest valid record not below the stored head.*/
+    uint64_t start = header->head;
+    bool found = false;
+    for (uint64_t i = ZERO; i < header->max_size; i++) {
+        uint64_t sequence;
+        memcpy(&sequence, (unsigned char*)header + HEADER_SIZE + i * this->slot_size, sizeof(sequence));
+        if (sequence >= header->head && sequence % header->max_size == i && is_valid(this, sequence)
+                && (!found || sequence < start)) {
+            start = sequence;
+            found = true;
+        }
+    }
+
+    /** Follows the run of consecutive valid records.*/
+    uint64_t end = start;
+    while (found && end - start < header->max_size && is_valid(this, end)) {
+        end++;
+    }
+
+    header->head = start;
+    header->tail = end;
+    this->recovered = (int)(end - start);
+}
+
+DurableQueue* new_DurableQueue(const char* path, int max_size, size_t record_size, DurableQueueSync sync, int interval_ms) {
+
+    /** Checks that the given parameters are valid.*/
+    if (path == NULL || max_size <= ZERO || record_size == ZERO || interval_ms < ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the DurableQueue structure.*/
+    DurableQueue *this = malloc(sizeof(DurableQueue));
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for DurableQueue");
+        return NULL;
+    }
+    this->slot_size = (SLOT_HEADER_SIZE + record_size + 7) & ~(size_t)7;
+    this->mapping_size = HEADER_SIZE + (size_t)max_size * this->slot_size;
+    this->sync = sync;
+    this->interval_ms = interval_ms;
+    this->recovered = ZERO;
+    atomic_init(&this->dirty, false);
+    this->flushing = false;
+
+    /** Opens or creates the backing file.*/
+    this->fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (this->fd < ZERO) {
+        perror("Error: open() failed for DurableQueue file");
+        free(this);
+        return NULL;
+    }
+
+    /** A new (empty) file is sized, an existing file must have exactly the expected size.*/
+    struct stat status;
+    bool existing = fstat(this->fd, &status) == ZERO && status.st_size > ZERO;
+    bool sized = existing ? (size_t)status.st_size == this->mapping_size : ftruncate(this->fd, (off_t)this->mapping_size) == ZERO;
+
+    void *mapping = MAP_FAILED;
+    if (sized) {
+        mapping = mmap(NULL, this->mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, ZERO);
+    }
+    if (mapping == MAP_FAILED) {
+        close(this->fd);
+        free(this);
+        return NULL;
+    }
+    this->header = mapping;
+
+    /** A creator dying between sizing the file and writing its magic leaves an all-zero header: the file is created anew.*/
+    static const DurableQueueHeader blank_header;
+    if (existing && memcmp(this->header, &blank_header, sizeof(DurableQueueHeader)) == ZERO) {
+        existing = false;
+    }
+
+    if (existing) {
+        /** Refuses files written with a different layout.*/
+        if (this->header->magic != DURABLE_QUEUE_MAGIC || this->header->max_size != (uint32_t)max_size
+                || this->header->record_size != record_size) {
+            munmap(mapping, this->mapping_size);
+            close(this->fd);
+            free(this);
+            return NULL;
+        }
+        recover(this);
+    }
+    else {
+        /** Initializes the header of a new file.*/
+        this->header->max_size = (uint32_t)max_size;
+        this->header->record_size = record_size;
+        this->header->head = this->header->tail = ZERO;
+        this->header->magic = DURABLE_QUEUE_MAGIC;
+    }
+
+    /** Makes the recovered or initial state durable before accepting operations.*/
+    if (sync != DURABLE_QUEUE_SYNC_NONE) {
+        flush_range(this, ZERO, sizeof(DurableQueueHeader));
+    }
+
+    /** Flushes every interval_ms from a thread, so that writes are flushed even once the queue goes idle.*/
+    if (sync == DURABLE_QUEUE_SYNC_INTERVAL && interval_ms > ZERO) {
+        if (!start_flusher(this)) {
+            perror("Error: Failed to start the DurableQueue flusher thread");
+            munmap(mapping, this->mapping_size);
+            close(this->fd);
+            free(this);
+            return NULL;
+        }
+        this->flushing = true;
+    }
+    return this;
+}
+
+bool DurableQueue_enq(DurableQueue* this, const void* record) {
+    return DurableQueue_enqBatch(this, record, ONE);
+}
+
+bool DurableQueue_enqBatch(DurableQueue* this, const void* records, int count) {
+
+    /** Check that the records are not NULL and that they all fit.*/
+    if (records == NULL || count <= ZERO || DurableQueue_size(this) + count > (int)this->header->max_size) {
+        return false;
+    }
+
+    /** Writes every record with its sequence number and checksum, then publishes them by moving the tail.*/
+    uint64_t first = this->header->tail;
+    for (int i = ZERO; i < count; i++) {
+        write_slot(this, first + i, (const unsigned char*)records + (size_t)i * this->header->record_size);
+    }
+    this->header->tail = first + count;
+
+    after_update(this, first, count);
+    return true;
+}
+
+bool DurableQueue_deq(DurableQueue* this, void* record) {
+
+    /** Check that the destination is not NULL and the queue is not empty.*/
+    if (record == NULL || DurableQueue_isEmpty(this)) {
+        return false;
+    }
+
+    /** Copies the front record out and moves the head forward.*/
+    uint64_t sequence = this->header->head;
+    memcpy(record, slot_for(this, sequence) + SLOT_HEADER_SIZE, this->header->record_size);
+    this->header->head = sequence + ONE;
+
+    /** Only the header changed, flushing zero records flushes just the header.*/
+    after_update(this, sequence, ZERO);
+    return true;
+}
+
+int DurableQueue_size(DurableQueue* this) {
+    /** Return the number of sequence numbers between the head and the tail.*/
+    return (int)(this->header->tail - this->header->head);
+}
+
+bool DurableQueue_isEmpty(DurableQueue* this) {
+    /** Return true if the current size is 0, indicating the queue is empty.*/
+    return DurableQueue_size(this) == ZERO;
+}
+
+int DurableQueue_recovered(DurableQueue* this) {
+    return this->recovered;
+}
+
+void DurableQueue_clear(DurableQueue* this) {
+    /** Moves the head to the tail, the old records can no longer be recovered since their sequence numbers are below the head.*/
+    this->header->head = this->header->tail;
+    after_update(this, this->header->head, ZERO);
+}
+
+void DurableQueue_sync(DurableQueue* this) {
+    /** Flushes the whole mapping.*/
+    if (msync(this->header, this->mapping_size, MS_SYNC)) { cleanup_exit(this, "Error: msync() failed in DurableQueue_sync");}
+}
+
+void DurableQueue_destroy(DurableQueue* this) {
+    /** Stops the flusher thread, then flushes pending writes unless durability was explicitly disabled.*/
+    if (this->flushing) {
+        stop_flusher(this);
+    }
+    if (this->sync != DURABLE_QUEUE_SYNC_NONE) {
+        DurableQueue_sync(this);
+    }
+
+    /** Releases the mapping, the file descriptor and the handle.*/
+    munmap(this->header, this->mapping_size);
+    close(this->fd);
+    free(this);
+}
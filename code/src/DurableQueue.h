@@ -0,0 +1,164 @@
+/*
+ * DurableQueue.h
+ *
+ * Module interface for a fixed-size Queue of fixed-size records kept in a memory-mapped file,
+ * so that queued records survive a restart of the process.
+ *
+ * A DurableQueue is not thread-safe: none of its operations take a lock, so a queue must be used by one thread at a time.
+ *
+ */
+
+#ifndef DURABLE_QUEUE_H_
+#define DURABLE_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "Queue.h"
+
+/** Value identifying a DurableQueue file.*/
+#define DURABLE_QUEUE_MAGIC 0x44555251u
+
+/*
+ * When the mapped file is flushed to stable storage with msync.
+ *
+ * Records written into a MAP_SHARED mapping survive the death of the process in every mode since they live in the page cache;
+ * the mode only decides how much can be lost if the whole machine fails.
+ */
+typedef enum DurableQueueSync {
+    /** Never flush explicitly, the kernel writes the pages back on its own schedule.*/
+    DURABLE_QUEUE_SYNC_NONE,
+    /** Flush the pages touched by every call to enq, enqBatch and deq before returning.*/
+    DURABLE_QUEUE_SYNC_BATCH,
+    /**
+     * Flush the whole file every interval_ms from a flusher thread, when it changed since the previous flush, so the writes
+     * of a queue gone idle are flushed too. With an interval of 0, flush the whole file after every call instead.
+    */
+    DURABLE_QUEUE_SYNC_INTERVAL
+} DurableQueueSync;
+
+typedef struct DurableQueueHeader DurableQueueHeader;
+typedef struct DurableQueue DurableQueue;
+
+/*
+ * Header stored at the start of the file.
+ *
+ * head and tail are sequence numbers rather than indexes: the record with sequence s lives in slot s % max_size.
+ */
+struct DurableQueueHeader {
+
+    /** DURABLE_QUEUE_MAGIC.*/
+    uint32_t magic;
+
+    /** Maximum capacity of the queue.*/
+    uint32_t max_size;
+
+    /** Size in bytes of a single record.*/
+    uint64_t record_size;
+
+    /** Sequence number of the front record, the next one to be dequeued.*/
+    uint64_t head;
+
+    /** Sequence number the next enqueued record will receive.*/
+    uint64_t tail;
+};
+
+/*
+ * Process-local handle onto a durable queue file.
+ */
+struct DurableQueue {
+
+    /** Start of the mapping of the file.*/
+    DurableQueueHeader *header;
+
+    /** Size in bytes of the mapping.*/
+    size_t mapping_size;
+
+    /** Size in bytes of a slot: a sequence number, a checksum and the record, rounded up to 8 bytes.*/
+    size_t slot_size;
+
+    /** File descriptor of the backing file.*/
+    int fd;
+
+    /** Durability mode and, for DURABLE_QUEUE_SYNC_INTERVAL, the flush interval in milliseconds.*/
+    DurableQueueSync sync;
+    int interval_ms;
+
+    /** Set by every change of the file and cleared by the flusher thread before it flushes.*/
+    _Atomic bool dirty;
+
+    /** Flusher thread of DURABLE_QUEUE_SYNC_INTERVAL with a non-zero interval, and what destroy uses to stop it.*/
+    bool flushing;
+    pthread_t flusher;
+    pthread_mutex_t flusher_mutex;
+    pthread_cond_t flusher_stop;
+    bool stopping;
+
+    /** Number of records found valid when the file was opened.*/
+    int recovered;
+};
+
+/*
+ * Opens the queue stored in the file at path, creating it for at most max_size records of record_size bytes if it does not exist.
+ * An existing file is recovered by scanning the checksum of every record following the stored head: the queue resumes at the
+ * oldest valid record not below the stored head, with the valid records which follow it up to the first missing or corrupted
+ * one. The records after that one are dropped even if valid, so a record is never delivered after one which was lost, and
+ * records written before a crash but never flushed are either kept whole or dropped.
+ * A file left with the expected size and an all-zero header, by a creator which died before initializing it, is created anew.
+ * Returns a pointer to a new DurableQueue on success and NULL on failure, including when an existing file was created with a
+ * different max_size or record_size.
+ */
+DurableQueue* new_DurableQueue(const char* path, int max_size, size_t record_size, DurableQueueSync sync, int interval_ms);
+
+/*
+ * Copies the record_size bytes pointed to by record into the back of this Queue.
+ * Returns true on success and false when record is NULL or the queue is full.
+ */
+bool DurableQueue_enq(DurableQueue* this, const void* record);
+
+/*
+ * Copies count consecutive records starting at records into the back of this Queue, flushing once for the whole batch.
+ * Returns true on success and false, enqueueing nothing, when records is NULL or there is not enough space for all of them.
+ */
+bool DurableQueue_enqBatch(DurableQueue* this, const void* records, int count);
+
+/*
+ * Copies the front record of this Queue into the record_size bytes pointed to by record and removes it.
+ * Returns true on success and false when record is NULL or the queue is empty.
+ */
+bool DurableQueue_deq(DurableQueue* this, void* record);
+
+/*
+ * Returns the number of records currently in this Queue.
+ */
+int DurableQueue_size(DurableQueue* this);
+
+/*
+ * Returns true if this Queue is empty, false otherwise.
+ */
+bool DurableQueue_isEmpty(DurableQueue* this);
+
+/*
+ * Returns the number of records that were recovered from the file when this Queue was opened.
+ */
+int DurableQueue_recovered(DurableQueue* this);
+
+/*
+ * Clears this Queue returning it to an empty state.
+ */
+void DurableQueue_clear(DurableQueue* this);
+
+/*
+ * Flushes the whole file to stable storage, whatever the durability mode.
+ */
+void DurableQueue_sync(DurableQueue* this);
+
+/*
+ * Closes this Queue, flushing it unless the durability mode is DURABLE_QUEUE_SYNC_NONE. The file is kept.
+ */
+void DurableQueue_destroy(DurableQueue* this);
+
+#endif /* DURABLE_QUEUE_H_ */
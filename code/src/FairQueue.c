@@ -0,0 +1,254 @@
+/*
+ * FairQueue.c
+ *
+ * Multi-tenant Blocking Queue with deficit round robin across per-tenant sub-rings.
+ *
+ * Producers of a tenant only take that tenant's mutex. The tenants with elements are tracked in a 64 bit bitmap, set by the
+ * producer making a sub-ring non-empty and cleared by the consumer emptying it, both under the tenant's mutex, so consumers
+ * select the next tenant from the bitmap without taking any tenant's mutex: the next set bit after the current tenant, found
+ * with a count of trailing zeros, in O(1) however many tenants are idle.
+ *
+ * Each element costs one unit of deficit, so a turn simply lasts weight elements, or less when the sub-ring empties first.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "FairQueue.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the FairQueue, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(FairQueue* this, char *error_mesg) {
+    FairQueue_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function returning the first tenant with elements after the given one, cyclically, from a non-empty bitmap.
+*/
+static int next_active(uint64_t active, int tenant) {
+    uint64_t after = tenant + ONE < FAIR_MAX_TENANTS ? active & (~0ULL << (tenant + ONE)) : ZERO;
+    return __builtin_ctzll(after != ZERO ? after : active);
+}
+
+FairQueue* new_FairQueue(int tenant_count, int capacity) {
+
+    /** Checks that the given tenant_count fits the bitmap and that capacity is a valid maximum capacity.*/
+    if (tenant_count <= ZERO || tenant_count > FAIR_MAX_TENANTS || capacity <= ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the cache line aligned structure, the tenants and the slots of their sub-rings in one block.*/
+    size_t storage_size = Queue_storageSize(capacity);
+    size_t size = sizeof(FairQueue) + tenant_count * (sizeof(FairTenant) + storage_size);
+    size = (size + FAIR_CACHE_LINE - ONE) / FAIR_CACHE_LINE * FAIR_CACHE_LINE;
+    FairQueue *this = aligned_alloc(FAIR_CACHE_LINE, size);
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for FairQueue");
+        return NULL;
+    }
+    this->tenants = (FairTenant*)(this + ONE);
+    unsigned char *storage = (unsigned char*)(this->tenants + tenant_count);
+    this->tenant_count = tenant_count;
+    this->max_capacity = capacity;
+    this->cursor = tenant_count - ONE;
+    atomic_init(&this->active, ZERO);
+    atomic_init(&this->current_size, ZERO);
+    atomic_init(&this->waiting_consumers, ZERO);
+
+    if (pthread_mutex_init(&this->mutex, NULL) || pthread_cond_init(&this->not_empty, NULL)) {
+        perror("Error: failed to initialize FairQueue synchronization");
+        free(this);
+        return NULL;
+    }
+    for (int i = ZERO; i < tenant_count; i++) {
+        FairTenant *tenant = &this->tenants[i];
+        Queue_init(&tenant->queue, capacity, storage + i * storage_size);
+        tenant->capacity = capacity;
+        tenant->deficit = ZERO;
+        atomic_init(&tenant->weight, ONE);
+        if (pthread_mutex_init(&tenant->mutex, NULL)) { cleanup_exit(this, "Error: failed to initialize tenant mutex");}
+        if (pthread_cond_init(&tenant->not_full, NULL)) { cleanup_exit(this, "Error: Failed to initialize tenant not_full condition variable");}
+    }
+    return this;
+}
+
+bool FairQueue_setWeight(FairQueue* this, int tenant, int weight) {
+    if (tenant < ZERO || tenant >= this->tenant_count || weight <= ZERO) {
+        return false;
+    }
+    atomic_store(&this->tenants[tenant].weight, weight);
+    return true;
+}
+
+bool FairQueue_setCapacity(FairQueue* this, int tenant, int capacity) {
+    if (tenant < ZERO || tenant >= this->tenant_count || capacity <= ZERO || capacity > this->max_capacity) {
+        return false;
+    }
+    FairTenant *sub = &this->tenants[tenant];
+    if (pthread_mutex_lock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before setting a capacity");}
+    sub->capacity = capacity;
+    if (pthread_cond_broadcast(&sub->not_full)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed for not_full");}
+    if (pthread_mutex_unlock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after setting a capacity");}
+    return true;
+}
+
+/**
+ * Private function enqueuing an element for a tenant, blocking while its sub-ring is at its limit when block is true.
+*/
+static bool enqueue(FairQueue* this, int tenant, void* element, bool block) {
+
+    /** Check that the element is not NULL and the tenant exists.*/
+    if (element == NULL || tenant < ZERO || tenant >= this->tenant_count) {
+        return false;
+    }
+
+    FairTenant *sub = &this->tenants[tenant];
+    if (pthread_mutex_lock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before enqueueing");}
+    while (Queue_size(&sub->queue) >= sub->capacity) {
+        if (!block) {
+            if (pthread_mutex_unlock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed on a full sub-ring");}
+            return false;
+        }
+        if (pthread_cond_wait(&sub->not_full, &sub->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_full");}
+    }
+    bool was_empty = Queue_isEmpty(&sub->queue);
+    Queue_enq(&sub->queue, element);
+    atomic_fetch_add(&this->current_size, ONE);
+    if (was_empty) {
+        atomic_fetch_or(&this->active, (uint64_t)ONE << tenant);
+    }
+    if (pthread_mutex_unlock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
+
+    /**
+     * Only the first element of a sub-ring wakes a consumer: the consumer taking an element passes the wakeup on while elements
+     * remain, so a burst for one tenant wakes as many sleeping consumers as it has elements.
+    */
+    if (was_empty) {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&this->waiting_consumers, memory_order_relaxed) > ZERO) {
+            if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waking a consumer");}
+            if (pthread_cond_signal(&this->not_empty)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_empty");}
+            if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waking a consumer");}
+        }
+    }
+    return true;
+}
+
+bool FairQueue_enq(FairQueue* this, int tenant, void* element) {
+    return enqueue(this, tenant, element, true);
+}
+
+bool FairQueue_tryEnq(FairQueue* this, int tenant, void* element) {
+    return enqueue(this, tenant, element, false);
+}
+
+/**
+ * Private function taking the next element in deficit round robin order, under the consumers' mutex.
+ * Returns the element, or NULL when no tenant has elements.
+*/
+static void* take_next(FairQueue* this, int* tenant) {
+    uint64_t active = atomic_load(&this->active);
+    if (active == ZERO) {
+        return NULL;
+    }
+
+    /** Moves on to the next tenant with elements when the current one used up its turn or has no element left.*/
+    FairTenant *sub = &this->tenants[this->cursor];
+    if (sub->deficit <= ZERO || (active & ((uint64_t)ONE << this->cursor)) == ZERO) {
+        sub->deficit = ZERO;
+        this->cursor = next_active(active, this->cursor);
+        sub = &this->tenants[this->cursor];
+        sub->deficit = atomic_load(&sub->weight);
+    }
+
+    /** Only consumers clear the bit of a tenant, so the sub-ring is still non-empty.*/
+    if (pthread_mutex_lock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    void *element = Queue_deq(&sub->queue);
+    if (Queue_isEmpty(&sub->queue)) {
+        atomic_fetch_and(&this->active, ~((uint64_t)ONE << this->cursor));
+    }
+    atomic_fetch_sub(&this->current_size, ONE);
+    if (pthread_cond_signal(&sub->not_full)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_full");}
+    if (pthread_mutex_unlock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+
+    sub->deficit--;
+    if (tenant != NULL) {
+        *tenant = this->cursor;
+    }
+    return element;
+}
+
+/**
+ * Private function passing the wakeup on to another sleeping consumer after an element was taken, under the consumers' mutex,
+ * if elements remain.
+*/
+static void pass_wakeup(FairQueue* this) {
+    if (atomic_load(&this->active) != ZERO && atomic_load(&this->waiting_consumers) > ZERO) {
+        if (pthread_cond_signal(&this->not_empty)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_empty");}
+    }
+}
+
+void* FairQueue_deq(FairQueue* this, int* tenant) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    void *element = take_next(this, tenant);
+    if (element == NULL) {
+        /** Registers as waiting, then checks the bitmap once more before each sleep.*/
+        atomic_fetch_add(&this->waiting_consumers, ONE);
+        atomic_thread_fence(memory_order_seq_cst);
+        while ((element = take_next(this, tenant)) == NULL) {
+            if (pthread_cond_wait(&this->not_empty, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_empty");}
+        }
+        atomic_fetch_sub(&this->waiting_consumers, ONE);
+    }
+    pass_wakeup(this);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return element;
+}
+
+void* FairQueue_tryDeq(FairQueue* this, int* tenant) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    void *element = take_next(this, tenant);
+    if (element != NULL) {
+        pass_wakeup(this);
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return element;
+}
+
+int FairQueue_size(FairQueue* this) {
+    return atomic_load(&this->current_size);
+}
+
+int FairQueue_tenantSize(FairQueue* this, int tenant) {
+    if (tenant < ZERO || tenant >= this->tenant_count) {
+        return ZERO;
+    }
+    FairTenant *sub = &this->tenants[tenant];
+    if (pthread_mutex_lock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before reading a tenant size");}
+    int size = Queue_size(&sub->queue);
+    if (pthread_mutex_unlock(&sub->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after reading a tenant size");}
+    return size;
+}
+
+void FairQueue_destroy(FairQueue* this) {
+    /** Destroys the synchronization of every tenant and of the consumers, then frees the queue with its sub-rings.*/
+    for (int i = ZERO; i < this->tenant_count; i++) {
+        Queue_deinit(&this->tenants[i].queue);
+        pthread_cond_destroy(&this->tenants[i].not_full);
+        pthread_mutex_destroy(&this->tenants[i].mutex);
+    }
+    pthread_cond_destroy(&this->not_empty);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
@@ -0,0 +1,141 @@
+/*
+ * FairQueue.h
+ *
+ * Module interface for a multi-tenant Blocking Queue with weighted fair queuing across tenants.
+ *
+ * Each tenant has its own sub-ring with its own capacity limit, so a noisy tenant filling its ring only blocks its own
+ * producers. Consumers serve the tenants in deficit round robin: a tenant's turn lets it dequeue as many elements as its
+ * weight before moving on to the next tenant with elements, so under load each tenant gets a share proportional to its weight
+ * and an element never waits behind more than one turn of each other tenant.
+ *
+ */
+
+#ifndef FAIR_QUEUE_H_
+#define FAIR_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "Queue.h"
+
+/** Maximum number of tenants, one bit each in the bitmap of active tenants.*/
+#define FAIR_MAX_TENANTS 64
+
+/** Size of a cache line, each tenant is aligned on it so that producers of different tenants do not share one.*/
+#define FAIR_CACHE_LINE 64
+
+typedef struct FairTenant FairTenant;
+typedef struct FairQueue FairQueue;
+
+/*
+ * Sub-ring of one tenant, with the mutex its producers and the consumer taking from it share.
+ */
+struct FairTenant {
+
+    /** Mutex protecting the sub-ring and its capacity limit.*/
+    _Alignas(FAIR_CACHE_LINE) pthread_mutex_t mutex;
+
+    /** Condition variable the tenant's producers wait on while its sub-ring is at its capacity limit.*/
+    pthread_cond_t not_full;
+
+    /** Sub-ring of the tenant, its slots allocated with the FairQueue.*/
+    Queue queue;
+
+    /** Capacity limit of the sub-ring, at most the capacity given at creation.*/
+    int capacity;
+
+    /** Number of elements the tenant may dequeue per turn.*/
+    _Atomic int weight;
+
+    /** Elements the tenant may still dequeue in its current turn, only used under the consumers' mutex.*/
+    int deficit;
+};
+
+struct FairQueue {
+
+    /** Bitmap of the tenants with elements, read by consumers to select a tenant without taking its mutex.*/
+    _Alignas(FAIR_CACHE_LINE) _Atomic uint64_t active;
+
+    /** Total number of elements, and number of consumers sleeping on an empty queue.*/
+    _Atomic int current_size;
+    _Atomic int waiting_consumers;
+
+    /** Mutex serializing consumers around the round robin, and condition variable they wait on while no tenant has elements.*/
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+
+    /** Tenant whose turn it is, starting at the last one so that the first turn goes to the lowest tenant with elements.*/
+    int cursor;
+
+    /** Number of tenants and capacity of each sub-ring.*/
+    int tenant_count;
+    int max_capacity;
+
+    /** Tenants, cache line aligned, followed by the slots of their sub-rings.*/
+    FairTenant *tenants;
+};
+
+/*
+ * Creates a new FairQueue for tenant_count tenants, numbered from 0, each with a sub-ring of capacity void* elements and a weight of 1.
+ * Returns a pointer to a new FairQueue on success and NULL on failure or when tenant_count is above FAIR_MAX_TENANTS.
+ */
+FairQueue* new_FairQueue(int tenant_count, int capacity);
+
+/*
+ * Sets the number of elements the given tenant may dequeue per turn, from its next turn on.
+ * Returns false when the tenant does not exist or weight is not positive.
+ */
+bool FairQueue_setWeight(FairQueue* this, int tenant, int weight);
+
+/*
+ * Sets the capacity limit of the given tenant's sub-ring, between 1 and the capacity given at creation.
+ * Elements above a lowered limit stay queued, producers wait until the sub-ring is back below it.
+ * Returns false when the tenant does not exist or the capacity is out of range.
+ */
+bool FairQueue_setCapacity(FairQueue* this, int tenant, int capacity);
+
+/*
+ * Enqueues the given void* element at the back of the given tenant's sub-ring.
+ * If the sub-ring is at its capacity limit, the function will block the calling thread until there is space in it.
+ * Returns false when element is NULL or the tenant does not exist, true on success.
+ */
+bool FairQueue_enq(FairQueue* this, int tenant, void* element);
+
+/*
+ * Non-blocking version of FairQueue_enq.
+ * Returns false when element is NULL, the tenant does not exist or its sub-ring is at its capacity limit, true on success.
+ */
+bool FairQueue_tryEnq(FairQueue* this, int tenant, void* element);
+
+/*
+ * Dequeues the next element in deficit round robin order, storing its tenant at the given address when tenant is not NULL.
+ * If every sub-ring is empty, the function will block until an element can be dequeued.
+ * Returns the dequeued void* element.
+ */
+void* FairQueue_deq(FairQueue* this, int* tenant);
+
+/*
+ * Non-blocking version of FairQueue_deq.
+ * Returns the dequeued void* element, or NULL when every sub-ring is empty.
+ */
+void* FairQueue_tryDeq(FairQueue* this, int* tenant);
+
+/*
+ * Returns the number of elements in this Queue, across all tenants.
+ */
+int FairQueue_size(FairQueue* this);
+
+/*
+ * Returns the number of elements in the given tenant's sub-ring, 0 when the tenant does not exist.
+ */
+int FairQueue_tenantSize(FairQueue* this, int tenant);
+
+/*
+ * Destroys this Queue by freeing the memory used by the Queue.
+ */
+void FairQueue_destroy(FairQueue* this);
+
+#endif /* FAIR_QUEUE_H_ */
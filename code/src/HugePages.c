@@ -0,0 +1,118 @@
+/*
+ * HugePages.c
+ *
+ * Huge page backed memory for queue slot arrays, with a fallback to normal pages.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+
+#include "HugePages.h"
+
+/** Flag asking MAP_HUGETLB for pages of HUGE_PAGES_SIZE, log2 of the size shifted by MAP_HUGE_SHIFT, when the headers lack it.*/
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+/**
+ * Private function rounding the given size up to a whole number of huge pages.
+*/
+static size_t huge_size(size_t size) {
+    return (size + HUGE_PAGES_SIZE - ONE) & ~(size_t)(HUGE_PAGES_SIZE - ONE);
+}
+
+/**
+ * Private function mapping the given rounded size at an address aligned to HUGE_PAGES_SIZE, so that whole huge pages fit in it.
+ * A larger mapping is made, then the parts before and after the aligned range are unmapped.
+*/
+static void* map_aligned(size_t size) {
+    char *mapping = mmap(NULL, size + HUGE_PAGES_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, ZERO);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    char *aligned = (char*)huge_size((size_t)mapping);
+    size_t head = (size_t)(aligned - mapping);
+    if (head > ZERO) {
+        munmap(mapping, head);
+    }
+    munmap(aligned + size, HUGE_PAGES_SIZE - head);
+    return aligned;
+}
+
+void* HugePages_alloc(size_t size, int* backing) {
+
+    if (size == ZERO) {
+        return NULL;
+    }
+    size = huge_size(size);
+
+    /**
+     * Reserved huge pages are used when the system has some left. Their size is asked for explicitly: the default huge page
+     * size may be 1GB, which the size rounded to HUGE_PAGES_SIZE, later given to munmap, would not be a multiple of.
+    */
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, ZERO);
+    if (memory != MAP_FAILED) {
+        if (backing != NULL) { *backing = HUGE_PAGES_EXPLICIT;}
+        return memory;
+    }
+
+    /** Otherwise the kernel is asked to back the aligned mapping with transparent huge pages, it uses normal pages if it cannot.*/
+    memory = map_aligned(size);
+    if (memory == NULL) {
+        perror("Error: Failed to map memory for huge pages");
+        return NULL;
+    }
+    bool transparent = madvise(memory, size, MADV_HUGEPAGE) == ZERO;
+    if (backing != NULL) { *backing = transparent ? HUGE_PAGES_TRANSPARENT : HUGE_PAGES_NONE;}
+    return memory;
+}
+
+void HugePages_free(void* memory, size_t size) {
+    munmap(memory, huge_size(size));
+}
+
+Queue* new_HugePageQueue(int max_size, int* backing) {
+
+    if (max_size <= ZERO) {
+        return NULL;
+    }
+
+    /** The Queue and its slots share one huge page backed mapping.*/
+    Queue *queue = HugePages_alloc(sizeof(Queue) + Queue_storageSize(max_size), backing);
+    if (queue == NULL) {
+        return NULL;
+    }
+    Queue_init(queue, max_size, queue + ONE);
+    return queue;
+}
+
+void HugePageQueue_destroy(Queue* queue) {
+    int max_size = queue->max_size;
+    Queue_deinit(queue);
+    HugePages_free(queue, sizeof(Queue) + Queue_storageSize(max_size));
+}
+
+BlockingQueue* new_HugePageBlockingQueue(int max_size, int* backing) {
+
+    if (max_size <= ZERO) {
+        return NULL;
+    }
+
+    /** The BlockingQueue and its slots share one huge page backed mapping.*/
+    BlockingQueue *queue = HugePages_alloc(sizeof(BlockingQueue) + BlockingQueue_storageSize(max_size), backing);
+    if (queue == NULL) {
+        return NULL;
+    }
+    BlockingQueue_init(queue, max_size, queue + ONE);
+    return queue;
+}
+
+void HugePageBlockingQueue_destroy(BlockingQueue* queue) {
+    int max_size = queue->max_size;
+    BlockingQueue_deinit(queue);
+    HugePages_free(queue, sizeof(BlockingQueue) + BlockingQueue_storageSize(max_size));
+}
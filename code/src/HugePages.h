@@ -0,0 +1,65 @@
+/*
+ * HugePages.h
+ *
+ * Module interface for backing large queues with huge pages, so that a ring cycling through millions of slots
+ * needs far fewer TLB entries than with normal pages.
+ *
+ */
+
+#ifndef HUGE_PAGES_H_
+#define HUGE_PAGES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "Queue.h"
+#include "BlockingQueue.h"
+
+/** Size of a huge page, every mapping is rounded up to it.*/
+#define HUGE_PAGES_SIZE (2 * 1024 * 1024)
+
+/** Kinds of pages backing a mapping, from best to worst.*/
+#define HUGE_PAGES_EXPLICIT 2
+#define HUGE_PAGES_TRANSPARENT 1
+#define HUGE_PAGES_NONE 0
+
+/*
+ * Maps size bytes of zeroed memory, rounded up to HUGE_PAGES_SIZE, backed by huge pages when possible.
+ * Reserved huge pages of HUGE_PAGES_SIZE are tried first (MAP_HUGETLB with MAP_HUGE_2MB, whatever the system's default huge
+ * page size), then transparent huge pages (madvise MADV_HUGEPAGE) on a mapping
+ * aligned to HUGE_PAGES_SIZE, and the memory silently uses normal pages if neither is available.
+ * If backing is not NULL, it receives HUGE_PAGES_EXPLICIT, HUGE_PAGES_TRANSPARENT or HUGE_PAGES_NONE.
+ * Returns the memory, to be released with HugePages_free, or NULL on failure.
+ */
+void* HugePages_alloc(size_t size, int* backing);
+
+/*
+ * Releases memory returned by HugePages_alloc for the given size.
+ */
+void HugePages_free(void* memory, size_t size);
+
+/*
+ * Creates a new Queue for at most max_size void* elements, with the Queue and its slots in huge pages when possible.
+ * If backing is not NULL, it receives the kind of pages used.
+ * Returns a pointer to a new Queue on success and NULL on failure. It must be destroyed with HugePageQueue_destroy.
+ */
+Queue* new_HugePageQueue(int max_size, int* backing);
+
+/*
+ * Destroys a Queue created by new_HugePageQueue.
+ */
+void HugePageQueue_destroy(Queue* queue);
+
+/*
+ * Creates a new BlockingQueue for at most max_size void* elements, with the BlockingQueue and its slots in huge pages when possible.
+ * If backing is not NULL, it receives the kind of pages used.
+ * Returns a pointer to a new BlockingQueue on success and NULL on failure. It must be destroyed with HugePageBlockingQueue_destroy.
+ */
+BlockingQueue* new_HugePageBlockingQueue(int max_size, int* backing);
+
+/*
+ * Destroys a BlockingQueue created by new_HugePageBlockingQueue.
+ */
+void HugePageBlockingQueue_destroy(BlockingQueue* queue);
+
+#endif /* HUGE_PAGES_H_ */
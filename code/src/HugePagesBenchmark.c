@@ -0,0 +1,122 @@
+/*
+ * HugePagesBenchmark.c
+ *
+ * Benchmark comparing the dTLB misses and the time of a Queue cycling through its slots with normal pages and with huge pages.
+ *
+ * Each queue is kept one element short of full, so the enqueue and the dequeue positions stay a whole ring apart and every
+ * page of the slot array is visited in turn. dTLB misses are counted with perf_event_open when the kernel allows it,
+ * otherwise only the time is reported.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "Queue.h"
+#include "HugePages.h"
+
+/** Number of enqueue and dequeue pairs timed for each capacity.*/
+#define OPERATIONS (1 << 23)
+
+/** Capacities benchmarked, in slots.*/
+static const int capacities[] = {1 << 12, 1 << 16, 1 << 20, 1 << 23};
+
+/**
+ * Opens a counter of the dTLB misses of the given operation (PERF_COUNT_HW_CACHE_OP_READ or WRITE) for this thread.
+ * Returns the file descriptor of the counter, or -1 when the kernel does not allow it.
+*/
+static int open_dtlb_counter(int operation) {
+    struct perf_event_attr attributes;
+    memset(&attributes, ZERO, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.config = PERF_COUNT_HW_CACHE_DTLB | (operation << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attributes.disabled = ONE;
+    attributes.exclude_kernel = ONE;
+    attributes.exclude_hv = ONE;
+    return (int)syscall(SYS_perf_event_open, &attributes, ZERO, -1, -1, ZERO);
+}
+
+/**
+ * Returns the current time in seconds.
+*/
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+ * Cycles the given queue through OPERATIONS enqueue and dequeue pairs, and prints the time and dTLB misses.
+*/
+static void run(const char* label, Queue* queue, int capacity) {
+    int counters[] = {open_dtlb_counter(PERF_COUNT_HW_CACHE_OP_READ), open_dtlb_counter(PERF_COUNT_HW_CACHE_OP_WRITE)};
+
+    /** Fills the queue, which also faults every page in before measuring.*/
+    for (intptr_t i = ONE; i < capacity; i++) {
+        Queue_enq(queue, (void*)i);
+    }
+
+    for (int i = ZERO; i < TWO; i++) {
+        if (counters[i] >= ZERO) {
+            ioctl(counters[i], PERF_EVENT_IOC_RESET, ZERO);
+            ioctl(counters[i], PERF_EVENT_IOC_ENABLE, ZERO);
+        }
+    }
+    double start = now();
+    intptr_t checksum = ZERO;
+    for (intptr_t i = ZERO; i < OPERATIONS; i++) {
+        checksum += (intptr_t)Queue_deq(queue);
+        Queue_enq(queue, (void*)(i + ONE));
+    }
+    double elapsed = now() - start;
+
+    long long misses = ZERO;
+    bool counted = true;
+    for (int i = ZERO; i < TWO; i++) {
+        long long count = ZERO;
+        if (counters[i] < ZERO) {
+            counted = false;
+            continue;
+        }
+        ioctl(counters[i], PERF_EVENT_IOC_DISABLE, ZERO);
+        if (read(counters[i], &count, sizeof(count)) != sizeof(count)) {
+            counted = false;
+        }
+        misses += count;
+        close(counters[i]);
+    }
+
+    printf("%10d  %-20s %8.2f ns/op", capacity, label, elapsed * 1e9 / OPERATIONS);
+    if (counted) {
+        printf("  %12lld dTLB misses", misses);
+    } else {
+        printf("  %12s dTLB misses", "n/a");
+    }
+    printf("  (checksum %ld)\n", (long)(checksum & 0xff));
+}
+
+int main() {
+    printf("Cycling %d enqueue/dequeue pairs through a nearly full Queue.\n", OPERATIONS);
+    for (size_t i = ZERO; i < sizeof(capacities) / sizeof(capacities[ZERO]); i++) {
+        int capacity = capacities[i];
+
+        Queue *normal = new_Queue(capacity);
+        run("normal pages", normal, capacity);
+        Queue_destroy(normal);
+
+        int backing;
+        Queue *huge = new_HugePageQueue(capacity, &backing);
+        run(backing == HUGE_PAGES_EXPLICIT ? "huge pages (hugetlb)" : backing == HUGE_PAGES_TRANSPARENT ? "huge pages (THP)" : "huge pages (none)",
+            huge, capacity);
+        HugePageQueue_destroy(huge);
+    }
+    return ZERO;
+}
@@ -0,0 +1,159 @@
+/*
+ * Mailbox.c
+ *
+ * Conflating latest-value mailbox published under a seqlock.
+ *
+ * The value is stored in atomic words copied with relaxed operations, ordered by fences around the sequence number, so that a
+ * reader racing with a writer reads a torn copy without undefined behaviour, and then throws it away when the sequence changed.
+ *
+ * Readers waiting for a newer version sleep on a condition variable like the threads of a BlockingQueue. A writer only takes
+ * the mutex to wake them when the waiting count, checked after a full fence, says that some reader went to sleep.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "Mailbox.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the Mailbox, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(Mailbox* this, char *error_mesg) {
+    Mailbox_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+Mailbox* new_Mailbox(size_t value_size) {
+
+    /** Checks that the given value_size is a valid size.*/
+    if (value_size == ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the structure and the words of the value in one block.*/
+    size_t word_count = (value_size + sizeof(unsigned long) - ONE) / sizeof(unsigned long);
+    Mailbox *this = malloc(sizeof(Mailbox) + word_count * sizeof(_Atomic unsigned long));
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for Mailbox");
+        return NULL;
+    }
+    this->words = (_Atomic unsigned long*)(this + ONE);
+    this->value_size = value_size;
+    this->word_count = word_count;
+    for (size_t i = ZERO; i < word_count; i++) {
+        atomic_init(&this->words[i], ZERO);
+    }
+    atomic_init(&this->sequence, ZERO);
+    atomic_init(&this->waiting, ZERO);
+
+    if (pthread_mutex_init(&this->mutex, NULL) || pthread_cond_init(&this->newer, NULL)) {
+        perror("Error: failed to initialize Mailbox synchronization");
+        free(this);
+        return NULL;
+    }
+    return this;
+}
+
+unsigned long Mailbox_publish(Mailbox* this, const void* value) {
+
+    /** Check that the value is not NULL.*/
+    if (value == NULL) {
+        return ZERO;
+    }
+
+    /** Takes the seqlock by moving the sequence number from even to odd, letting another writer finish first.*/
+    unsigned long sequence = atomic_load_explicit(&this->sequence, memory_order_relaxed);
+    while (sequence % TWO != ZERO
+            || !atomic_compare_exchange_weak_explicit(&this->sequence, &sequence, sequence + ONE, memory_order_relaxed, memory_order_relaxed)) {
+        if (sequence % TWO != ZERO) {
+            sched_yield();
+            sequence = atomic_load_explicit(&this->sequence, memory_order_relaxed);
+        }
+    }
+    atomic_thread_fence(memory_order_release);
+
+    /** Copies the value in, the last word only partly when value_size is not a multiple of a word.*/
+    const unsigned char *bytes = value;
+    for (size_t i = ZERO; i < this->word_count; i++) {
+        unsigned long word = ZERO;
+        size_t offset = i * sizeof(unsigned long);
+        size_t length = this->value_size - offset < sizeof(unsigned long) ? this->value_size - offset : sizeof(unsigned long);
+        memcpy(&word, bytes + offset, length);
+        atomic_store_explicit(&this->words[i], word, memory_order_relaxed);
+    }
+
+    /** Releases the seqlock on the next even number, publishing the new version.*/
+    atomic_store_explicit(&this->sequence, sequence + TWO, memory_order_release);
+
+    /** Wakes the readers waiting for a newer version, if any went to sleep.*/
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&this->waiting, memory_order_relaxed) > ZERO) {
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waking readers");}
+        if (pthread_cond_broadcast(&this->newer)) { cleanup_exit(this, "Error: pthread_cond_broadcast() failed");}
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waking readers");}
+    }
+    return (sequence + TWO) / TWO;
+}
+
+unsigned long Mailbox_read(Mailbox* this, void* value) {
+    unsigned char *bytes = value;
+    while (true) {
+        unsigned long before = atomic_load_explicit(&this->sequence, memory_order_acquire);
+        if (before == ZERO) {
+            return ZERO;
+        }
+        if (before % TWO != ZERO) {
+            /** A writer is copying a value in.*/
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = ZERO; i < this->word_count; i++) {
+            unsigned long word = atomic_load_explicit(&this->words[i], memory_order_relaxed);
+            size_t offset = i * sizeof(unsigned long);
+            size_t length = this->value_size - offset < sizeof(unsigned long) ? this->value_size - offset : sizeof(unsigned long);
+            memcpy(bytes + offset, &word, length);
+        }
+
+        /** The copy is consistent if no writer took the seqlock meanwhile.*/
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&this->sequence, memory_order_relaxed) == before) {
+            return before / TWO;
+        }
+    }
+}
+
+unsigned long Mailbox_waitNewer(Mailbox* this, unsigned long version, void* value) {
+    if (Mailbox_version(this) <= version) {
+        /** Registers as waiting, then checks the version once more before each sleep.*/
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waiting for a newer version");}
+        atomic_fetch_add(&this->waiting, ONE);
+        while (atomic_load(&this->sequence) / TWO <= version) {
+            if (pthread_cond_wait(&this->newer, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for newer");}
+        }
+        atomic_fetch_sub(&this->waiting, ONE);
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waiting for a newer version");}
+    }
+    return Mailbox_read(this, value);
+}
+
+unsigned long Mailbox_version(Mailbox* this) {
+    return atomic_load(&this->sequence) / TWO;
+}
+
+void Mailbox_destroy(Mailbox* this) {
+    /** Destroys the synchronization of the blocking readers, then frees the Mailbox and its value.*/
+    pthread_cond_destroy(&this->newer);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
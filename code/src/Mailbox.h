@@ -0,0 +1,81 @@
+/*
+ * Mailbox.h
+ *
+ * Module interface for a conflating latest-value mailbox: a capacity-1 slot holding a copy of the newest value, such as a
+ * configuration or price snapshot. Each publish replaces the previous value instead of queueing behind it, so readers never
+ * go through stale entries.
+ *
+ * Writers publish under a seqlock: the sequence number is odd while a value is being written and is advanced to the next even
+ * number once it is complete, and readers copy the value without any lock, retrying only if a publish overlapped their copy.
+ *
+ */
+
+#ifndef MAILBOX_H_
+#define MAILBOX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "Queue.h"
+
+typedef struct Mailbox Mailbox;
+
+struct Mailbox {
+
+    /** Seqlock sequence number: twice the version of the value, plus one while a writer is copying a new value in.*/
+    _Atomic unsigned long sequence;
+
+    /** Readers sleeping in Mailbox_waitNewer, read by writers after each publish to know whether to wake them.*/
+    _Atomic int waiting;
+
+    /** Mutex and condition variable of the blocking readers, only taken by readers going to sleep and by the writers waking them.*/
+    pthread_mutex_t mutex;
+    pthread_cond_t newer;
+
+    /** Size in bytes of a value, and number of words holding it.*/
+    size_t value_size;
+    size_t word_count;
+
+    /** The value, copied in and out one atomic word at a time, allocated with the Mailbox.*/
+    _Atomic unsigned long *words;
+};
+
+/*
+ * Creates a new empty Mailbox for values of value_size bytes.
+ * Returns a pointer to a new Mailbox on success and NULL on failure or when value_size is 0.
+ */
+Mailbox* new_Mailbox(size_t value_size);
+
+/*
+ * Copies the value_size bytes pointed to by value into this Mailbox, replacing its current value, and wakes the readers
+ * waiting for a newer version. Concurrent writers take turns without blocking readers.
+ * Returns the version of the published value, counting from 1, or 0 when value is NULL.
+ */
+unsigned long Mailbox_publish(Mailbox* this, const void* value);
+
+/*
+ * Copies the latest value of this Mailbox into the value_size bytes pointed to by value, without any lock.
+ * Returns its version, or 0 (leaving value untouched) when nothing was published yet.
+ */
+unsigned long Mailbox_read(Mailbox* this, void* value);
+
+/*
+ * Copies the latest value of this Mailbox into value once its version is newer than the given one.
+ * If it is not, the function will block until a writer publishes a newer value.
+ * Returns the version of the copied value.
+ */
+unsigned long Mailbox_waitNewer(Mailbox* this, unsigned long version, void* value);
+
+/*
+ * Returns the version of the latest value of this Mailbox, 0 when nothing was published yet.
+ */
+unsigned long Mailbox_version(Mailbox* this);
+
+/*
+ * Destroys this Mailbox by freeing the memory used by the Mailbox.
+ */
+void Mailbox_destroy(Mailbox* this);
+
+#endif /* MAILBOX_H_ */
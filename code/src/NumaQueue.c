@@ -0,0 +1,305 @@
+/*
+ * NumaQueue.c
+ *
+ * NUMA placement of queue memory and sharded Blocking Queue with one sub-queue per node.
+ *
+ * Memory is bound with the raw mbind and move_pages system calls so that libnuma is not needed.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "NumaQueue.h"
+
+/** Memory policy and flags of mbind and move_pages, from the kernel's uapi/linux/mempolicy.h.*/
+#define NUMA_MPOL_BIND 2
+#define NUMA_MPOL_MF_MOVE (1 << 1)
+
+/** File listing the online nodes of the machine, such as "0" or "0-1".*/
+#define NUMA_ONLINE_NODES "/sys/devices/system/node/online"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the NumaQueue, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(NumaQueue* this, char *error_mesg) {
+    NumaQueue_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function binding the pages of the given memory, not yet touched, to the given node with mbind.
+ * Returns false if the kernel refuses, for example because the node does not exist.
+*/
+static bool bind_memory(void* memory, size_t size, int node) {
+    if (node >= NUMA_QUEUE_MAX_NODES) {
+        return false;
+    }
+    unsigned long mask = 1UL << node;
+    return syscall(SYS_mbind, memory, size, NUMA_MPOL_BIND, &mask, sizeof(mask) * CHAR_BIT + ONE, NUMA_MPOL_MF_MOVE) == ZERO;
+}
+
+/**
+ * Private function touching every page of the given memory, then moving them to the given node with move_pages.
+ * Returns false if any page could not be moved.
+*/
+static bool move_memory(void* memory, size_t size, int node) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t count = (size + page_size - ONE) / page_size;
+    void **pages = malloc(count * sizeof(void*));
+    int *nodes = malloc(count * sizeof(int));
+    int *status = malloc(count * sizeof(int));
+    bool moved = false;
+
+    if (pages != NULL && nodes != NULL && status != NULL) {
+        for (size_t i = ZERO; i < count; i++) {
+            pages[i] = (char*)memory + i * page_size;
+            *(volatile char*)pages[i] = ZERO;
+            nodes[i] = node;
+        }
+        moved = syscall(SYS_move_pages, ZERO, count, pages, nodes, status, NUMA_MPOL_MF_MOVE) == ZERO;
+        for (size_t i = ZERO; moved && i < count; i++) {
+            moved = status[i] >= ZERO;
+        }
+    }
+    free(pages);
+    free(nodes);
+    free(status);
+    return moved;
+}
+
+int NumaQueue_nodeCount(void) {
+    FILE *online = fopen(NUMA_ONLINE_NODES, "r");
+    if (online == NULL) {
+        return ONE;
+    }
+
+    /** The file lists node ranges such as "0-1,3", the count is one more than the highest node listed.*/
+    int highest = ZERO, node;
+    char separator;
+    while (fscanf(online, "%d%c", &node, &separator) >= ONE) {
+        if (node > highest) {
+            highest = node;
+        }
+    }
+    fclose(online);
+    return highest + ONE;
+}
+
+int NumaQueue_currentNode(int node_count) {
+    unsigned int cpu, node;
+    if (node_count <= ZERO || syscall(SYS_getcpu, &cpu, &node, NULL)) {
+        return ZERO;
+    }
+    return (int)(node % (unsigned int)node_count);
+}
+
+void* NumaQueue_alloc(size_t size, int node) {
+
+    if (size == ZERO || node < ZERO) {
+        return NULL;
+    }
+
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, ZERO);
+    if (memory == MAP_FAILED) {
+        perror("Error: Failed to map memory for NumaQueue");
+        return NULL;
+    }
+
+    /** Binding before the first touch places the pages directly, moving them afterwards is the fallback.*/
+    if (!bind_memory(memory, size, node)) {
+        move_memory(memory, size, node);
+    }
+    return memory;
+}
+
+void NumaQueue_free(void* memory, size_t size) {
+    munmap(memory, size);
+}
+
+int NumaQueue_nodeOf(void* address) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    void *page = (void*)((size_t)address & ~(page_size - ONE));
+    int status = -1;
+
+    /** Without target nodes, move_pages only reports the node of each page.*/
+    if (syscall(SYS_move_pages, ZERO, ONE, &page, NULL, &status, ZERO) || status < ZERO) {
+        return -1;
+    }
+    return status;
+}
+
+Queue* new_QueueOnNode(int max_size, int node) {
+
+    if (max_size <= ZERO) {
+        return NULL;
+    }
+
+    /** The Queue and its slots share one mapping bound to the node.*/
+    Queue *queue = NumaQueue_alloc(sizeof(Queue) + Queue_storageSize(max_size), node);
+    if (queue == NULL) {
+        return NULL;
+    }
+    Queue_init(queue, max_size, queue + ONE);
+    return queue;
+}
+
+void QueueOnNode_destroy(Queue* queue) {
+    int max_size = queue->max_size;
+    Queue_deinit(queue);
+    NumaQueue_free(queue, sizeof(Queue) + Queue_storageSize(max_size));
+}
+
+BlockingQueue* new_BlockingQueueOnNode(int max_size, int node) {
+
+    if (max_size <= ZERO) {
+        return NULL;
+    }
+
+    /** The BlockingQueue and its slots share one mapping bound to the node.*/
+    BlockingQueue *queue = NumaQueue_alloc(sizeof(BlockingQueue) + BlockingQueue_storageSize(max_size), node);
+    if (queue == NULL) {
+        return NULL;
+    }
+    BlockingQueue_init(queue, max_size, queue + ONE);
+    return queue;
+}
+
+void BlockingQueueOnNode_destroy(BlockingQueue* queue) {
+    int max_size = queue->max_size;
+    BlockingQueue_deinit(queue);
+    NumaQueue_free(queue, sizeof(BlockingQueue) + BlockingQueue_storageSize(max_size));
+}
+
+NumaQueue* new_NumaQueue(int node_count, int max_size_per_node) {
+
+    /** Checks that the given sizes are valid.*/
+    if (node_count <= ZERO || max_size_per_node <= ZERO) {
+        return NULL;
+    }
+
+    NumaQueue *this = malloc(sizeof(NumaQueue));
+    NumaShard **shards = calloc(node_count, sizeof(NumaShard*));
+    if (this == NULL || shards == NULL) {
+        perror("Error: Failed to allocate memory for NumaQueue");
+        free(this);
+        free(shards);
+        return NULL;
+    }
+    this->shards = shards;
+    this->node_count = node_count;
+    atomic_init(&this->local_deqs, ZERO);
+    atomic_init(&this->remote_deqs, ZERO);
+    if (sem_init(&this->full_slots, ZERO, ZERO)) { cleanup_exit(this, "Error: Failed to initialize full_slots semaphore");}
+
+    /** Each sub-queue and its slots live in memory bound to its node.*/
+    size_t mapping_size = sizeof(NumaShard) + Queue_storageSize(max_size_per_node);
+    for (int node = ZERO; node < node_count; node++) {
+        NumaShard *shard = NumaQueue_alloc(mapping_size, node);
+        if (shard == NULL) {
+            NumaQueue_destroy(this);
+            return NULL;
+        }
+        shard->mapping_size = mapping_size;
+        Queue_init(&shard->queue, max_size_per_node, shard + ONE);
+        this->shards[node] = shard;
+        if (pthread_mutex_init(&shard->mutex, NULL)) { cleanup_exit(this, "Error: failed to initialize mutex.");}
+        if (sem_init(&shard->empty_slots, ZERO, max_size_per_node)) { cleanup_exit(this, "Error: Failed to initialize empty_slots semaphore");}
+    }
+    return this;
+}
+
+bool NumaQueue_enq(NumaQueue* this, int node, void* element) {
+
+    if (element == NULL || node < ZERO || node >= this->node_count) {
+        return false;
+    }
+    NumaShard *shard = this->shards[node];
+
+    /** Waits for a free slot in the sub-queue of the node, then publishes the element to every consumer.*/
+    if (sem_wait(&shard->empty_slots)) { cleanup_exit(this, "Error: sem_wait() failed for empty_slots semaphore");}
+    if (pthread_mutex_lock(&shard->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before enqueueing");}
+    Queue_enq(&shard->queue, element);
+    if (pthread_mutex_unlock(&shard->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
+    if (sem_post(&this->full_slots)) { cleanup_exit(this, "Error: sem_post() failed for full_slots semaphore");}
+    return true;
+}
+
+void* NumaQueue_deq(NumaQueue* this, int node) {
+
+    if (node < ZERO || node >= this->node_count) {
+        return NULL;
+    }
+
+    /** Waits until one element somewhere is owed to this consumer.*/
+    if (sem_wait(&this->full_slots)) { cleanup_exit(this, "Error: sem_wait() failed for full_slots semaphore");}
+
+    /**
+     * Looks at the local sub-queue first, then steals from the following nodes in turn.
+     * The owed element may be taken from a sub-queue already visited by another owed consumer, so the scan goes round until it finds one.
+    */
+    void *element = NULL;
+    int visited = ZERO;
+    while (element == NULL) {
+        NumaShard *shard = this->shards[(node + visited) % this->node_count];
+        if (pthread_mutex_lock(&shard->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+        element = Queue_deq(&shard->queue);
+        if (pthread_mutex_unlock(&shard->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+        if (element != NULL) {
+            if (sem_post(&shard->empty_slots)) { cleanup_exit(this, "Error: sem_post() failed for empty_slots semaphore");}
+        } else {
+            visited++;
+        }
+    }
+
+    atomic_fetch_add((visited % this->node_count == ZERO) ? &this->local_deqs : &this->remote_deqs, ONE);
+    return element;
+}
+
+int NumaQueue_nodeSize(NumaQueue* this, int node) {
+    NumaShard *shard = this->shards[node];
+    if (pthread_mutex_lock(&shard->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before getting the current size");}
+    int size = Queue_size(&shard->queue);
+    if (pthread_mutex_unlock(&shard->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after getting the current size");}
+    return size;
+}
+
+int NumaQueue_size(NumaQueue* this) {
+    int size = ZERO;
+    for (int node = ZERO; node < this->node_count; node++) {
+        size += NumaQueue_nodeSize(this, node);
+    }
+    return size;
+}
+
+long NumaQueue_deqCount(NumaQueue* this, bool remote) {
+    return atomic_load(remote ? &this->remote_deqs : &this->local_deqs);
+}
+
+void NumaQueue_destroy(NumaQueue* this) {
+    /** Destroys the synchronization of every sub-queue created, then unmaps it.*/
+    for (int node = ZERO; node < this->node_count; node++) {
+        NumaShard *shard = this->shards[node];
+        if (shard != NULL) {
+            pthread_mutex_destroy(&shard->mutex);
+            sem_destroy(&shard->empty_slots);
+            Queue_deinit(&shard->queue);
+            NumaQueue_free(shard, shard->mapping_size);
+        }
+    }
+    sem_destroy(&this->full_slots);
+    free(this->shards);
+    free(this);
+}
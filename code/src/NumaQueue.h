@@ -0,0 +1,155 @@
+/*
+ * NumaQueue.h
+ *
+ * Module interface for NUMA aware queues: Queues and BlockingQueues whose memory is bound to a node, and a sharded
+ * Blocking Queue keeping one sub-queue per node where consumers prefer local elements and steal from other nodes when
+ * their own sub-queue is empty.
+ *
+ * The node count of a NumaQueue is chosen by the caller, so a topology with several nodes can be simulated on a machine
+ * with a single node: binding memory to a node the machine does not have falls back to the pages of the calling thread.
+ *
+ */
+
+#ifndef NUMA_QUEUE_H_
+#define NUMA_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "Queue.h"
+#include "BlockingQueue.h"
+
+/** Largest number of nodes memory can be bound to, the node mask passed to the kernel is a single unsigned long.*/
+#define NUMA_QUEUE_MAX_NODES 64
+
+typedef struct NumaShard NumaShard;
+typedef struct NumaQueue NumaQueue;
+
+/*
+ * Sub-queue of a NumaQueue, placed in memory bound to its node together with its slots.
+ */
+struct NumaShard {
+
+    /** Internal non-thread-safe Queue, its slots follow this struct.*/
+    Queue queue;
+
+    /** Mutex protecting queue.*/
+    pthread_mutex_t mutex;
+
+    /** Semaphore counting the free slots of this sub-queue.*/
+    sem_t empty_slots;
+
+    /** Size of the mapping holding this struct and its slots.*/
+    size_t mapping_size;
+};
+
+struct NumaQueue {
+
+    /** Number of nodes, and of sub-queues.*/
+    int node_count;
+
+    /** One sub-queue per node.*/
+    NumaShard **shards;
+
+    /** Semaphore counting the elements of every sub-queue, a consumer holding a permit is owed one element.*/
+    sem_t full_slots;
+
+    /** Number of elements dequeued from the consumer's own node and from another node.*/
+    _Atomic long local_deqs, remote_deqs;
+};
+
+/*
+ * Returns the number of NUMA nodes of this machine, 1 when it cannot be found.
+ */
+int NumaQueue_nodeCount(void);
+
+/*
+ * Returns the node of the CPU the calling thread runs on, folded into [0, node_count).
+ */
+int NumaQueue_currentNode(int node_count);
+
+/*
+ * Maps size bytes of zeroed memory bound to the given node.
+ * The memory is bound with mbind, or moved with move_pages if mbind fails; if both fail, for example because the node does not
+ * exist, the pages stay where the calling thread touched them first.
+ * Returns the memory, to be released with NumaQueue_free, or NULL on failure.
+ */
+void* NumaQueue_alloc(size_t size, int node);
+
+/*
+ * Releases memory returned by NumaQueue_alloc of the given size.
+ */
+void NumaQueue_free(void* memory, size_t size);
+
+/*
+ * Returns the node holding the page of the given address, or -1 if the kernel cannot tell.
+ */
+int NumaQueue_nodeOf(void* address);
+
+/*
+ * Creates a new Queue for at most max_size void* elements, with the Queue and its slots in memory bound to the given node.
+ * Returns a pointer to a new Queue on success and NULL on failure. It must be destroyed with QueueOnNode_destroy.
+ */
+Queue* new_QueueOnNode(int max_size, int node);
+
+/*
+ * Destroys a Queue created by new_QueueOnNode.
+ */
+void QueueOnNode_destroy(Queue* queue);
+
+/*
+ * Creates a new BlockingQueue for at most max_size void* elements, with the BlockingQueue and its slots in memory bound to the
+ * given node. Returns a pointer to a new BlockingQueue on success and NULL on failure. It must be destroyed with BlockingQueueOnNode_destroy.
+ */
+BlockingQueue* new_BlockingQueueOnNode(int max_size, int node);
+
+/*
+ * Destroys a BlockingQueue created by new_BlockingQueueOnNode.
+ */
+void BlockingQueueOnNode_destroy(BlockingQueue* queue);
+
+/*
+ * Creates a new NumaQueue with node_count sub-queues of at most max_size_per_node void* elements, each bound to its node.
+ * Returns a pointer to a new NumaQueue on success and NULL on failure.
+ */
+NumaQueue* new_NumaQueue(int node_count, int max_size_per_node);
+
+/*
+ * Enqueues the given void* element in the sub-queue of the given node.
+ * If that sub-queue is full, the function will block the calling thread until there is space in it.
+ * Returns false when element is NULL or node is out of range, true on success.
+ */
+bool NumaQueue_enq(NumaQueue* this, int node, void* element);
+
+/*
+ * Dequeues an element for a consumer running on the given node.
+ * The element comes from the sub-queue of that node when it is not empty, otherwise from the next non-empty sub-queue.
+ * If every sub-queue is empty, the function will block until an element can be dequeued.
+ * Returns the dequeued void* element, or NULL if node is out of range.
+ */
+void* NumaQueue_deq(NumaQueue* this, int node);
+
+/*
+ * Returns the number of elements currently in every sub-queue of this NumaQueue.
+ */
+int NumaQueue_size(NumaQueue* this);
+
+/*
+ * Returns the number of elements currently in the sub-queue of the given node.
+ */
+int NumaQueue_nodeSize(NumaQueue* this, int node);
+
+/*
+ * Returns the number of elements dequeued from the consumer's own node, or from another node when remote is true.
+ */
+long NumaQueue_deqCount(NumaQueue* this, bool remote);
+
+/*
+ * Destroys this NumaQueue by releasing the memory of every sub-queue.
+ */
+void NumaQueue_destroy(NumaQueue* this);
+
+#endif /* NUMA_QUEUE_H_ */
@@ -0,0 +1,225 @@
+/*
+ * OverflowQueue.c
+ *
+ * Lock-free bounded MPMC ring with overflow policies.
+ *
+ * Producers and consumers claim positions with a compare and swap and hand each slot over through its sequence number, so
+ * neither side takes a lock on the fast path. A producer overwriting the oldest element simply dequeues it itself, then retries.
+ *
+ * Only blocking threads take the mutex: a thread about to sleep registers as waiting under the mutex and tries once more,
+ * while a thread which completed an operation checks the waiting count after a full fence and wakes a sleeper under the mutex.
+ * Either the sleeper sees the operation, or the other thread sees the sleeper.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "OverflowQueue.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the OverflowQueue, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(OverflowQueue* this, char *error_mesg) {
+    OverflowQueue_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function enqueuing an element if there is space, without blocking.
+ * Returns false if the queue is full.
+*/
+static bool try_enq(OverflowQueue* this, void* element) {
+    size_t position = atomic_load_explicit(&this->enq_position, memory_order_relaxed);
+    while (true) {
+        OverflowCell *cell = &this->cells[position % this->max_size];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == ZERO) {
+            /** The slot is free for this position: claims it, then publishes the element.*/
+            if (atomic_compare_exchange_weak_explicit(&this->enq_position, &position, position + ONE, memory_order_relaxed, memory_order_relaxed)) {
+                cell->element = element;
+                atomic_store_explicit(&cell->sequence, position + ONE, memory_order_release);
+                return true;
+            }
+        } else if (difference < ZERO) {
+            /** The slot still holds the element of the previous lap: the queue is full.*/
+            return false;
+        } else {
+            position = atomic_load_explicit(&this->enq_position, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Private function dequeuing an element if there is one, without blocking.
+ * Returns the element, or NULL if the queue is empty.
+*/
+static void* try_deq(OverflowQueue* this) {
+    size_t position = atomic_load_explicit(&this->deq_position, memory_order_relaxed);
+    while (true) {
+        OverflowCell *cell = &this->cells[position % this->max_size];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(position + ONE);
+        if (difference == ZERO) {
+            /** The slot holds the element of this position: claims it, then frees the slot for the next lap.*/
+            if (atomic_compare_exchange_weak_explicit(&this->deq_position, &position, position + ONE, memory_order_relaxed, memory_order_relaxed)) {
+                void *element = cell->element;
+                atomic_store_explicit(&cell->sequence, position + this->max_size, memory_order_release);
+                return element;
+            }
+        } else if (difference < ZERO) {
+            /** The element of this position is not published yet: the queue is empty.*/
+            return NULL;
+        } else {
+            position = atomic_load_explicit(&this->deq_position, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Private function waking one sleeping thread after an operation, if any is registered as waiting.
+*/
+static void wake_one(OverflowQueue* this, _Atomic int* waiting, pthread_cond_t* condition) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed) > ZERO) {
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waking a thread");}
+        if (pthread_cond_signal(condition)) { cleanup_exit(this, "Error: pthread_cond_signal() failed");}
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waking a thread");}
+    }
+}
+
+OverflowQueue* new_OverflowQueue(int max_size, int policy) {
+
+    /** Checks that the given max_size is a valid maximum capacity and the policy a known one.*/
+    if (max_size <= ZERO || policy < OVERFLOW_BLOCK || policy > OVERFLOW_OVERWRITE_OLDEST) {
+        return NULL;
+    }
+
+    /** Allocate memory for the cache line aligned structure and its slots in one block.*/
+    size_t size = sizeof(OverflowQueue) + max_size * sizeof(OverflowCell);
+    size = (size + OVERFLOW_CACHE_LINE - ONE) / OVERFLOW_CACHE_LINE * OVERFLOW_CACHE_LINE;
+    OverflowQueue *this = aligned_alloc(OVERFLOW_CACHE_LINE, size);
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for OverflowQueue");
+        return NULL;
+    }
+    this->cells = (OverflowCell*)(this + ONE);
+    this->policy = policy;
+    this->max_size = max_size;
+
+    /** Each slot starts free for the first lap.*/
+    for (int i = ZERO; i < max_size; i++) {
+        atomic_init(&this->cells[i].sequence, (size_t)i);
+    }
+    atomic_init(&this->enq_position, ZERO);
+    atomic_init(&this->deq_position, ZERO);
+    atomic_init(&this->dropped, ZERO);
+    atomic_init(&this->waiting_producers, ZERO);
+    atomic_init(&this->waiting_consumers, ZERO);
+
+    if (pthread_mutex_init(&this->mutex, NULL)
+            || pthread_cond_init(&this->not_empty, NULL)
+            || pthread_cond_init(&this->not_full, NULL)) {
+        perror("Error: failed to initialize OverflowQueue synchronization");
+        free(this);
+        return NULL;
+    }
+    return this;
+}
+
+bool OverflowQueue_enq(OverflowQueue* this, void* element) {
+
+    /** Check that the element is not NULL.*/
+    if (element == NULL) {
+        return false;
+    }
+
+    while (!try_enq(this, element)) {
+        if (this->policy == OVERFLOW_DROP_NEWEST) {
+            atomic_fetch_add_explicit(&this->dropped, ONE, memory_order_relaxed);
+            return false;
+        }
+        if (this->policy == OVERFLOW_OVERWRITE_OLDEST) {
+            /** Drops the oldest element to make room, unless a consumer took it first, then tries again.*/
+            if (try_deq(this) != NULL) {
+                atomic_fetch_add_explicit(&this->dropped, ONE, memory_order_relaxed);
+            }
+            continue;
+        }
+
+        /** OVERFLOW_BLOCK: registers as waiting, then tries once more before each sleep.*/
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waiting for space");}
+        atomic_fetch_add(&this->waiting_producers, ONE);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (!try_enq(this, element)) {
+            if (pthread_cond_wait(&this->not_full, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_full");}
+        }
+        atomic_fetch_sub(&this->waiting_producers, ONE);
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waiting for space");}
+        break;
+    }
+
+    wake_one(this, &this->waiting_consumers, &this->not_empty);
+    return true;
+}
+
+void* OverflowQueue_deq(OverflowQueue* this) {
+    void *element = try_deq(this);
+    if (element == NULL) {
+        /** Registers as waiting, then tries once more before each sleep.*/
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waiting for an element");}
+        atomic_fetch_add(&this->waiting_consumers, ONE);
+        atomic_thread_fence(memory_order_seq_cst);
+        while ((element = try_deq(this)) == NULL) {
+            if (pthread_cond_wait(&this->not_empty, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_empty");}
+        }
+        atomic_fetch_sub(&this->waiting_consumers, ONE);
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waiting for an element");}
+    }
+    wake_one(this, &this->waiting_producers, &this->not_full);
+    return element;
+}
+
+void* OverflowQueue_tryDeq(OverflowQueue* this) {
+    void *element = try_deq(this);
+    if (element != NULL) {
+        wake_one(this, &this->waiting_producers, &this->not_full);
+    }
+    return element;
+}
+
+int OverflowQueue_size(OverflowQueue* this) {
+    /** Reads the consumer position first, so that the difference is rarely negative, then clamps it to the capacity.*/
+    size_t deq_position = atomic_load(&this->deq_position);
+    size_t enq_position = atomic_load(&this->enq_position);
+    intptr_t size = (intptr_t)(enq_position - deq_position);
+    if (size < ZERO) {
+        return ZERO;
+    }
+    return size > this->max_size ? this->max_size : (int)size;
+}
+
+bool OverflowQueue_isEmpty(OverflowQueue* this) {
+    return OverflowQueue_size(this) == ZERO;
+}
+
+long OverflowQueue_dropped(OverflowQueue* this) {
+    return atomic_load(&this->dropped);
+}
+
+void OverflowQueue_destroy(OverflowQueue* this) {
+    /** Destroys the slow path synchronization, then frees the queue and its slots.*/
+    pthread_cond_destroy(&this->not_full);
+    pthread_cond_destroy(&this->not_empty);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
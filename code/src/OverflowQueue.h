@@ -0,0 +1,115 @@
+/*
+ * OverflowQueue.h
+ *
+ * Module interface for a fixed-size lock-free MPMC Queue with a per-queue overflow policy deciding what enq does on a full
+ * queue: block like a BlockingQueue, drop the new element, or overwrite the oldest one so that a hot producer never stalls.
+ * Dropped elements are counted.
+ *
+ */
+
+#ifndef OVERFLOW_QUEUE_H_
+#define OVERFLOW_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "Queue.h"
+
+/** Size of a cache line, the producer and consumer positions are aligned on it so that they do not share one.*/
+#define OVERFLOW_CACHE_LINE 64
+
+/** Overflow policies: what enq does when the queue is full.*/
+#define OVERFLOW_BLOCK 0
+#define OVERFLOW_DROP_NEWEST 1
+#define OVERFLOW_OVERWRITE_OLDEST 2
+
+typedef struct OverflowCell OverflowCell;
+typedef struct OverflowQueue OverflowQueue;
+
+/*
+ * Slot of the ring. Its sequence number tells whose turn it is: equal to the position for the producer writing that
+ * position, to the position plus one for the consumer reading it.
+ */
+struct OverflowCell {
+    _Atomic size_t sequence;
+    void *element;
+};
+
+struct OverflowQueue {
+
+    /** Position of the next enq, claimed by producers with a compare and swap.*/
+    _Alignas(OVERFLOW_CACHE_LINE) _Atomic size_t enq_position;
+
+    /** Position of the next deq, claimed by consumers, and by overwriting producers, with a compare and swap.*/
+    _Alignas(OVERFLOW_CACHE_LINE) _Atomic size_t deq_position;
+
+    /** Number of elements dropped by DROP_NEWEST or OVERWRITE_OLDEST.*/
+    _Alignas(OVERFLOW_CACHE_LINE) _Atomic long dropped;
+
+    /** Threads sleeping on the slow path, read by the others after each operation to know whether to wake them.*/
+    _Atomic int waiting_producers, waiting_consumers;
+
+    /** Mutex and condition variables of the slow path, only taken by threads going to sleep and by the threads waking them.*/
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty, not_full;
+
+    /** Overflow policy and maximum capacity.*/
+    int policy;
+    int max_size;
+
+    /** Slots of the ring, allocated with the queue.*/
+    OverflowCell *cells;
+};
+
+/*
+ * Creates a new OverflowQueue for at most max_size void* elements, applying the given overflow policy when it is full.
+ * Returns a pointer to a new OverflowQueue on success and NULL on failure or for an unknown policy.
+ */
+OverflowQueue* new_OverflowQueue(int max_size, int policy);
+
+/*
+ * Enqueues the given void* element at the back of this Queue. When the queue is full:
+ * OVERFLOW_BLOCK blocks the calling thread until there is space in the queue,
+ * OVERFLOW_DROP_NEWEST drops the element and returns false,
+ * OVERFLOW_OVERWRITE_OLDEST drops the oldest element to make room, without ever blocking nor taking a lock.
+ * Returns false when element is NULL or was dropped, true on success.
+ */
+bool OverflowQueue_enq(OverflowQueue* this, void* element);
+
+/*
+ * Dequeues an element from the front of this Queue.
+ * If the queue is empty, the function will block until an element can be dequeued.
+ * Returns the dequeued void* element.
+ */
+void* OverflowQueue_deq(OverflowQueue* this);
+
+/*
+ * Dequeues an element from the front of this Queue without blocking.
+ * Returns the dequeued void* element, or NULL if the queue is empty.
+ */
+void* OverflowQueue_tryDeq(OverflowQueue* this);
+
+/*
+ * Returns the number of elements in this Queue, read from the two positions without any lock. Operations in progress may
+ * make it off by the number of threads in the middle of one, it is always between 0 and the capacity.
+ */
+int OverflowQueue_size(OverflowQueue* this);
+
+/*
+ * Returns true if this Queue is empty, false otherwise, with the same lock-free read as OverflowQueue_size.
+ */
+bool OverflowQueue_isEmpty(OverflowQueue* this);
+
+/*
+ * Returns the number of elements dropped because the queue was full.
+ */
+long OverflowQueue_dropped(OverflowQueue* this);
+
+/*
+ * Destroys this Queue by freeing the memory used by the Queue.
+ */
+void OverflowQueue_destroy(OverflowQueue* this);
+
+#endif /* OVERFLOW_QUEUE_H_ */
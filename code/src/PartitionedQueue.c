@@ -0,0 +1,267 @@
+/*
+ * PartitionedQueue.c
+ *
+ * Blocking Queue of keyed elements with per-key ordering and parallelism across keys.
+ *
+ * A partition is in the ready list exactly when it has elements and no holder: enq makes a new or idle partition ready, deq
+ * takes the oldest ready partition out of the list and holds it, and done puts it back at the end if elements arrived meanwhile.
+ * A partition which has neither elements nor a holder leaves the key index, so idle keys cost nothing.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "PartitionedQueue.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the PartitionedQueue, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(PartitionedQueue* this, char *error_mesg) {
+    PartitionedQueue_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function returning the bucket of a key in the index, mixing its bits so that sequential keys spread out.
+*/
+static Partition** bucket_of(PartitionedQueue* this, uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return &this->buckets[key & (uint64_t)this->bucket_mask];
+}
+
+/**
+ * Private function returning the partition of the given key, or NULL when the key has none.
+*/
+static Partition* find_partition(PartitionedQueue* this, uint64_t key) {
+    Partition *partition = *bucket_of(this, key);
+    while (partition != NULL && partition->key != key) {
+        partition = partition->next_in_bucket;
+    }
+    return partition;
+}
+
+/**
+ * Private function appending a partition to the ready list and waking a consumer.
+*/
+static void make_ready(PartitionedQueue* this, Partition* partition) {
+    partition->next_ready = NULL;
+    if (this->ready_tail == NULL) {
+        this->ready_head = partition;
+    } else {
+        this->ready_tail->next_ready = partition;
+    }
+    this->ready_tail = partition;
+    if (pthread_cond_signal(&this->ready)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for ready");}
+}
+
+PartitionedQueue* new_PartitionedQueue(int max_size) {
+
+    /** Checks that the given max_size is a valid maximum capacity.*/
+    if (max_size <= ZERO) {
+        return NULL;
+    }
+    int bucket_count = ONE;
+    while (bucket_count < max_size && bucket_count < (ONE << 30)) {
+        bucket_count *= TWO;
+    }
+
+    /** Allocate memory for the structure, the key index and the item pool in one block.*/
+    PartitionedQueue *this = malloc(sizeof(PartitionedQueue) + bucket_count * sizeof(Partition*) + max_size * sizeof(PartitionedItem));
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for PartitionedQueue");
+        return NULL;
+    }
+    this->buckets = (Partition**)(this + ONE);
+    for (int i = ZERO; i < bucket_count; i++) {
+        this->buckets[i] = NULL;
+    }
+    this->bucket_mask = bucket_count - ONE;
+
+    /** Chains every item of the pool into the free list.*/
+    PartitionedItem *items = (PartitionedItem*)(this->buckets + bucket_count);
+    for (int i = ZERO; i < max_size; i++) {
+        items[i].next = i + ONE < max_size ? &items[i + ONE] : NULL;
+    }
+    this->free_items = items;
+    this->free_partitions = NULL;
+    this->ready_head = NULL;
+    this->ready_tail = NULL;
+    this->current_size = ZERO;
+    this->max_size = max_size;
+
+    if (pthread_mutex_init(&this->mutex, NULL)
+            || pthread_cond_init(&this->ready, NULL)
+            || pthread_cond_init(&this->not_full, NULL)) {
+        perror("Error: failed to initialize PartitionedQueue synchronization");
+        free(this);
+        return NULL;
+    }
+    return this;
+}
+
+bool PartitionedQueue_enq(PartitionedQueue* this, uint64_t key, void* element) {
+
+    /** Check that the element is not NULL.*/
+    if (element == NULL) {
+        return false;
+    }
+
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before enqueueing");}
+    while (this->current_size == this->max_size) {
+        if (pthread_cond_wait(&this->not_full, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for not_full");}
+    }
+
+    Partition *partition = find_partition(this, key);
+    if (partition == NULL) {
+        /** First element of an idle key: takes a partition from the free list, or allocates one.*/
+        partition = this->free_partitions;
+        if (partition != NULL) {
+            this->free_partitions = partition->next_ready;
+        } else if ((partition = malloc(sizeof(Partition))) == NULL) {
+            cleanup_exit(this, "Error: Failed to allocate memory for Partition");
+        }
+        Partition **bucket = bucket_of(this, key);
+        partition->key = key;
+        partition->head = NULL;
+        partition->tail = NULL;
+        partition->held = false;
+        partition->next_in_bucket = *bucket;
+        *bucket = partition;
+    }
+
+    PartitionedItem *item = this->free_items;
+    this->free_items = item->next;
+    item->element = element;
+    item->next = NULL;
+    bool was_empty = partition->head == NULL;
+    if (was_empty) {
+        partition->head = item;
+    } else {
+        partition->tail->next = item;
+    }
+    partition->tail = item;
+    this->current_size++;
+
+    /** A partition with a holder becomes ready on done, one already having elements is already ready.*/
+    if (was_empty && !partition->held) {
+        make_ready(this, partition);
+    }
+
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after enqueueing");}
+    return true;
+}
+
+/**
+ * Private function taking the front element of the oldest ready partition and holding it, under the mutex.
+*/
+static void* take_ready(PartitionedQueue* this, uint64_t* key) {
+    Partition *partition = this->ready_head;
+    this->ready_head = partition->next_ready;
+    if (this->ready_head == NULL) {
+        this->ready_tail = NULL;
+    }
+    partition->held = true;
+
+    PartitionedItem *item = partition->head;
+    partition->head = item->next;
+    if (partition->head == NULL) {
+        partition->tail = NULL;
+    }
+    void *element = item->element;
+    item->next = this->free_items;
+    this->free_items = item;
+    this->current_size--;
+    if (key != NULL) {
+        *key = partition->key;
+    }
+
+    if (pthread_cond_signal(&this->not_full)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for not_full");}
+    return element;
+}
+
+void* PartitionedQueue_deq(PartitionedQueue* this, uint64_t* key) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    while (this->ready_head == NULL) {
+        if (pthread_cond_wait(&this->ready, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for ready");}
+    }
+    void *element = take_ready(this, key);
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return element;
+}
+
+void* PartitionedQueue_tryDeq(PartitionedQueue* this, uint64_t* key) {
+    void *element = NULL;
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before dequeueing");}
+    if (this->ready_head != NULL) {
+        element = take_ready(this, key);
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after dequeueing");}
+    return element;
+}
+
+bool PartitionedQueue_done(PartitionedQueue* this, uint64_t key) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before releasing a key");}
+    Partition *partition = find_partition(this, key);
+    bool held = partition != NULL && partition->held;
+    if (held) {
+        partition->held = false;
+        if (partition->head != NULL) {
+            make_ready(this, partition);
+        } else {
+            /** The key is idle: unlinks its partition from the index and keeps it for reuse.*/
+            Partition **link = bucket_of(this, key);
+            while (*link != partition) {
+                link = &(*link)->next_in_bucket;
+            }
+            *link = partition->next_in_bucket;
+            partition->next_ready = this->free_partitions;
+            this->free_partitions = partition;
+        }
+    }
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after releasing a key");}
+    return held;
+}
+
+int PartitionedQueue_size(PartitionedQueue* this) {
+    if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before reading the size");}
+    int size = this->current_size;
+    if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after reading the size");}
+    return size;
+}
+
+bool PartitionedQueue_isEmpty(PartitionedQueue* this) {
+    return PartitionedQueue_size(this) == ZERO;
+}
+
+void PartitionedQueue_destroy(PartitionedQueue* this) {
+    /** Frees the partitions of the index and of the free list.*/
+    for (int i = ZERO; i <= this->bucket_mask; i++) {
+        Partition *partition = this->buckets[i];
+        while (partition != NULL) {
+            Partition *next = partition->next_in_bucket;
+            free(partition);
+            partition = next;
+        }
+    }
+    while (this->free_partitions != NULL) {
+        Partition *next = this->free_partitions->next_ready;
+        free(this->free_partitions);
+        this->free_partitions = next;
+    }
+
+    /** Destroys the synchronization, then frees the queue with its index and item pool.*/
+    pthread_cond_destroy(&this->not_full);
+    pthread_cond_destroy(&this->ready);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
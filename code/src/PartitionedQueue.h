@@ -0,0 +1,127 @@
+/*
+ * PartitionedQueue.h
+ *
+ * Module interface for a fixed-size Blocking Queue of keyed elements consumed in parallel while keeping per-key order.
+ *
+ * Elements of the same key form a partition, delivered strictly in FIFO order and never to two consumers at once: a consumer
+ * holds the key of the element it dequeued until it calls PartitionedQueue_done, and the next element of that key waits
+ * meanwhile. Elements of different keys go to any consumer. Partitions with elements to deliver and no holder sit in a ready
+ * list, so a consumer takes the next one in O(1) instead of scanning empty or held partitions.
+ *
+ */
+
+#ifndef PARTITIONED_QUEUE_H_
+#define PARTITIONED_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "Queue.h"
+
+typedef struct PartitionedItem PartitionedItem;
+typedef struct Partition Partition;
+typedef struct PartitionedQueue PartitionedQueue;
+
+/*
+ * Element waiting in its partition. Items come from a pool of max_size items allocated with the queue.
+ */
+struct PartitionedItem {
+    void *element;
+    PartitionedItem *next;
+};
+
+/*
+ * Elements of one key, in FIFO order. A partition exists while it has elements or is held by a consumer, and is then kept on
+ * a free list for reuse.
+ */
+struct Partition {
+
+    /** Key of the partition and its elements, oldest first.*/
+    uint64_t key;
+    PartitionedItem *head, *tail;
+
+    /** True while a consumer processes an element of this partition.*/
+    bool held;
+
+    /** Next partition in the ready list, or in the free list.*/
+    Partition *next_ready;
+
+    /** Next partition in the same bucket of the key index.*/
+    Partition *next_in_bucket;
+};
+
+struct PartitionedQueue {
+
+    /** Mutex ensuring thread safety.*/
+    pthread_mutex_t mutex;
+
+    /** Condition variables consumers wait on while no partition is ready, and producers while the queue is full.*/
+    pthread_cond_t ready, not_full;
+
+    /** Partitions with elements and no holder, in the order they became ready.*/
+    Partition *ready_head, *ready_tail;
+
+    /** Index of the existing partitions by key: chained buckets, a power of two of them.*/
+    Partition **buckets;
+    int bucket_mask;
+
+    /** Partitions and items not in use.*/
+    Partition *free_partitions;
+    PartitionedItem *free_items;
+
+    /** Number of elements in the queue and maximum capacity.*/
+    int current_size;
+    int max_size;
+};
+
+/*
+ * Creates a new PartitionedQueue for at most max_size void* elements.
+ * Returns a pointer to a new PartitionedQueue on success and NULL on failure.
+ */
+PartitionedQueue* new_PartitionedQueue(int max_size);
+
+/*
+ * Enqueues the given void* element at the back of the partition of the given key.
+ * If the queue is full, the function will block the calling thread until there is space in the queue.
+ * Returns false when element is NULL, true on success.
+ */
+bool PartitionedQueue_enq(PartitionedQueue* this, uint64_t key, void* element);
+
+/*
+ * Dequeues the front element of the oldest ready partition, stores its key at the given address, and holds that key for
+ * the calling consumer until PartitionedQueue_done.
+ * If no partition is ready, the function will block until one is.
+ * Returns the dequeued void* element.
+ */
+void* PartitionedQueue_deq(PartitionedQueue* this, uint64_t* key);
+
+/*
+ * Non-blocking version of PartitionedQueue_deq.
+ * Returns the dequeued void* element, or NULL when no partition is ready.
+ */
+void* PartitionedQueue_tryDeq(PartitionedQueue* this, uint64_t* key);
+
+/*
+ * Releases the given key once the consumer holding it is done with its element, making its next element, if any, ready.
+ * Returns false when the key is not held.
+ */
+bool PartitionedQueue_done(PartitionedQueue* this, uint64_t key);
+
+/*
+ * Returns the number of elements in this Queue, held elements excluded.
+ */
+int PartitionedQueue_size(PartitionedQueue* this);
+
+/*
+ * Returns true if this Queue is empty, false otherwise.
+ */
+bool PartitionedQueue_isEmpty(PartitionedQueue* this);
+
+/*
+ * Destroys this Queue by freeing the memory used by the Queue and its partitions.
+ */
+void PartitionedQueue_destroy(PartitionedQueue* this);
+
+#endif /* PARTITIONED_QUEUE_H_ */
@@ -0,0 +1,230 @@
+/*
+ * Pipeline.c
+ *
+ * Pipeline of worker stages connected by bounded queues.
+ *
+ * Backpressure comes from the queues themselves: a full queue blocks the stage feeding it, which stops reading its own queue,
+ * up to Pipeline_submit. The end of the stream is a marker item: each worker of a stage takes one marker and exits, and the
+ * last worker to exit sends one marker per worker of the next stage, once every item of its stage has been passed on.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "Pipeline.h"
+
+/** Marker item sent through the queues once every item has been submitted.*/
+static char end_of_stream;
+#define END_OF_STREAM ((void*)&end_of_stream)
+
+/**
+ * Private function to exit the program in case of POSIX functions errors.
+ *
+ * The Pipeline is not destroyed since its workers may still be using it, the function prints the error message and terminates
+ * the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(char *error_mesg) {
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function creating the queue of an edge, returns false on failure.
+*/
+static bool edge_init(PipelineEdge* edge, int writers, int readers, int capacity) {
+    edge->kind = (writers == ONE && readers == ONE) ? PIPELINE_EDGE_SPSC : PIPELINE_EDGE_MPMC;
+    edge->ring = NULL;
+    edge->queue = NULL;
+    if (edge->kind == PIPELINE_EDGE_SPSC) {
+        edge->ring = new_BroadcastRing(capacity, ONE);
+        if (edge->ring == NULL) {
+            return false;
+        }
+        edge->reader = BroadcastRing_register(edge->ring);
+        return true;
+    }
+    edge->queue = new_BlockingQueue(capacity);
+    return edge->queue != NULL;
+}
+
+/**
+ * Private function adding an item to an edge, blocking while it is full.
+*/
+static void edge_put(PipelineEdge* edge, void* item) {
+    if (edge->kind == PIPELINE_EDGE_SPSC) {
+        BroadcastRing_publish(edge->ring, item);
+    } else {
+        BlockingQueue_enq(edge->queue, item);
+    }
+}
+
+/**
+ * Private function taking an item from an edge, blocking while it is empty.
+*/
+static void* edge_take(PipelineEdge* edge) {
+    if (edge->kind == PIPELINE_EDGE_SPSC) {
+        return BroadcastRing_read(edge->ring, edge->reader);
+    }
+    return BlockingQueue_deq(edge->queue);
+}
+
+/**
+ * Private function freeing the queue of an edge.
+*/
+static void edge_destroy(PipelineEdge* edge) {
+    if (edge->ring != NULL) { BroadcastRing_destroy(edge->ring);}
+    if (edge->queue != NULL) { BlockingQueue_destroy(edge->queue);}
+}
+
+/**
+ * Private function sending one end of stream marker to every worker of the given stage.
+*/
+static void end_stream(PipelineStage* stage) {
+    for (int i = ZERO; i < stage->threads; i++) {
+        edge_put(&stage->input, END_OF_STREAM);
+    }
+}
+
+/**
+ * Private function run by every worker thread of a stage.
+*/
+static void* worker(void* argument) {
+    PipelineStage *stage = argument;
+
+    /** Applies the stage to every item until the end of the stream, passing the results on.*/
+    void *item;
+    while ((item = edge_take(&stage->input)) != END_OF_STREAM) {
+        void *result = stage->function(item, stage->context);
+        atomic_fetch_add(&stage->processed, ONE);
+        if (stage->next != NULL && result != NULL) {
+            edge_put(&stage->next->input, result);
+        }
+    }
+
+    /** The last worker to finish ends the stream of the next stage.*/
+    if (atomic_fetch_sub(&stage->live, ONE) == ONE && stage->next != NULL) {
+        end_stream(stage->next);
+    }
+    return NULL;
+}
+
+Pipeline* new_Pipeline(int max_stages) {
+
+    if (max_stages <= ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the Pipeline structure and its stages.*/
+    Pipeline *this = malloc(sizeof(Pipeline));
+    PipelineStage *stages = calloc(max_stages, sizeof(PipelineStage));
+    if (this == NULL || stages == NULL) {
+        perror("Error: Failed to allocate memory for Pipeline");
+        free(this);
+        free(stages);
+        return NULL;
+    }
+    this->stages = stages;
+    this->stage_count = ZERO;
+    this->max_stages = max_stages;
+    this->started = false;
+    this->draining = false;
+    return this;
+}
+
+bool Pipeline_addStage(Pipeline* this, PipelineFunction function, void* context, int threads, int capacity) {
+
+    if (this->started || this->stage_count == this->max_stages || function == NULL || threads <= ZERO || capacity <= ZERO) {
+        return false;
+    }
+
+    /** The queue of the first stage is written by the thread submitting items, the others by the workers of the previous stage.*/
+    PipelineStage *stage = &this->stages[this->stage_count];
+    int writers = (this->stage_count == ZERO) ? ONE : this->stages[this->stage_count - ONE].threads;
+    if (!edge_init(&stage->input, writers, threads, capacity)) {
+        return false;
+    }
+
+    stage->workers = malloc(threads * sizeof(pthread_t));
+    if (stage->workers == NULL) {
+        perror("Error: Failed to allocate memory for Pipeline workers");
+        edge_destroy(&stage->input);
+        return false;
+    }
+    stage->function = function;
+    stage->context = context;
+    stage->threads = threads;
+    stage->next = NULL;
+    atomic_init(&stage->live, threads);
+    atomic_init(&stage->processed, ZERO);
+
+    if (this->stage_count > ZERO) {
+        this->stages[this->stage_count - ONE].next = stage;
+    }
+    this->stage_count++;
+    return true;
+}
+
+bool Pipeline_start(Pipeline* this) {
+
+    if (this->started || this->stage_count == ZERO) {
+        return false;
+    }
+    for (int i = ZERO; i < this->stage_count; i++) {
+        PipelineStage *stage = &this->stages[i];
+        for (int j = ZERO; j < stage->threads; j++) {
+            if (pthread_create(&stage->workers[j], NULL, worker, stage)) { cleanup_exit("Error: pthread_create() failed for Pipeline worker");}
+        }
+    }
+    this->started = true;
+    return true;
+}
+
+bool Pipeline_submit(Pipeline* this, void* item) {
+
+    if (item == NULL || !this->started || this->draining) {
+        return false;
+    }
+    edge_put(&this->stages[ZERO].input, item);
+    return true;
+}
+
+void Pipeline_drain(Pipeline* this) {
+
+    if (!this->started || this->draining) {
+        return;
+    }
+    this->draining = true;
+
+    /** Ends the stream at the head, then waits for it to reach the end of every stage.*/
+    end_stream(&this->stages[ZERO]);
+    for (int i = ZERO; i < this->stage_count; i++) {
+        PipelineStage *stage = &this->stages[i];
+        for (int j = ZERO; j < stage->threads; j++) {
+            if (pthread_join(stage->workers[j], NULL)) { cleanup_exit("Error: pthread_join() failed for Pipeline worker");}
+        }
+    }
+}
+
+int Pipeline_edgeKind(Pipeline* this, int stage) {
+    return this->stages[stage].input.kind;
+}
+
+long Pipeline_processed(Pipeline* this, int stage) {
+    return atomic_load(&this->stages[stage].processed);
+}
+
+void Pipeline_destroy(Pipeline* this) {
+    /** Lets the workers finish before freeing the queues they use.*/
+    Pipeline_drain(this);
+    for (int i = ZERO; i < this->stage_count; i++) {
+        edge_destroy(&this->stages[i].input);
+        free(this->stages[i].workers);
+    }
+    free(this->stages);
+    free(this);
+}
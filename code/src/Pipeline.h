@@ -0,0 +1,137 @@
+/*
+ * Pipeline.h
+ *
+ * Module interface for a pipeline of worker stages connected by bounded queues.
+ *
+ */
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "Queue.h"
+#include "BlockingQueue.h"
+#include "BroadcastRing.h"
+
+/** Kinds of queue connecting a stage to what feeds it.*/
+#define PIPELINE_EDGE_SPSC 0
+#define PIPELINE_EDGE_MPMC 1
+
+typedef struct PipelineEdge PipelineEdge;
+typedef struct PipelineStage PipelineStage;
+typedef struct Pipeline Pipeline;
+
+/*
+ * Function run by the workers of a stage on every item, with the context given when the stage was added.
+ * The returned item is passed on to the next stage, NULL drops the item. The value returned by the last stage is ignored.
+ */
+typedef void* (*PipelineFunction)(void* item, void* context);
+
+/*
+ * Bounded queue feeding a stage.
+ */
+struct PipelineEdge {
+
+    /** PIPELINE_EDGE_SPSC when one thread writes and one thread reads the edge, PIPELINE_EDGE_MPMC otherwise.*/
+    int kind;
+
+    /** Lock-free ring with a single reader, used by SPSC edges.*/
+    BroadcastRing *ring;
+
+    /** Identifier of the single reader of ring.*/
+    int reader;
+
+    /** BlockingQueue used by MPMC edges.*/
+    BlockingQueue *queue;
+};
+
+struct PipelineStage {
+
+    /** Function applied to every item and its context.*/
+    PipelineFunction function;
+    void *context;
+
+    /** Number of worker threads running this stage.*/
+    int threads;
+
+    /** Queue feeding this stage.*/
+    PipelineEdge input;
+
+    /** Stage fed by this one, NULL for the last stage.*/
+    PipelineStage *next;
+
+    /** Worker threads of this stage.*/
+    pthread_t *workers;
+
+    /** Number of workers which have not seen the end of the stream yet. The last one to see it forwards it downstream.*/
+    _Atomic int live;
+
+    /** Number of items this stage has processed.*/
+    _Atomic long processed;
+};
+
+struct Pipeline {
+
+    /** Stages in the order items go through them.*/
+    PipelineStage *stages;
+
+    /** Number of stages added and maximum number of stages.*/
+    int stage_count, max_stages;
+
+    /** True once the workers are running, and once the end of the stream has been submitted.*/
+    bool started, draining;
+};
+
+/*
+ * Creates a new Pipeline for at most max_stages stages.
+ * Returns a pointer to a new Pipeline on success and NULL on failure.
+ */
+Pipeline* new_Pipeline(int max_stages);
+
+/*
+ * Appends a stage running function on threads worker threads, fed by a queue holding at most capacity items.
+ * The queue is single-producer single-consumer when one thread feeds it and one thread reads it, and a BlockingQueue otherwise.
+ * Stages must all be added before the Pipeline is started.
+ * Returns false when the Pipeline is full or started, when threads or capacity are not positive, or when the queue cannot be created.
+ */
+bool Pipeline_addStage(Pipeline* this, PipelineFunction function, void* context, int threads, int capacity);
+
+/*
+ * Starts the worker threads of every stage.
+ * Returns false when the Pipeline has no stage or is already started, true on success.
+ */
+bool Pipeline_start(Pipeline* this);
+
+/*
+ * Submits the given item to the first stage, blocking while its queue is full.
+ * Items must be submitted by a single thread.
+ * Returns false when item is NULL or the Pipeline is not running, true on success.
+ */
+bool Pipeline_submit(Pipeline* this, void* item);
+
+/*
+ * Ends the stream: every item already submitted goes through every stage, then the workers exit.
+ * Blocks until every worker has exited. Calling it again has no effect.
+ */
+void Pipeline_drain(Pipeline* this);
+
+/*
+ * Returns the kind of queue feeding the given stage, PIPELINE_EDGE_SPSC or PIPELINE_EDGE_MPMC.
+ */
+int Pipeline_edgeKind(Pipeline* this, int stage);
+
+/*
+ * Returns the number of items the given stage has processed.
+ */
+long Pipeline_processed(Pipeline* this, int stage);
+
+/*
+ * Destroys this Pipeline, draining it first if it is running, and frees the memory it uses.
+ */
+void Pipeline_destroy(Pipeline* this);
+
+#endif /* PIPELINE_H_ */
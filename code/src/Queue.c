@@ -23,13 +23,36 @@ Queue *new_Queue(int max_size) {
         return NULL;
     }
 
-    /** Allocate memory for the Queue structure.*/
-    Queue *this = malloc(sizeof(Queue));
-
     /**
-     * Initialize the Queue structure fields...
-     * 
+     * Allocate memory for the Queue structure and its elements in a single block.
+     * The array of pointers starts right after the structure, which is already aligned for void*.
     */
+    Queue *this = malloc(sizeof(Queue) + Queue_storageSize(max_size));
+    if (this == NULL) {
+        return NULL;
+    }
+
+    /** Initialize the Queue structure fields over the array following it.*/
+    Queue_init(this, max_size, this + ONE);
+
+    /** Return the pointer to the newly created Queue.*/
+    return this;
+}
+
+size_t Queue_storageSize(int max_size) {
+    /** An invalid maximum capacity needs no storage.*/
+    if (max_size <= ZERO) {
+        return ZERO;
+    }
+    return QUEUE_STORAGE_SIZE(max_size);
+}
+
+bool Queue_init(Queue* this, int max_size, void* storage) {
+
+    /** Checks that the memory is provided and that the given max_size is a valid maximum capacity.*/
+    if (this == NULL || storage == NULL || max_size <= ZERO) {
+        return false;
+    }
 
     /** Sets the maximum capacity of the queue. */
     this->max_size = max_size;
@@ -40,14 +63,10 @@ Queue *new_Queue(int max_size) {
     /** Sets the rear to the last index.*/
     this->rear = max_size - ONE;
 
-    /**
-     * Allocate memory for the queue elements.
-     * Dynamically allocates memory for an array of pointers
-    */
-    this->array = malloc(this->max_size * sizeof(void*));
+    /** Uses the caller's storage for the queue elements.*/
+    this->array = storage;
 
-    /** Return the pointer to the newly created Queue.*/
-    return this;
+    return true;
 }
 
 bool Queue_enq(Queue* this, void* element) {
@@ -116,9 +135,13 @@ void Queue_clear(Queue* this) {
     this->rear = this->max_size - ONE;
 }
 
+void Queue_deinit(Queue* this) {
+    /** The memory belongs to the caller, only forget about the storage.*/
+    this->array = NULL;
+    this->current_size = ZERO;
+}
+
 void Queue_destroy(Queue* this) {
-    /** Free the array of elements.*/
-    free(this->array);
-    /** Free the Queue structure itself.*/
+    /** Free the Queue structure itself, its array of elements was allocated with it.*/
     free(this);
 }
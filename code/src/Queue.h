@@ -9,6 +9,7 @@
 #define QUEUE_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 
 #define ZERO 0
@@ -25,12 +26,28 @@ struct Queue {
     void* array;
 };
 
+/** Number of bytes of slot storage needed by a Queue of max_size elements, usable to size storage at compile time.*/
+#define QUEUE_STORAGE_SIZE(max_size) ((size_t)(max_size) * sizeof(void*))
+
 /*
  * Creates a new Queue for at most max_size void* elements.
  * Returns a pointer to a new Queue on success and NULL on failure.
  */
 Queue* new_Queue(int max_size);
 
+/*
+ * Returns the number of bytes of slot storage needed by a Queue of max_size elements, or 0 if max_size is not positive.
+ */
+size_t Queue_storageSize(int max_size);
+
+/*
+ * Initializes the Queue pointed to by this, which the caller allocated, for at most max_size void* elements.
+ * storage must point to at least Queue_storageSize(max_size) bytes aligned for void*, and must outlive the Queue.
+ * Nothing is allocated: the Queue can be embedded in another struct, placed on the stack or in an arena.
+ * Returns true on success and false when this or storage is NULL or max_size is not positive.
+ */
+bool Queue_init(Queue* this, int max_size, void* storage);
+
 /*
  * Enqueues the given void* element at the back of this Queue.
  * Returns true on success and false on enq failure when element is NULL or queue is full.
@@ -58,8 +75,14 @@ bool Queue_isEmpty(Queue* this);
  */
 void Queue_clear(Queue* this);
 
+/*
+ * Releases a Queue initialized with Queue_init. The Queue and its storage belong to the caller and are not freed.
+ */
+void Queue_deinit(Queue* this);
+
 /*
  * Destroys this Queue by freeing the memory used by the Queue.
+ * Must only be called on a Queue created by new_Queue.
  */
 void Queue_destroy(Queue* this);
 
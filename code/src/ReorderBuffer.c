@@ -0,0 +1,200 @@
+/*
+ * ReorderBuffer.c
+ *
+ * Reorder buffer restoring sequence order with a bounded window.
+ *
+ * The ring has one slot per sequence number of the window, so a result is stored with a single compare and swap, without a
+ * lock nor any search, and the sink only ever looks at the slot of the head. A slot is reused for the sequence number
+ * window_size later, which can only be stamped once the sink moved past the previous one.
+ *
+ * Only sleeping threads take the mutex: the sink and producers about to sleep register as waiting under the mutex and check
+ * once more, while a thread which completed an operation checks the waiting counts after a full fence and wakes them under
+ * the mutex.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "ReorderBuffer.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function destroys the ReorderBuffer, prints the error message and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(ReorderBuffer* this, char *error_mesg) {
+    ReorderBuffer_destroy(this);
+    perror(error_mesg);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function waking one sleeping thread after an operation, if any is registered as waiting.
+*/
+static void wake_one(ReorderBuffer* this, _Atomic int* waiting, pthread_cond_t* condition) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed) > ZERO) {
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waking a thread");}
+        if (pthread_cond_signal(condition)) { cleanup_exit(this, "Error: pthread_cond_signal() failed");}
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waking a thread");}
+    }
+}
+
+/**
+ * Private function stamping a sequence number if the window has room, without blocking.
+ * Returns false if the window is full.
+*/
+static bool try_stamp(ReorderBuffer* this, uint64_t* sequence) {
+    uint64_t next = atomic_load_explicit(&this->next_sequence, memory_order_relaxed);
+    while (true) {
+        /** Acquires the head so that the sink's release of the slot happens before the result of this sequence number is stored.*/
+        if (next - atomic_load_explicit(&this->head, memory_order_acquire) >= (uint64_t)this->window_size) {
+            return false;
+        }
+        if (atomic_compare_exchange_weak_explicit(&this->next_sequence, &next, next + ONE, memory_order_relaxed, memory_order_relaxed)) {
+            *sequence = next;
+            return true;
+        }
+    }
+}
+
+/**
+ * Private function taking the result of the head if it was submitted, without blocking nor waking producers.
+ * Returns the result, or NULL if it was not submitted yet.
+*/
+static void* take_head(ReorderBuffer* this) {
+    uint64_t head = atomic_load_explicit(&this->head, memory_order_relaxed);
+    void* _Atomic *slot = &this->slots[head % (uint64_t)this->window_size];
+    void *result = atomic_load_explicit(slot, memory_order_acquire);
+    if (result != NULL) {
+        /** Frees the slot, then moves the head on, which lets the sequence number window_size later be stamped.*/
+        atomic_store_explicit(slot, NULL, memory_order_relaxed);
+        atomic_store_explicit(&this->head, head + ONE, memory_order_release);
+    }
+    return result;
+}
+
+ReorderBuffer* new_ReorderBuffer(int window_size) {
+
+    /** Checks that the given window_size is a valid window.*/
+    if (window_size <= ZERO) {
+        return NULL;
+    }
+
+    /** Allocate memory for the cache line aligned structure and its ring in one block.*/
+    size_t size = sizeof(ReorderBuffer) + window_size * sizeof(void* _Atomic);
+    size = (size + REORDER_CACHE_LINE - ONE) / REORDER_CACHE_LINE * REORDER_CACHE_LINE;
+    ReorderBuffer *this = aligned_alloc(REORDER_CACHE_LINE, size);
+    if (this == NULL) {
+        perror("Error: Failed to allocate memory for ReorderBuffer");
+        return NULL;
+    }
+    this->slots = (void* _Atomic *)(this + ONE);
+    for (int i = ZERO; i < window_size; i++) {
+        atomic_init(&this->slots[i], NULL);
+    }
+    this->window_size = window_size;
+    atomic_init(&this->next_sequence, ZERO);
+    atomic_init(&this->head, ZERO);
+    atomic_init(&this->sink_waiting, ZERO);
+    atomic_init(&this->waiting_producers, ZERO);
+
+    if (pthread_mutex_init(&this->mutex, NULL)
+            || pthread_cond_init(&this->in_order, NULL)
+            || pthread_cond_init(&this->window, NULL)) {
+        perror("Error: failed to initialize ReorderBuffer synchronization");
+        free(this);
+        return NULL;
+    }
+    return this;
+}
+
+uint64_t ReorderBuffer_nextSequence(ReorderBuffer* this) {
+    uint64_t sequence;
+    if (!try_stamp(this, &sequence)) {
+        /** The window is full: registers as waiting, then tries once more before each sleep.*/
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waiting for the window");}
+        atomic_fetch_add(&this->waiting_producers, ONE);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (!try_stamp(this, &sequence)) {
+            if (pthread_cond_wait(&this->window, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for window");}
+        }
+        atomic_fetch_sub(&this->waiting_producers, ONE);
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waiting for the window");}
+    }
+    return sequence;
+}
+
+bool ReorderBuffer_submit(ReorderBuffer* this, uint64_t sequence, void* result) {
+
+    /** Checks that the result is not NULL and that the sequence number is in flight.*/
+    if (result == NULL
+            || sequence >= atomic_load(&this->next_sequence)
+            || sequence < atomic_load(&this->head)) {
+        return false;
+    }
+
+    /**
+     * Stores the result in the slot of its sequence number, unless a result is waiting in it. A duplicate submission passing
+     * the range check just before the sink frees the slot is not caught, as documented: the slot is then free for the sequence
+     * number window_size later, and no single compare and swap can tell the two apart.
+    */
+    void *expected = NULL;
+    if (!atomic_compare_exchange_strong(&this->slots[sequence % (uint64_t)this->window_size], &expected, result)) {
+        return false;
+    }
+
+    /** Only the result of the head can unblock the sink.*/
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&this->sink_waiting, memory_order_relaxed) > ZERO && sequence == atomic_load(&this->head)) {
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waking the sink");}
+        if (pthread_cond_signal(&this->in_order)) { cleanup_exit(this, "Error: pthread_cond_signal() failed for in_order");}
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waking the sink");}
+    }
+    return true;
+}
+
+void* ReorderBuffer_deq(ReorderBuffer* this) {
+    void *result = take_head(this);
+    if (result == NULL) {
+        /** The head is not submitted yet: registers as waiting, then checks once more before each sleep.*/
+        if (pthread_mutex_lock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_lock() failed before waiting for the head");}
+        atomic_store(&this->sink_waiting, ONE);
+        atomic_thread_fence(memory_order_seq_cst);
+        while ((result = take_head(this)) == NULL) {
+            if (pthread_cond_wait(&this->in_order, &this->mutex)) { cleanup_exit(this, "Error: pthread_cond_wait() failed for in_order");}
+        }
+        atomic_store(&this->sink_waiting, ZERO);
+        if (pthread_mutex_unlock(&this->mutex)) { cleanup_exit(this, "Error: pthread_mutex_unlock() failed after waiting for the head");}
+    }
+    wake_one(this, &this->waiting_producers, &this->window);
+    return result;
+}
+
+void* ReorderBuffer_tryDeq(ReorderBuffer* this) {
+    void *result = take_head(this);
+    if (result != NULL) {
+        wake_one(this, &this->waiting_producers, &this->window);
+    }
+    return result;
+}
+
+int ReorderBuffer_inFlight(ReorderBuffer* this) {
+    /** Reads the head first, so that the difference is never negative.*/
+    uint64_t head = atomic_load(&this->head);
+    return (int)(atomic_load(&this->next_sequence) - head);
+}
+
+void ReorderBuffer_destroy(ReorderBuffer* this) {
+    /** Destroys the slow path synchronization, then frees the buffer and its ring.*/
+    pthread_cond_destroy(&this->window);
+    pthread_cond_destroy(&this->in_order);
+    pthread_mutex_destroy(&this->mutex);
+    free(this);
+}
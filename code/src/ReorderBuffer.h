@@ -0,0 +1,96 @@
+/*
+ * ReorderBuffer.h
+ *
+ * Module interface for a reorder buffer restoring the input order of results computed in parallel.
+ *
+ * A producer stamps each work item with ReorderBuffer_nextSequence before handing it to the workers, for instance through a
+ * BlockingQueue. Workers submit their results under that sequence number in any order, and the sink dequeues them strictly in
+ * sequence order from a ring indexed by sequence number. At most window_size items are in flight between stamping and the
+ * sink: stamping blocks while the window is full, so one slow item bounds the buffering instead of letting it grow.
+ *
+ */
+
+#ifndef REORDER_BUFFER_H_
+#define REORDER_BUFFER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "Queue.h"
+
+/** Size of a cache line, the stamping and sink positions are aligned on it so that they do not share one.*/
+#define REORDER_CACHE_LINE 64
+
+typedef struct ReorderBuffer ReorderBuffer;
+
+struct ReorderBuffer {
+
+    /** Next sequence number to stamp, claimed by producers with a compare and swap.*/
+    _Alignas(REORDER_CACHE_LINE) _Atomic uint64_t next_sequence;
+
+    /** Sequence number the sink dequeues next, only written by the sink.*/
+    _Alignas(REORDER_CACHE_LINE) _Atomic uint64_t head;
+
+    /** Whether the sink sleeps, and how many producers sleep on a full window, read after each operation to wake them.*/
+    _Alignas(REORDER_CACHE_LINE) _Atomic int sink_waiting;
+    _Atomic int waiting_producers;
+
+    /** Mutex and condition variables of the slow path, only taken by threads going to sleep and by the threads waking them.*/
+    pthread_mutex_t mutex;
+    pthread_cond_t in_order, window;
+
+    /** Maximum number of sequence numbers in flight, and size of the ring.*/
+    int window_size;
+
+    /** Ring of submitted results, indexed by sequence number modulo window_size, NULL while not submitted.*/
+    void* _Atomic *slots;
+};
+
+/*
+ * Creates a new ReorderBuffer with at most window_size items in flight.
+ * Returns a pointer to a new ReorderBuffer on success and NULL on failure.
+ */
+ReorderBuffer* new_ReorderBuffer(int window_size);
+
+/*
+ * Stamps a new work item, returning its sequence number. Sequence numbers start at 0 and follow the order of the calls.
+ * If window_size items are already in flight, the function will block until the sink dequeues the oldest one.
+ */
+uint64_t ReorderBuffer_nextSequence(ReorderBuffer* this);
+
+/*
+ * Submits the result of the work item stamped with the given sequence number, in any order, without blocking.
+ * Each sequence number must be submitted exactly once. A second submission is refused while the first result waits for the
+ * sink or once the sink took it, but one racing with the sink taking the first result is undefined behaviour: it may be stored
+ * in the slot of the sequence number window_size later and come out in its place.
+ * Returns false when result is NULL, the sequence number is not in flight or its result is waiting for the sink.
+ */
+bool ReorderBuffer_submit(ReorderBuffer* this, uint64_t sequence, void* result);
+
+/*
+ * Dequeues the result of the oldest item in flight. Only one thread, the sink, may dequeue.
+ * If that result is not submitted yet, the function will block until it is, even if later results are.
+ * Returns the dequeued void* result.
+ */
+void* ReorderBuffer_deq(ReorderBuffer* this);
+
+/*
+ * Non-blocking version of ReorderBuffer_deq.
+ * Returns the dequeued void* result, or NULL when the result of the oldest item in flight is not submitted yet.
+ */
+void* ReorderBuffer_tryDeq(ReorderBuffer* this);
+
+/*
+ * Returns the number of items stamped and not dequeued yet.
+ */
+int ReorderBuffer_inFlight(ReorderBuffer* this);
+
+/*
+ * Destroys this ReorderBuffer by freeing the memory used by the ReorderBuffer.
+ */
+void ReorderBuffer_destroy(ReorderBuffer* this);
+
+#endif /* REORDER_BUFFER_H_ */
@@ -0,0 +1,385 @@
+/*
+ * SharedBlockingQueue.c
+ *
+ * Fixed-size BlockingQueue of fixed-size records living in a POSIX shared memory object.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "SharedBlockingQueue.h"
+
+/**
+ * Private function to cleanup and exit the program in case of POSIX functions errors.
+ *
+ * The function detaches from the shared region (other processes may still be using it), prints the error message
+ * and terminates the program with EXIT_FAILURE status.
+*/
+static void cleanup_exit(SharedBlockingQueue* this, char *error_mesg) {
+    /** Prints out the provided error message before errno is overwritten by the cleanup.*/
+    perror(error_mesg);
+
+    /** Detaches from the shared region.*/
+    SharedBlockingQueue_close(this);
+
+    /** Terminates the program with EXIT_FAILURE status.*/
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Private function to cleanup and exit the program when the creator fails to initialize the shared region.
+ *
+ * The function unlinks the shared object first, so that no later process attaches to a half-initialized region it could never
+ * recover, then cleans up and exits like cleanup_exit.
+*/
+static void creation_cleanup_exit(SharedBlockingQueue* this, char *error_mesg) {
+    /** Keeps the errno of the failure for the error message.*/
+    int error = errno;
+    shm_unlink(this->name);
+    errno = error;
+    cleanup_exit(this, error_mesg);
+}
+
+/**
+ * Private function returning the address of the slot at the given index in this process' mapping.
+*/
+static char* slot_at(SharedBlockingQueue* this, int index) {
+    return (char*)this->header + this->header->slots_offset + (size_t)index * this->header->record_size;
+}
+
+/**
+ * Private function restoring the queue to a consistent state after the previous owner of the mutex died holding it.
+ *
+ * The journal tells which operation the dead owner was performing, none when it died before journaling one or outside of
+ * enq and deq, in which case the queue was not modified and only its counts are validated:
+ * - an enqueue whose record was completely copied is rolled forward and its full slot is posted,
+ * - any other enqueue is rolled back and the empty slot it had taken is returned,
+ * - a dequeue is rolled back (its caller never received the record) and the full slot it had taken is returned.
+ *
+ * front, rear and current_size are then validated against the semaphore counts: a semaphore may hold fewer permits
+ * than its side of the queue (live processes can be between sem_wait and the mutex) but never more.
+ * A permit leaked by a process dying outside the mutex (between sem_wait and lock, or between unlock and sem_post)
+ * cannot be told apart from a live process in that window and is not recovered.
+*/
+static void recover(SharedBlockingQueue* this) {
+    SharedBlockingQueueHeader *header = this->header;
+
+    /** Restores the values the dead owner started from, unless it was not modifying the queue.*/
+    if (header->pending_op != SHARED_BLOCKING_QUEUE_OP_NONE) {
+        header->front = header->saved_front;
+        header->rear = header->saved_rear;
+        header->current_size = header->saved_size;
+    }
+
+    if (header->pending_op == SHARED_BLOCKING_QUEUE_OP_ENQ && header->pending_copied) {
+        /** The record is in the rear slot: commit it and publish the full slot.*/
+        header->rear = (header->rear + ONE) % header->max_size;
+        header->current_size = header->current_size + ONE;
+        if (sem_post(&header->full_slots)) { cleanup_exit(this, "Error: sem_post() failed for full_slots semaphore during recovery");}
+    }
+    else if (header->pending_op == SHARED_BLOCKING_QUEUE_OP_ENQ) {
+        /** The record never made it into the queue: return the empty slot.*/
+        if (sem_post(&header->empty_slots)) { cleanup_exit(this, "Error: sem_post() failed for empty_slots semaphore during recovery");}
+    }
+    else if (header->pending_op == SHARED_BLOCKING_QUEUE_OP_DEQ) {
+        /** The record is still at the front: return the full slot so that another consumer receives it.*/
+        if (sem_post(&header->full_slots)) { cleanup_exit(this, "Error: sem_post() failed for full_slots semaphore during recovery");}
+    }
+
+    /** Validates the indexes against the current size.*/
+    if (header->current_size < ZERO || header->current_size > header->max_size) {
+        header->current_size = ZERO;
+    }
+    header->front = ((header->front % header->max_size) + header->max_size) % header->max_size;
+    header->rear = (header->front + header->current_size - ONE + header->max_size) % header->max_size;
+
+    /** Removes permits that do not correspond to an occupied or free slot.*/
+    int value;
+    if (sem_getvalue(&header->full_slots, &value)) { cleanup_exit(this, "Error: sem_getvalue() failed for full_slots semaphore during recovery");}
+    for (; value > header->current_size && sem_trywait(&header->full_slots) == ZERO; value--);
+    if (sem_getvalue(&header->empty_slots, &value)) { cleanup_exit(this, "Error: sem_getvalue() failed for empty_slots semaphore during recovery");}
+    for (; value > header->max_size - header->current_size && sem_trywait(&header->empty_slots) == ZERO; value--);
+
+    header->recoveries = header->recoveries + ONE;
+}
+
+/**
+ * Private function locking the robust mutex on behalf of the given operation.
+ *
+ * Repairs the queue when the previous owner died holding the mutex, then records the operation and the current
+ * front, rear and current_size in the journal so that the queue can be repaired if the calling process dies in turn.
+*/
+static void lock_queue(SharedBlockingQueue* this, int op, char *error_mesg) {
+    SharedBlockingQueueHeader *header = this->header;
+
+    int result = pthread_mutex_lock(&header->mutex);
+    if (result == EOWNERDEAD) {
+        recover(this);
+        result = pthread_mutex_consistent(&header->mutex);
+    }
+    if (result) {
+        errno = result;
+        cleanup_exit(this, error_mesg);
+    }
+
+    header->pending_op = op;
+    header->pending_copied = false;
+    header->saved_front = header->front;
+    header->saved_rear = header->rear;
+    header->saved_size = header->current_size;
+}
+
+/**
+ * Private function closing the journal, then unlocking the robust mutex.
+ *
+ * The operation is finished, so a process dying after taking the mutex but before journaling its own operation must not
+ * have this one replayed.
+*/
+static void unlock_queue(SharedBlockingQueue* this, char *error_mesg) {
+    this->header->pending_op = SHARED_BLOCKING_QUEUE_OP_NONE;
+    if (pthread_mutex_unlock(&this->header->mutex)) { cleanup_exit(this, error_mesg);}
+}
+
+/**
+ * Private function allocating a process-local handle for a mapping of the shared object called name.
+*/
+static SharedBlockingQueue* new_handle(const char* name, void* mapping, size_t mapping_size) {
+
+    /** Allocate memory for the handle and a copy of the name.*/
+    SharedBlockingQueue *this = malloc(sizeof(SharedBlockingQueue));
+    char *name_copy = malloc(strlen(name) + ONE);
+    if (this == NULL || name_copy == NULL) {
+        perror("Error: Failed to allocate memory for SharedBlockingQueue");
+        free(this);
+        free(name_copy);
+        return NULL;
+    }
+    strcpy(name_copy, name);
+
+    this->header = mapping;
+    this->mapping_size = mapping_size;
+    this->name = name_copy;
+    return this;
+}
+
+SharedBlockingQueue* new_SharedBlockingQueue(const char* name, int max_size, size_t record_size) {
+
+    /** Checks that the given max_size and record_size are valid.*/
+    if (name == NULL || max_size <= ZERO || record_size == ZERO) {
+        return NULL;
+    }
+
+    /** The slot array starts at the first offset past the header aligned for any record type.*/
+    size_t slots_offset = (sizeof(SharedBlockingQueueHeader) + _Alignof(max_align_t) - ONE) & ~(_Alignof(max_align_t) - ONE);
+    size_t mapping_size = slots_offset + (size_t)max_size * record_size;
+
+    /** Creates the shared memory object, failing if it already exists.*/
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < ZERO) {
+        perror("Error: shm_open() failed while creating SharedBlockingQueue");
+        return NULL;
+    }
+
+    /** Sizes and maps the object, the descriptor is no longer needed once mapped.*/
+    void *mapping = MAP_FAILED;
+    if (ftruncate(fd, (off_t)mapping_size) == ZERO) {
+        mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, ZERO);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("Error: Failed to size or map SharedBlockingQueue");
+        shm_unlink(name);
+        return NULL;
+    }
+
+    SharedBlockingQueue *this = new_handle(name, mapping, mapping_size);
+    if (this == NULL) {
+        munmap(mapping, mapping_size);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    /** Initializes the position independent bookkeeping, mirroring new_Queue.*/
+    SharedBlockingQueueHeader *header = this->header;
+    header->max_size = max_size;
+    header->front = header->current_size = ZERO;
+    header->rear = max_size - ONE;
+    header->record_size = record_size;
+    header->slots_offset = slots_offset;
+    header->mapping_size = mapping_size;
+
+    header->pending_op = SHARED_BLOCKING_QUEUE_OP_NONE;
+    header->pending_copied = false;
+    header->recoveries = ZERO;
+
+    /** Initializes the mutex so that it can be shared by threads of different processes and survive the death of its owner.*/
+    pthread_mutexattr_t attributes;
+    if (pthread_mutexattr_init(&attributes)
+            || pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED)
+            || pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST)
+            || pthread_mutex_init(&header->mutex, &attributes)) {
+        creation_cleanup_exit(this, "Error: failed to initialize process-shared mutex.");
+    }
+    pthread_mutexattr_destroy(&attributes);
+
+    /** Initializes both semaphores with a non-zero pshared argument so they can be used by other processes.*/
+    if (sem_init(&header->full_slots, ONE, ZERO)) { creation_cleanup_exit(this, "Error: Failed to initialize full_slots semaphore");}
+    if (sem_init(&header->empty_slots, ONE, max_size)) { creation_cleanup_exit(this, "Error: Failed to initialize empty_slots semaphore");}
+
+    /** Publishes the region to other processes only once it is fully initialized.*/
+    __atomic_store_n(&header->magic, SHARED_BLOCKING_QUEUE_MAGIC, __ATOMIC_RELEASE);
+
+    return this;
+}
+
+SharedBlockingQueue* SharedBlockingQueue_open(const char* name) {
+
+    if (name == NULL) {
+        return NULL;
+    }
+
+    /** Opens the existing shared memory object.*/
+    int fd = shm_open(name, O_RDWR, ZERO);
+    if (fd < ZERO) {
+        perror("Error: shm_open() failed while opening SharedBlockingQueue");
+        return NULL;
+    }
+
+    /** The size of the object gives the size of the mapping.*/
+    struct stat status;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &status) == ZERO && (size_t)status.st_size >= sizeof(SharedBlockingQueueHeader)) {
+        mapping = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, ZERO);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("Error: Failed to map SharedBlockingQueue");
+        return NULL;
+    }
+
+    /** Refuses to attach to a region whose creator has not finished initializing it.*/
+    SharedBlockingQueueHeader *header = mapping;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHARED_BLOCKING_QUEUE_MAGIC
+            || header->mapping_size != (size_t)status.st_size) {
+        munmap(mapping, (size_t)status.st_size);
+        return NULL;
+    }
+
+    SharedBlockingQueue *this = new_handle(name, mapping, (size_t)status.st_size);
+    if (this == NULL) {
+        munmap(mapping, (size_t)status.st_size);
+    }
+    return this;
+}
+
+bool SharedBlockingQueue_enq(SharedBlockingQueue* this, const void* record) {
+
+    /** Check that the record is not NULL.*/
+    if (record == NULL) {
+        return false;
+    }
+    SharedBlockingQueueHeader *header = this->header;
+
+    /** Waits until there is at least one empty slot in the queue.*/
+    if (sem_wait(&header->empty_slots)) { cleanup_exit(this, "Error: sem_wait() failed for empty_slots semaphore");}
+
+    /** Locks the mutex to ensure mutual exclusion between processes.*/
+    lock_queue(this, SHARED_BLOCKING_QUEUE_OP_ENQ, "Error: pthread_mutex_lock() failed before enqueueing");
+
+    /** Copy the record into the slot after the rear, wrapping around if necessary, and mark it as copied in the journal.*/
+    int rear = (header->rear + ONE) % header->max_size;
+    memcpy(slot_at(this, rear), record, header->record_size);
+    header->pending_copied = true;
+
+    /** Commit the new rear and size.*/
+    header->rear = rear;
+    header->current_size = header->current_size + ONE;
+
+    /** Unlocks the mutex.*/
+    unlock_queue(this, "Error: pthread_mutex_unlock() failed after enqueueing");
+
+    /** Signals that there is one more full slot in the queue.*/
+    if (sem_post(&header->full_slots)) { cleanup_exit(this, "Error: sem_post() failed for full_slots semaphore");}
+
+    return true;
+}
+
+bool SharedBlockingQueue_deq(SharedBlockingQueue* this, void* record) {
+
+    /** Check that the destination is not NULL.*/
+    if (record == NULL) {
+        return false;
+    }
+    SharedBlockingQueueHeader *header = this->header;
+
+    /** Waits until there is at least one full slot in the queue.*/
+    if (sem_wait(&header->full_slots)) { cleanup_exit(this, "Error: sem_wait() failed for full_slots semaphore");}
+
+    /** Locks the mutex to ensure mutual exclusion between processes.*/
+    lock_queue(this, SHARED_BLOCKING_QUEUE_OP_DEQ, "Error: pthread_mutex_lock() failed before dequeueing");
+
+    /** Copy the front record out of its slot, then move the front forward and wrap around if necessary.*/
+    memcpy(record, slot_at(this, header->front), header->record_size);
+    header->front = (header->front + ONE) % header->max_size;
+    header->current_size = header->current_size - ONE;
+
+    /** Unlocks the mutex.*/
+    unlock_queue(this, "Error: pthread_mutex_unlock() failed after dequeuing");
+
+    /** Signals that there is one more empty slot in the queue.*/
+    if (sem_post(&header->empty_slots)) { cleanup_exit(this, "Error: sem_post() failed for empty_slots semaphore");}
+
+    return true;
+}
+
+int SharedBlockingQueue_size(SharedBlockingQueue* this) {
+    /** Locks the mutex, reads the current size and unlocks the mutex.*/
+    lock_queue(this, SHARED_BLOCKING_QUEUE_OP_NONE, "Error: pthread_mutex_lock() failed before getting the current size");
+    int size = this->header->current_size;
+    unlock_queue(this, "Error: pthread_mutex_unlock() failed after getting the current size");
+    return size;
+}
+
+bool SharedBlockingQueue_isEmpty(SharedBlockingQueue* this) {
+    /** Return true if the current size is 0, indicating the queue is empty.*/
+    return SharedBlockingQueue_size(this) == ZERO;
+}
+
+int SharedBlockingQueue_recoveries(SharedBlockingQueue* this) {
+    /** Locks the mutex, reads the number of recoveries and unlocks the mutex.*/
+    lock_queue(this, SHARED_BLOCKING_QUEUE_OP_NONE, "Error: pthread_mutex_lock() failed before getting the number of recoveries");
+    int recoveries = this->header->recoveries;
+    unlock_queue(this, "Error: pthread_mutex_unlock() failed after getting the number of recoveries");
+    return recoveries;
+}
+
+void SharedBlockingQueue_close(SharedBlockingQueue* this) {
+    /** Unmaps the region from this process and frees the handle.*/
+    munmap(this->header, this->mapping_size);
+    free(this->name);
+    free(this);
+}
+
+void SharedBlockingQueue_destroy(SharedBlockingQueue* this) {
+    /** Destroys the process-shared primitives.*/
+    pthread_mutex_destroy(&this->header->mutex);
+    sem_destroy(&this->header->full_slots);
+    sem_destroy(&this->header->empty_slots);
+
+    /** Removes the shared memory object, the region is freed once every process has unmapped it.*/
+    shm_unlink(this->name);
+
+    /** Detaches this process.*/
+    SharedBlockingQueue_close(this);
+}
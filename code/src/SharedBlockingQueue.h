@@ -0,0 +1,150 @@
+/*
+ * SharedBlockingQueue.h
+ *
+ * Module interface for a fixed-size Blocking Queue of fixed-size records placed in POSIX shared memory,
+ * allowing separate processes to exchange records without copying them through the kernel.
+ *
+ */
+
+#ifndef SHARED_BLOCKING_QUEUE_H_
+#define SHARED_BLOCKING_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "Queue.h"
+
+/** Value stored in the header once the creating process has finished initializing the shared region.*/
+#define SHARED_BLOCKING_QUEUE_MAGIC 0x53425121u
+
+/** Operations recorded in the header by the owner of the mutex, used to repair the queue if the owner dies.*/
+#define SHARED_BLOCKING_QUEUE_OP_NONE 0
+#define SHARED_BLOCKING_QUEUE_OP_ENQ 1
+#define SHARED_BLOCKING_QUEUE_OP_DEQ 2
+
+typedef struct SharedBlockingQueueHeader SharedBlockingQueueHeader;
+typedef struct SharedBlockingQueue SharedBlockingQueue;
+
+/*
+ * Header placed at the start of the shared memory region.
+ *
+ * Every field is position independent: the slot array is located through an offset from the start of the header
+ * instead of a pointer, so each process may map the region at a different address.
+ */
+struct SharedBlockingQueueHeader {
+
+    /** Set to SHARED_BLOCKING_QUEUE_MAGIC once the region is ready to be used by other processes.*/
+    unsigned int magic;
+
+    /**
+     * Process-shared robust mutex ensuring mutual exclusion between the threads of every attached process.
+     * If its owner dies, the next locker receives EOWNERDEAD and repairs the queue from the journal below.
+    */
+    pthread_mutex_t mutex;
+
+    /** Process-shared semaphore counting the number of occupied slots. Initialized to zero.*/
+    sem_t full_slots;
+
+    /** Process-shared semaphore counting the number of free slots. Initialized to the maximum capacity.*/
+    sem_t empty_slots;
+
+    /** Index of the front record, index of the rear record, number of records and maximum capacity.*/
+    int front, rear, current_size, max_size;
+
+    /** Size in bytes of a single record.*/
+    size_t record_size;
+
+    /** Offset in bytes from the start of the header to the first slot of the array of records.*/
+    size_t slots_offset;
+
+    /** Total size in bytes of the shared memory region.*/
+    size_t mapping_size;
+
+    /**
+     * Operation (SHARED_BLOCKING_QUEUE_OP_*) performed by the current owner of the mutex, SHARED_BLOCKING_QUEUE_OP_NONE while
+     * the mutex is free and until its owner journals an operation.
+    */
+    int pending_op;
+
+    /** Set by an enqueueing owner once its record has been completely copied into the rear slot.*/
+    bool pending_copied;
+
+    /** Values of front, rear and current_size when the current owner acquired the mutex.*/
+    int saved_front, saved_rear, saved_size;
+
+    /** Number of times the queue was repaired after the death of the mutex owner.*/
+    int recoveries;
+};
+
+/*
+ * Process-local handle onto a shared queue.
+ */
+struct SharedBlockingQueue {
+
+    /** Start of this process' mapping of the shared region.*/
+    SharedBlockingQueueHeader *header;
+
+    /** Size in bytes of this process' mapping.*/
+    size_t mapping_size;
+
+    /** Name of the POSIX shared memory object (copied).*/
+    char *name;
+};
+
+/*
+ * Creates a new shared memory object called name (which must start with '/') holding a queue of at most max_size records
+ * of record_size bytes each, and maps it into the calling process.
+ * Fails if an object with the same name already exists.
+ * Returns a pointer to a new SharedBlockingQueue on success and NULL on failure.
+ */
+SharedBlockingQueue* new_SharedBlockingQueue(const char* name, int max_size, size_t record_size);
+
+/*
+ * Attaches the calling process to the queue previously created under name by new_SharedBlockingQueue.
+ * Returns a pointer to a new SharedBlockingQueue handle on success and NULL on failure.
+ */
+SharedBlockingQueue* SharedBlockingQueue_open(const char* name);
+
+/*
+ * Copies the record_size bytes pointed to by record into the slot at the back of this Queue.
+ * If the queue is full, the function will block the calling thread until there is space in the queue.
+ * Returns false when record is NULL and true on success.
+ */
+bool SharedBlockingQueue_enq(SharedBlockingQueue* this, const void* record);
+
+/*
+ * Copies the record at the front of this Queue into the record_size bytes pointed to by record and removes it.
+ * If the queue is empty, the function will block until a record can be dequeued.
+ * Returns false when record is NULL and true on success.
+ */
+bool SharedBlockingQueue_deq(SharedBlockingQueue* this, void* record);
+
+/*
+ * Returns the number of records currently in this Queue.
+ */
+int SharedBlockingQueue_size(SharedBlockingQueue* this);
+
+/*
+ * Returns true if this Queue is empty, false otherwise.
+ */
+bool SharedBlockingQueue_isEmpty(SharedBlockingQueue* this);
+
+/*
+ * Returns the number of times this Queue was repaired after a process died while holding its mutex.
+ */
+int SharedBlockingQueue_recoveries(SharedBlockingQueue* this);
+
+/*
+ * Detaches the calling process from this Queue without destroying the shared region.
+ */
+void SharedBlockingQueue_close(SharedBlockingQueue* this);
+
+/*
+ * Destroys the synchronization primitives of this Queue, detaches the calling process and removes the shared memory object.
+ * Must only be called once every other process has closed its handle.
+ */
+void SharedBlockingQueue_destroy(SharedBlockingQueue* this);
+
+#endif /* SHARED_BLOCKING_QUEUE_H_ */
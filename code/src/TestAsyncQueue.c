@@ -0,0 +1,247 @@
+/*
+ * TestAsyncQueue.c
+ *
+ * Very simple unit test file for AsyncQueue and AsyncExecutor functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "AsyncQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_QUEUE_SIZE 4
+
+/** Number of logical consumers waiting at once in the many consumers test.*/
+#define MANY_CONSUMERS 5000
+
+/*
+ * The queue and the executor to use during tests
+ */
+static AsyncQueue *queue;
+static AsyncExecutor *executor;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_AsyncQueue(DEFAULT_MAX_QUEUE_SIZE);
+    executor = new_AsyncExecutor();
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    AsyncQueue_destroy(queue);
+    AsyncExecutor_destroy(executor);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Callback storing the element it is resumed with in the void* pointed to by ctx.
+*/
+void storeElement(void* element, void* ctx) {
+    *(void**)ctx = element;
+}
+
+/**
+ * Callback adding the integer it is resumed with to the intptr_t pointed to by ctx.
+*/
+void addElement(void* element, void* ctx) {
+    *(intptr_t*)ctx += (intptr_t)element;
+}
+
+
+/*
+ * Checks that the constructors return non-NULL pointers.
+ */
+int newQueueIsNotNull() {
+    assert(queue != NULL);
+    assert(executor != NULL);
+    assert(AsyncQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that invalid queues and operations are refused.
+*/
+int invalidArgumentsAreRefused() {
+    int a = 1;
+    assert(new_AsyncQueue(ZERO) == NULL);
+    assert(new_AsyncQueue(-1) == NULL);
+    assert(AsyncQueue_enqAsync(queue, NULL, executor, NULL, NULL) == false);
+    assert(AsyncQueue_enqAsync(queue, &a, NULL, NULL, NULL) == false);
+    assert(AsyncQueue_deqAsync(queue, executor, NULL, NULL) == false);
+    assert(AsyncQueue_deqAsync(queue, NULL, storeElement, NULL) == false);
+    assert(AsyncQueue_tryEnq(queue, NULL) == false);
+    assert(AsyncExecutor_post(executor, NULL, NULL, NULL) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a deq on a non-empty queue completes at once, but that its callback only runs inside the executor.
+*/
+int callbacksRunInsideTheExecutor() {
+    int a = 1;
+    void *result = NULL;
+    assert(AsyncQueue_tryEnq(queue, &a) == true);
+    assert(AsyncQueue_deqAsync(queue, executor, storeElement, &result) == true);
+    assert(AsyncQueue_size(queue) == ZERO);
+    assert(result == NULL);
+    assert(AsyncExecutor_poll(executor) == ONE);
+    assert(result == &a);
+    assert(AsyncExecutor_poll(executor) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a deq on an empty queue waits, and is resumed with the element of the next enq.
+*/
+int deqAsyncWaitsForEnq() {
+    int a = 1;
+    void *result = NULL, *enqueued = NULL;
+    assert(AsyncQueue_deqAsync(queue, executor, storeElement, &result) == true);
+    assert(AsyncQueue_waitingDeqs(queue) == ONE);
+    assert(AsyncExecutor_poll(executor) == ZERO);
+
+    assert(AsyncQueue_enqAsync(queue, &a, executor, storeElement, &enqueued) == true);
+    assert(AsyncQueue_waitingDeqs(queue) == ZERO);
+    assert(AsyncExecutor_poll(executor) == TWO);
+    assert(result == &a);
+    assert(enqueued == &a);
+
+    /** The element was handed over, it never went through the queue.*/
+    assert(AsyncQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that an enq on a full queue waits, and moves into the slot freed by the next deq.
+*/
+int enqAsyncWaitsForSpace() {
+    int elements[] = {1, 2, 3, 4, 5};
+    void *enqueued = NULL;
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(AsyncQueue_tryEnq(queue, &elements[i]) == true);
+    }
+    assert(AsyncQueue_tryEnq(queue, &elements[FOUR]) == false);
+    assert(AsyncQueue_enqAsync(queue, &elements[FOUR], executor, storeElement, &enqueued) == true);
+    assert(AsyncExecutor_poll(executor) == ZERO);
+    assert(enqueued == NULL);
+
+    assert(AsyncQueue_tryDeq(queue) == &elements[ZERO]);
+    assert(AsyncExecutor_poll(executor) == ONE);
+    assert(enqueued == &elements[FOUR]);
+    for (int i = ONE; i <= FOUR; i++) {
+        assert(AsyncQueue_tryDeq(queue) == &elements[i]);
+    }
+    assert(AsyncQueue_tryDeq(queue) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that thousands of logical consumers wait on one queue and are each resumed once, in order, on a single thread.
+*/
+int manyConsumersOnOneThread() {
+    intptr_t total = ZERO;
+    for (int i = ZERO; i < MANY_CONSUMERS; i++) {
+        assert(AsyncQueue_deqAsync(queue, executor, addElement, &total) == true);
+    }
+    assert(AsyncQueue_waitingDeqs(queue) == MANY_CONSUMERS);
+
+    /** Producers without callbacks, the consumers are resumed as the elements are handed over.*/
+    for (intptr_t i = ONE; i <= MANY_CONSUMERS; i++) {
+        assert(AsyncQueue_enqAsync(queue, (void*)i, executor, NULL, NULL) == true);
+    }
+    assert(AsyncExecutor_poll(executor) == MANY_CONSUMERS);
+    assert(total == (intptr_t)MANY_CONSUMERS * (MANY_CONSUMERS + ONE) / TWO);
+    assert(AsyncQueue_waitingDeqs(queue) == ZERO);
+    assert(AsyncQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Callback stopping the executor passed as ctx.
+*/
+void stopExecutor(void* element, void* ctx) {
+    (void)element;
+    AsyncExecutor_stop((AsyncExecutor*)ctx);
+}
+
+/**
+ * Thread running the executor until it is stopped.
+*/
+void* executorThread(void* unused) {
+    (void)unused;
+    AsyncExecutor_run(executor);
+    pthread_exit(NULL);
+}
+
+/**
+ * Checks that an executor running on its own thread resumes operations completed on another thread, and stops when asked.
+*/
+int executorRunsOnAnotherThread() {
+    int a = 1;
+    void *result = NULL;
+    pthread_t runningThread;
+    pthread_create(&runningThread, NULL, executorThread, NULL);
+
+    assert(AsyncQueue_deqAsync(queue, executor, storeElement, &result) == true);
+    assert(AsyncQueue_tryEnq(queue, &a) == true);
+    assert(AsyncExecutor_post(executor, stopExecutor, NULL, executor) == true);
+    pthread_join(runningThread, NULL);
+
+    /** The deq was posted before the stop, so it ran before run returned.*/
+    assert(result == &a);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the AsyncQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(invalidArgumentsAreRefused);
+
+    runTest(callbacksRunInsideTheExecutor);
+
+    runTest(deqAsyncWaitsForEnq);
+
+    runTest(enqAsyncWaitsForSpace);
+
+    runTest(manyConsumersOnOneThread);
+
+    runTest(executorRunsOnAnotherThread);
+
+    printf("\nAsyncQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
@@ -9,6 +9,13 @@
 #include <stddef.h>
 #include <unistd.h>
 #include <string.h>
+#include <sched.h>
+#include <time.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
+#include <stdlib.h>
 
 #include "BlockingQueue.h"
 #include "myassert.h"
@@ -373,11 +380,60 @@ int enqAndDeqString() {
     return TEST_SUCCESS;
 }
 
+/**
+ * Waits until at least count threads of this process, other than the calling one, are asleep, which is how a thread blocked
+ * on the queue looks from /proc. Gives up after about two seconds, the test then runs with whatever ordering it got.
+ * /proc is Linux only, elsewhere the function gives the threads a second to block.
+*/
+static void waitForBlockedThreads(int count) {
+#ifndef __linux__
+    (void)count;
+    sleep(1);
+#else
+    char self[32];
+    snprintf(self, sizeof(self), "%ld", (long)syscall(SYS_gettid));
+    for (int attempt = ZERO; attempt < 2000; attempt++) {
+        int blocked = ZERO;
+        DIR *tasks = opendir("/proc/self/task");
+        if (tasks == NULL) {
+            /** Without /proc, falls back to giving the threads time to block.*/
+            sleep(1);
+            return;
+        }
+        struct dirent *task;
+        while ((task = readdir(tasks)) != NULL) {
+            if (task->d_name[ZERO] == '.' || !strcmp(task->d_name, self)) {
+                continue;
+            }
+            char path[300], stat[256];
+            snprintf(path, sizeof(path), "/proc/self/task/%s/stat", task->d_name);
+            FILE *file = fopen(path, "r");
+            if (file == NULL) {
+                continue;
+            }
+            size_t length = fread(stat, ONE, sizeof(stat) - ONE, file);
+            fclose(file);
+            stat[length] = '\0';
+            char *end = strrchr(stat, ')');
+            if (end != NULL && end[ONE] == ' ' && end[TWO] == 'S') {
+                blocked++;
+            }
+        }
+        closedir(tasks);
+        if (blocked >= count) {
+            return;
+        }
+        struct timespec pause = {0, 1000000};
+        nanosleep(&pause, NULL);
+    }
+#endif
+}
+
 /**
  * Checks that Dequeueing is thread safe.
  * 
  * This test changes the thread scheduling order: the first thread created tries to dequeue an element while the second tries to enqueue an element.
- * The program sleeps between the creation of the two threads to ensure that the first one is blocked and waiting for an element to be added to the BlockingQueue.
+ * The program waits between the creation of the two threads until the first one is blocked and waiting for an element to be added to the BlockingQueue.
 */
 int deqFirstThenEnqOneElement() {
     /** Initializes and defines an integer element to be enqueued and dequeued in/from the BlockingQueue.*/
@@ -398,8 +454,8 @@ int deqFirstThenEnqOneElement() {
     /** Create a thread to dequeue an element off the empty BlockingQueue.*/
     pthread_create(&tid1, NULL, dequeueThread, queue);
 
-    /** Make the program sleep for 1 second, the Dequeueing thread should be blocked and waiting for an element to be enqueued.*/
-    sleep(1);
+    /** Waits until the Dequeueing thread is blocked and waiting for an element to be enqueued.*/
+    waitForBlockedThreads(ONE);
 
     /** Create a thread to enqueue an element in the BlockingQueue.*/
     pthread_create(&tid2, NULL, enqueueThread, pointer_a);
@@ -465,8 +521,8 @@ int enqThreadWhenFull() {
     /** Create a thread to enqueue an element in the BlockingQueue.*/
     pthread_create(&tid1, NULL, enqueueThread, pointer_b);
 
-    /** Make the program sleep for 1 second, the Enqueueing thread should be blocked and waiting for an element to be dequeued.*/
-    sleep(1);
+    /** Waits until the Enqueueing thread is blocked and waiting for an element to be dequeued.*/
+    waitForBlockedThreads(ONE);
 
     /** Create a thread to dequeue an element off the empty BlockingQueue.*/
     pthread_create(&tid2, NULL, dequeueThread, queue);
@@ -521,8 +577,8 @@ int manyEnqThreads() {
 /**
  * Checks that enqueue threads will not wait and are able to enqueue after the queue is cleared.
  * 
- * This test ensures that the empty_slots semaphore indicating how many free spaces available for enqueuing elements are in the queue is
- * initialized to the max_size of the queue after calling BlockingQueue_clear().
+ * This test ensures that the number of free spaces available for enqueuing elements in the queue is
+ * reset to the max_size of the queue after calling BlockingQueue_clear().
 */
 int enqThreadsAfterClear() {
     /** Enqueue 20 elements to the BlockingQueue.*/
@@ -582,8 +638,8 @@ int enqThreadsAfterClear() {
 /**
  * Checks that addtional enqueue threads will wait and are able to enqueue once the queue is cleared.
  * 
- * This test ensures that the empty_slots semaphore indicating how many free spaces available for enqueuing elements are in the queue is
- * initialized to the max_size of the queue after calling BlockingQueue_clear().
+ * This test ensures that the number of free spaces available for enqueuing elements in the queue is
+ * reset to the max_size of the queue after calling BlockingQueue_clear().
 */
 int enqThreadsWaitBeforeClear() {
 
@@ -652,8 +708,8 @@ int enqThreadsWaitBeforeClear() {
     pthread_create(&tid2, NULL, enqueueThread, pointer_b);
 
 
-    /** Make the program sleep for 1 second, the two Enqueueing threads should be blocked and waiting for elements to be dequeued or the queue to be cleared.*/
-    sleep(1);
+    /** Waits until the two Enqueueing threads are blocked and waiting for elements to be dequeued or the queue to be cleared.*/
+    waitForBlockedThreads(TWO);
 
     /** Clears the blocking queue which should allow the two waiting threads to enqueue elements.*/
     BlockingQueue_clear(queue);
@@ -988,6 +1044,527 @@ int test_BlockingQueue_clear_threadSafety() {
     return TEST_SUCCESS;
 }
 
+/*
+ * Struct embedding a BlockingQueue and the storage of its slots, as a caller would.
+ */
+typedef struct EmbeddingStruct {
+    BlockingQueue inline_queue;
+    void *storage[FOUR];
+} EmbeddingStruct;
+
+/**
+ * Thread to dequeue FOUR elements from the given BlockingQueue and return their sum.
+*/
+void* sum_deq_thread(void* blocking_queue) {
+    __intptr_t sum = ZERO;
+    for (int i = ZERO; i < FOUR; i++) {
+        sum += (__intptr_t)BlockingQueue_deq((BlockingQueue*)blocking_queue);
+    }
+    pthread_exit((void*)sum);
+}
+
+/**
+ * Checks that a BlockingQueue initialized inside a caller's struct blocks and wakes threads like an allocated one.
+*/
+int initOnCallerStorage() {
+    EmbeddingStruct embedding;
+    assert(BlockingQueue_storageSize(FOUR) == sizeof(embedding.storage));
+    assert(BlockingQueue_init(&embedding.inline_queue, FOUR, embedding.storage) == true);
+
+    /** The dequeuing thread waits for elements enqueued by this thread.*/
+    pthread_t dequeuingThread;
+    void *sum;
+    pthread_create(&dequeuingThread, NULL, sum_deq_thread, &embedding.inline_queue);
+    for (int i = ONE; i <= FOUR; i++) {
+        assert(BlockingQueue_enq(&embedding.inline_queue, (void*)(__intptr_t)i) == true);
+    }
+    pthread_join(dequeuingThread, &sum);
+
+    assert((__intptr_t)sum == 10);
+    assert(BlockingQueue_isEmpty(&embedding.inline_queue) == true);
+    BlockingQueue_deinit(&embedding.inline_queue);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that BlockingQueue_init refuses missing memory and invalid sizes.
+*/
+int initRejectsInvalidArguments() {
+    BlockingQueue inline_queue;
+    void *storage[ONE];
+    assert(BlockingQueue_storageSize(ZERO) == ZERO);
+    assert(BlockingQueue_init(&inline_queue, ZERO, storage) == false);
+    assert(BlockingQueue_init(&inline_queue, ONE, NULL) == false);
+    assert(BlockingQueue_init(NULL, ONE, storage) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that an element enqueued while a consumer waits on the empty queue is handed to it directly.
+*/
+int enqHandsOffToWaitingConsumer() {
+    int a = 1;
+    pthread_t dequeuingThread;
+    void *dequeuingThreadResult;
+
+    /** Waits until the dequeuing thread has registered as waiting for a hand-off.*/
+    pthread_create(&dequeuingThread, NULL, dequeueThread, queue);
+    while (atomic_load(&queue->waiting) == ZERO) {
+        sched_yield();
+    }
+
+    assert(BlockingQueue_enq(queue, &a) == true);
+    pthread_join(dequeuingThread, &dequeuingThreadResult);
+
+    /** The element never went through the queue.*/
+    assert(dequeuingThreadResult == &a);
+    assert(BlockingQueue_handoffs(queue) == ONE);
+    assert(BlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that deqBatch takes every element already in the queue, oldest first, up to max_count.
+*/
+int deqBatchTakesAvailableElements() {
+    int elements[] = {1, 2, 3};
+    void *batch[FOUR];
+    for (int i = ZERO; i < THREE; i++) {
+        assert(BlockingQueue_enq(queue, &elements[i]) == true);
+    }
+
+    assert(BlockingQueue_deqBatch(queue, batch, TWO) == TWO);
+    assert(batch[ZERO] == &elements[ZERO] && batch[ONE] == &elements[ONE]);
+    assert(BlockingQueue_deqBatch(queue, batch, FOUR) == ONE);
+    assert(batch[ZERO] == &elements[TWO]);
+    assert(BlockingQueue_isEmpty(queue) == true);
+    assert(BlockingQueue_deqBatch(queue, NULL, FOUR) == ZERO);
+    assert(BlockingQueue_deqBatch(queue, batch, ZERO) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Returns the milliseconds elapsed on the monotonic clock since start.
+*/
+static long elapsed_ms(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/**
+ * Checks that a rate limit spaces the dequeues out, whether they come one by one or in a batch.
+*/
+int rateLimitSpacesDeqs() {
+    int a = 1;
+    void *batch[FOUR];
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(BlockingQueue_enq(queue, &a) == true);
+    }
+
+    /** 100 tokens per second with a burst of 1: after the first token, each one comes 10 milliseconds later.*/
+    assert(BlockingQueue_setRateLimit(queue, 100, ONE) == true);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = ZERO; i < FOUR; i++) {
+        assert(BlockingQueue_deq(queue) == &a);
+    }
+    assert(elapsed_ms(&start) >= 30);
+    assert(BlockingQueue_deqBatch(queue, batch, FOUR) == FOUR);
+    assert(elapsed_ms(&start) >= 70);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a full bucket lets a burst through at once, and that removing the limit stops the sleeping.
+*/
+int rateLimitAllowsBursts() {
+    int a = 1;
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(BlockingQueue_enq(queue, &a) == true);
+    }
+
+    /** One token per second, but a bucket of four.*/
+    assert(BlockingQueue_setRateLimit(queue, ONE, FOUR) == true);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = ZERO; i < FOUR; i++) {
+        assert(BlockingQueue_deq(queue) == &a);
+    }
+    assert(BlockingQueue_setRateLimit(queue, ZERO, ONE) == true);
+    for (int i = ZERO; i < FOUR; i++) {
+        assert(BlockingQueue_deq(queue) == &a);
+    }
+    assert(elapsed_ms(&start) < 500);
+
+    assert(BlockingQueue_setRateLimit(queue, -1, ONE) == false);
+    assert(BlockingQueue_setRateLimit(queue, ONE, ZERO) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that consumers on different threads share the same bucket.
+*/
+int rateLimitSharedByConsumers() {
+    pthread_t consumers[TWO];
+    assert(BlockingQueue_setRateLimit(queue, 200, ONE) == true);
+    for (__intptr_t i = ONE; i <= 2 * FOUR; i++) {
+        assert(BlockingQueue_enq(queue, (void*)i) == true);
+    }
+
+    /** 8 tokens at 5 milliseconds apart, the first one from the full bucket.*/
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    __intptr_t total = ZERO;
+    for (int i = ZERO; i < TWO; i++) {
+        pthread_create(&consumers[i], NULL, sum_deq_thread, queue);
+    }
+    for (int i = ZERO; i < TWO; i++) {
+        void *sum;
+        pthread_join(consumers[i], &sum);
+        total += (__intptr_t)sum;
+    }
+    assert(total == 36);
+    assert(elapsed_ms(&start) >= 35);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a consumer sleeping for its token leaves the element in the queue, where size counts it, and takes it once its
+ * token is due.
+*/
+int rateLimitedConsumerLeavesElementQueued() {
+    int a = 1, b = 2;
+    assert(BlockingQueue_enq(queue, &a) == true);
+    assert(BlockingQueue_enq(queue, &b) == true);
+
+    /** Four tokens per second with a burst of 1: the first deq is immediate, the second sleeps for 250 milliseconds.*/
+    assert(BlockingQueue_setRateLimit(queue, FOUR, ONE) == true);
+    assert(BlockingQueue_deq(queue) == &a);
+    pthread_t dequeuingThread;
+    void *result;
+    pthread_create(&dequeuingThread, NULL, dequeueThread, queue);
+    waitForBlockedThreads(ONE);
+    assert(BlockingQueue_size(queue) == ONE);
+    pthread_join(dequeuingThread, &result);
+    assert(result == &b);
+    assert(BlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread function dequeuing a batch of at most four elements, returning how many it took.
+*/
+void* deqBatchThread(void* blocking_queue) {
+    void *batch[FOUR];
+    return (void*)(__intptr_t)BlockingQueue_deqBatch(blocking_queue, batch, FOUR);
+}
+
+/**
+ * Checks that deqBatch takes no more elements than it acquired tokens for, and returns the tokens of the queued elements which
+ * were gone by the time it took them.
+*/
+int deqBatchReturnsUnusedTokens() {
+    int a = 1;
+    assert(BlockingQueue_enq(queue, &a) == true);
+    assert(BlockingQueue_enq(queue, &a) == true);
+
+    /** Five tokens per second with a burst of 1: the batch acquires two tokens and sleeps 200 milliseconds for the second one.*/
+    assert(BlockingQueue_setRateLimit(queue, 5, ONE) == true);
+    pthread_t batchThread;
+    void *count;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&batchThread, NULL, deqBatchThread, queue);
+    waitForBlockedThreads(ONE);
+
+    /** Only one element is left when the batch wakes up, so it takes one and returns the other token.*/
+    BlockingQueue_clear(queue);
+    assert(BlockingQueue_enq(queue, &a) == true);
+    pthread_join(batchThread, &count);
+    assert((__intptr_t)count == ONE);
+    assert(BlockingQueue_isEmpty(queue) == true);
+
+    /** With the token returned, the next one is due at once instead of 400 milliseconds after the start.*/
+    assert(BlockingQueue_enq(queue, &a) == true);
+    assert(BlockingQueue_deq(queue) == &a);
+    assert(elapsed_ms(&start) < 300);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that size and isEmpty answer while another thread holds the queue's mutex, since they never take it.
+*/
+int sizeDoesNotTakeTheMutex() {
+    int a = 1;
+    assert(BlockingQueue_enq(queue, &a) == true);
+    assert(BlockingQueue_enq(queue, &a) == true);
+
+    pthread_mutex_lock(&queue->mutex);
+    int size = BlockingQueue_size(queue);
+    bool empty = BlockingQueue_isEmpty(queue);
+    pthread_mutex_unlock(&queue->mutex);
+
+    assert(size == TWO);
+    assert(empty == false);
+    assert(BlockingQueue_deq(queue) == &a);
+    assert(BlockingQueue_size(queue) == ONE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that an element is handed to a waiting consumer without taking the queue's mutex, here held by the test.
+*/
+int handOffDoesNotTakeTheMutex() {
+    int a = 1;
+    pthread_t dequeuingThread;
+    void *dequeuingThreadResult;
+    pthread_create(&dequeuingThread, NULL, dequeueThread, queue);
+    while (atomic_load(&queue->waiting) == ZERO) {
+        sched_yield();
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    bool handed = BlockingQueue_enq(queue, &a);
+    pthread_mutex_unlock(&queue->mutex);
+    pthread_join(dequeuingThread, &dequeuingThreadResult);
+
+    assert(handed == true);
+    assert(dequeuingThreadResult == &a);
+    assert(BlockingQueue_handoffs(queue) == ONE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that clearing the queue while a consumer is blocked on it leaves the consumer waiting for the next element.
+*/
+int clearKeepsBlockedConsumersWaiting() {
+    int a = 1;
+    pthread_t dequeuingThread;
+    void *dequeuingThreadResult;
+    pthread_create(&dequeuingThread, NULL, dequeueThread, queue);
+    while (atomic_load(&queue->waiting) == ZERO) {
+        sched_yield();
+    }
+
+    BlockingQueue_clear(queue);
+    assert(atomic_load(&queue->waiting) == ONE);
+    assert(BlockingQueue_enq(queue, &a) == true);
+    pthread_join(dequeuingThread, &dequeuingThreadResult);
+
+    assert(dequeuingThreadResult == &a);
+    assert(BlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Watermark callback of the tests, recording each crossing in watermark_events: 1 for high, -1 for low.
+*/
+static int watermark_events[8];
+static int watermark_event_count = 0;
+static void recordWatermark(BlockingQueue* crossed, bool high, void* ctx) {
+    (void)ctx;
+    if (crossed == queue && watermark_event_count < 8) {
+        watermark_events[watermark_event_count++] = high ? ONE : -1;
+    }
+}
+
+/**
+ * Checks that the watermark callback is called once per crossing, with hysteresis between the high and low watermarks.
+*/
+int watermarksSignalEachCrossingOnce() {
+    int a = 1;
+    watermark_event_count = ZERO;
+    assert(BlockingQueue_setWatermarks(queue, FOUR, ONE, recordWatermark, NULL) == true);
+    for (int i = ZERO; i < THREE; i++) {
+        BlockingQueue_enq(queue, &a);
+    }
+    assert(watermark_event_count == ZERO);
+
+    /** Rising to the high watermark signals once, rising further does not.*/
+    BlockingQueue_enq(queue, &a);
+    BlockingQueue_enq(queue, &a);
+    assert(watermark_event_count == ONE && watermark_events[ZERO] == ONE);
+    assert(BlockingQueue_isAboveHighWatermark(queue) == true);
+
+    /** Falling between the watermarks and rising again signals nothing.*/
+    for (int i = ZERO; i < THREE; i++) {
+        BlockingQueue_deq(queue);
+    }
+    BlockingQueue_enq(queue, &a);
+    BlockingQueue_deq(queue);
+    assert(watermark_event_count == ONE);
+    assert(BlockingQueue_isAboveHighWatermark(queue) == true);
+
+    /** Falling to the low watermark signals once, and the next rise to the high one signals again.*/
+    BlockingQueue_deq(queue);
+    assert(watermark_event_count == TWO && watermark_events[ONE] == -1);
+    assert(BlockingQueue_isAboveHighWatermark(queue) == false);
+    for (int i = ZERO; i < THREE; i++) {
+        BlockingQueue_enq(queue, &a);
+    }
+    assert(watermark_event_count == THREE && watermark_events[TWO] == ONE);
+
+    /** A clear falls to the low watermark too.*/
+    BlockingQueue_clear(queue);
+    assert(watermark_event_count == FOUR && watermark_events[THREE] == -1);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that each crossing increments the counter of the watermark eventfd.
+*/
+int watermarkEventfdCountsCrossings() {
+    int a = 1;
+    uint64_t count;
+    int fd = BlockingQueue_watermarkFd(queue);
+    assert(fd >= ZERO);
+    assert(BlockingQueue_watermarkFd(queue) == fd);
+    assert(BlockingQueue_setWatermarks(queue, TWO, ZERO, NULL, NULL) == true);
+    assert(read(fd, &count, sizeof(count)) < ZERO);
+
+    BlockingQueue_enq(queue, &a);
+    BlockingQueue_enq(queue, &a);
+    assert(read(fd, &count, sizeof(count)) == sizeof(count) && count == ONE);
+    assert(BlockingQueue_isAboveHighWatermark(queue) == true);
+
+    BlockingQueue_deq(queue);
+    BlockingQueue_deq(queue);
+    BlockingQueue_enq(queue, &a);
+    BlockingQueue_enq(queue, &a);
+    assert(read(fd, &count, sizeof(count)) == sizeof(count) && count == TWO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that watermarks without room for hysteresis within the capacity are refused, and that a high of 0 removes them.
+*/
+int setWatermarksRejectsInvalidArguments() {
+    int a = 1;
+    watermark_event_count = ZERO;
+    assert(BlockingQueue_setWatermarks(queue, TWO, TWO, recordWatermark, NULL) == false);
+    assert(BlockingQueue_setWatermarks(queue, TWO, -1, recordWatermark, NULL) == false);
+    assert(BlockingQueue_setWatermarks(queue, DEFAULT_MAX_QUEUE_SIZE + ONE, ONE, recordWatermark, NULL) == false);
+    assert(BlockingQueue_setWatermarks(queue, ONE, ZERO, recordWatermark, NULL) == true);
+    assert(BlockingQueue_setWatermarks(queue, ZERO, ZERO, recordWatermark, NULL) == true);
+    BlockingQueue_enq(queue, &a);
+    assert(watermark_event_count == ZERO);
+    assert(BlockingQueue_isAboveHighWatermark(queue) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread enqueuing an element of the size passed as argument, the size also standing for the element, and returning the result.
+*/
+void* enqSizedThread(void* bytes) {
+    return (void*)(intptr_t)BlockingQueue_enqSized(queue, bytes, (size_t)(intptr_t)bytes);
+}
+
+/**
+ * Waits until the given number of producers wait for bytes of the budget.
+*/
+static void waitForByteWaiters(int count) {
+    while (true) {
+        int waiting = ZERO;
+        pthread_mutex_lock(&queue->mutex);
+        for (BlockingQueueByteWaiter *waiter = queue->byte_waiters_head; waiter != NULL; waiter = waiter->next) {
+            waiting++;
+        }
+        pthread_mutex_unlock(&queue->mutex);
+        if (waiting == count) {
+            return;
+        }
+        sched_yield();
+    }
+}
+
+/**
+ * Checks that a producer whose element would exceed the byte budget blocks until a deq or a clear releases enough bytes.
+*/
+int byteBudgetBlocksUntilBytesFit() {
+    pthread_t producer;
+    void *result;
+    assert(BlockingQueue_setByteBudget(queue, 100) == true);
+    assert(BlockingQueue_enqSized(queue, (void*)(intptr_t)60, 60) == true);
+    assert(BlockingQueue_bytes(queue) == 60);
+
+    pthread_create(&producer, NULL, enqSizedThread, (void*)(intptr_t)50);
+    waitForByteWaiters(ONE);
+    assert(BlockingQueue_deq(queue) == (void*)(intptr_t)60);
+    pthread_join(producer, &result);
+    assert(result == (void*)(intptr_t)true);
+    assert(BlockingQueue_bytes(queue) == 50);
+
+    /** A clear releases the bytes of the cleared elements too.*/
+    assert(BlockingQueue_enqSized(queue, (void*)(intptr_t)40, 40) == true);
+    pthread_create(&producer, NULL, enqSizedThread, (void*)(intptr_t)90);
+    waitForByteWaiters(ONE);
+    BlockingQueue_clear(queue);
+    pthread_join(producer, &result);
+    assert(result == (void*)(intptr_t)true);
+    assert(BlockingQueue_bytes(queue) == 90);
+    assert(BlockingQueue_size(queue) == ONE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that released bytes go to a waiting producer whose element fits, even behind an older one whose element does not.
+*/
+int smallElementsDoNotWaitForLargeOnes() {
+    pthread_t large, small;
+    void *result;
+    assert(BlockingQueue_setByteBudget(queue, 100) == true);
+    assert(BlockingQueue_enqSized(queue, (void*)(intptr_t)60, 60) == true);
+    assert(BlockingQueue_enqSized(queue, (void*)(intptr_t)30, 30) == true);
+    pthread_create(&large, NULL, enqSizedThread, (void*)(intptr_t)80);
+    waitForByteWaiters(ONE);
+    pthread_create(&small, NULL, enqSizedThread, (void*)(intptr_t)20);
+    waitForByteWaiters(TWO);
+
+    /** Releasing 60 bytes lets the small element in, the large one still waits.*/
+    assert(BlockingQueue_deq(queue) == (void*)(intptr_t)60);
+    pthread_join(small, &result);
+    assert(result == (void*)(intptr_t)true);
+    assert(BlockingQueue_bytes(queue) == 50);
+    waitForByteWaiters(ONE);
+
+    assert(BlockingQueue_deq(queue) == (void*)(intptr_t)30);
+    pthread_join(large, &result);
+    assert(result == (void*)(intptr_t)true);
+    assert(BlockingQueue_deq(queue) == (void*)(intptr_t)20);
+    assert(BlockingQueue_deq(queue) == (void*)(intptr_t)80);
+    assert(BlockingQueue_bytes(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that elements larger than the budget are refused, including waiting ones when the budget is lowered, and that sizes
+ * are not counted before a budget is set.
+*/
+int elementsLargerThanTheBudgetAreRefused() {
+    pthread_t producer;
+    void *result;
+    assert(BlockingQueue_enqSized(queue, (void*)(intptr_t)500, 500) == true);
+    assert(BlockingQueue_bytes(queue) == ZERO);
+    assert(BlockingQueue_deq(queue) == (void*)(intptr_t)500);
+
+    assert(BlockingQueue_setByteBudget(queue, 100) == true);
+    assert(BlockingQueue_enqSized(queue, (void*)(intptr_t)101, 101) == false);
+    assert(BlockingQueue_enqSized(queue, (void*)(intptr_t)40, 40) == true);
+    pthread_create(&producer, NULL, enqSizedThread, (void*)(intptr_t)80);
+    waitForByteWaiters(ONE);
+    assert(BlockingQueue_setByteBudget(queue, 50) == true);
+    pthread_join(producer, &result);
+    assert(result == (void*)(intptr_t)false);
+    assert(BlockingQueue_size(queue) == ONE);
+
+    /** A budget of 0 removes the limit, sizes still being counted.*/
+    assert(BlockingQueue_setByteBudget(queue, ZERO) == true);
+    assert(BlockingQueue_enqSized(queue, (void*)(intptr_t)1000, 1000) == true);
+    assert(BlockingQueue_bytes(queue) == 1040);
+    return TEST_SUCCESS;
+}
+
 /*
  * Main function for the BlockingQueue tests which will run each user-defined test in turn.
  */
@@ -1055,6 +1632,42 @@ int main() {
 
     runTest(test_BlockingQueue_clear_threadSafety);
 
+    runTest(initOnCallerStorage);
+
+    runTest(initRejectsInvalidArguments);
+
+    runTest(enqHandsOffToWaitingConsumer);
+
+    runTest(deqBatchTakesAvailableElements);
+
+    runTest(rateLimitSpacesDeqs);
+
+    runTest(rateLimitAllowsBursts);
+
+    runTest(rateLimitSharedByConsumers);
+
+    runTest(rateLimitedConsumerLeavesElementQueued);
+
+    runTest(deqBatchReturnsUnusedTokens);
+
+    runTest(sizeDoesNotTakeTheMutex);
+
+    runTest(clearKeepsBlockedConsumersWaiting);
+
+    runTest(handOffDoesNotTakeTheMutex);
+
+    runTest(watermarksSignalEachCrossingOnce);
+
+    runTest(watermarkEventfdCountsCrossings);
+
+    runTest(setWatermarksRejectsInvalidArguments);
+
+    runTest(byteBudgetBlocksUntilBytesFit);
+
+    runTest(smallElementsDoNotWaitForLargeOnes);
+
+    runTest(elementsLargerThanTheBudgetAreRefused);
+
     printf("\nBlockingQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
 
 }
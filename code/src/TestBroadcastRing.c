@@ -0,0 +1,286 @@
+/*
+ * TestBroadcastRing.c
+ *
+ * Very simple unit test file for BroadcastRing functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "BroadcastRing.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_RING_SIZE 4
+#define DEFAULT_MAX_READERS 3
+
+/** Number of elements broadcast by the multi-threaded test.*/
+#define STREAM_ELEMENTS 20000
+
+/*
+ * The ring to use during tests
+ */
+static BroadcastRing *ring;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    ring = new_BroadcastRing(DEFAULT_MAX_RING_SIZE, DEFAULT_MAX_READERS);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    BroadcastRing_destroy(ring);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+
+/*
+ * Checks that the BroadcastRing constructor returns a non-NULL pointer.
+ */
+int newRingIsNotNull() {
+    assert(ring != NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that rings without slots or without readers are refused.
+*/
+int invalidRingsAreNull() {
+    assert(new_BroadcastRing(ZERO, DEFAULT_MAX_READERS) == NULL);
+    assert(new_BroadcastRing(DEFAULT_MAX_RING_SIZE, ZERO) == NULL);
+    assert(new_BroadcastRing(-1, -1) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that no more than max_readers readers can register.
+*/
+int registerUpToMaxReaders() {
+    for (int i = ZERO; i < DEFAULT_MAX_READERS; i++) {
+        assert(BroadcastRing_register(ring) == i);
+    }
+    assert(BroadcastRing_register(ring) == -1);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that NULL elements are refused.
+*/
+int publishNull() {
+    assert(BroadcastRing_publish(ring, NULL) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that every reader sees every element in order.
+*/
+int everyReaderSeesEveryElement() {
+    int first = BroadcastRing_register(ring);
+    int second = BroadcastRing_register(ring);
+    int values[] = {1, 2, 3};
+    for (int i = ZERO; i < THREE; i++) {
+        assert(BroadcastRing_publish(ring, &values[i]) == true);
+    }
+    assert(BroadcastRing_available(ring, first) == THREE);
+    for (int i = ZERO; i < THREE; i++) {
+        assert(*(int*)BroadcastRing_read(ring, first) == values[i]);
+    }
+    assert(BroadcastRing_available(ring, first) == ZERO);
+    assert(BroadcastRing_available(ring, second) == THREE);
+    for (int i = ZERO; i < THREE; i++) {
+        assert(*(int*)BroadcastRing_read(ring, second) == values[i]);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that tryRead returns NULL once a reader has caught up.
+*/
+int tryReadWhenCaughtUp() {
+    int reader = BroadcastRing_register(ring);
+    int value = 7;
+    assert(BroadcastRing_tryRead(ring, reader) == NULL);
+    assert(BroadcastRing_publish(ring, &value) == true);
+    assert(BroadcastRing_tryRead(ring, reader) == &value);
+    assert(BroadcastRing_tryRead(ring, reader) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a ring without readers never blocks the producer.
+*/
+int publishWithoutReaders() {
+    int value = 1;
+    for (int i = ZERO; i < THREE * DEFAULT_MAX_RING_SIZE; i++) {
+        assert(BroadcastRing_publish(ring, &value) == true);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread publishing the given number of elements (1 to count) to the ring.
+*/
+void* publishThread(void* count) {
+    for (intptr_t i = ONE; i <= (intptr_t)count; i++) {
+        BroadcastRing_publish(ring, (void*)i);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Checks that the producer waits for the slowest reader only, and resumes once it reads.
+*/
+int producerWaitsForSlowestReader() {
+    int fast = BroadcastRing_register(ring);
+    int slow = BroadcastRing_register(ring);
+
+    /** The producer publishes one ring and one element: it can only finish once the slow reader frees a slot.*/
+    pthread_t producer;
+    pthread_create(&producer, NULL, publishThread, (void*)(intptr_t)(DEFAULT_MAX_RING_SIZE + ONE));
+
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_RING_SIZE; i++) {
+        assert((intptr_t)BroadcastRing_read(ring, fast) == i);
+    }
+    assert((intptr_t)BroadcastRing_read(ring, slow) == ONE);
+    assert((intptr_t)BroadcastRing_read(ring, fast) == DEFAULT_MAX_RING_SIZE + ONE);
+    pthread_join(producer, NULL);
+
+    for (intptr_t i = TWO; i <= DEFAULT_MAX_RING_SIZE + ONE; i++) {
+        assert((intptr_t)BroadcastRing_read(ring, slow) == i);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread reading the whole stream through its own reader and checking the order.
+ * Returns 1 if every element was received in order, 0 otherwise.
+*/
+void* readerThread(void* reader) {
+    for (intptr_t i = ONE; i <= STREAM_ELEMENTS; i++) {
+        if ((intptr_t)BroadcastRing_read(ring, (int)(intptr_t)reader) != i) {
+            pthread_exit((void*)(intptr_t)ZERO);
+        }
+    }
+    pthread_exit((void*)(intptr_t)ONE);
+}
+
+/**
+ * Checks that several reader threads each receive the whole stream in order.
+*/
+int readersReceiveWholeStream() {
+    pthread_t readers[DEFAULT_MAX_READERS];
+    for (int i = ZERO; i < DEFAULT_MAX_READERS; i++) {
+        int reader = BroadcastRing_register(ring);
+        pthread_create(&readers[i], NULL, readerThread, (void*)(intptr_t)reader);
+    }
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, publishThread, (void*)(intptr_t)STREAM_ELEMENTS);
+    pthread_join(producer, NULL);
+
+    for (int i = ZERO; i < DEFAULT_MAX_READERS; i++) {
+        void *in_order;
+        pthread_join(readers[i], &in_order);
+        assert((intptr_t)in_order == ONE);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread function registering a reader on the ring, returning its identifier.
+*/
+void* registerThread(void* unused) {
+    (void)unused;
+    return (void*)(intptr_t)BroadcastRing_register(ring);
+}
+
+/**
+ * Checks that readers registering at once get distinct identifiers, that no more than max_readers of them do, and that each
+ * starts at the next element to be published.
+*/
+int concurrentRegistrationsStopAtMaxReaders() {
+    int a = 1;
+    assert(BroadcastRing_publish(ring, &a) == true);
+
+    pthread_t registering[TWO * DEFAULT_MAX_READERS];
+    for (int i = ZERO; i < TWO * DEFAULT_MAX_READERS; i++) {
+        pthread_create(&registering[i], NULL, registerThread, NULL);
+    }
+    int registered[DEFAULT_MAX_READERS] = {ZERO}, refused = ZERO;
+    for (int i = ZERO; i < TWO * DEFAULT_MAX_READERS; i++) {
+        void *reader;
+        pthread_join(registering[i], &reader);
+        if ((intptr_t)reader == -1) {
+            refused++;
+        } else {
+            assert((intptr_t)reader >= ZERO && (intptr_t)reader < DEFAULT_MAX_READERS);
+            registered[(intptr_t)reader]++;
+        }
+    }
+
+    assert(refused == DEFAULT_MAX_READERS);
+    assert(atomic_load(&ring->reader_count) == DEFAULT_MAX_READERS);
+    for (int i = ZERO; i < DEFAULT_MAX_READERS; i++) {
+        assert(registered[i] == ONE);
+        assert(BroadcastRing_available(ring, i) == ZERO);
+    }
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the BroadcastRing tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newRingIsNotNull);
+
+    runTest(invalidRingsAreNull);
+
+    runTest(registerUpToMaxReaders);
+
+    runTest(publishNull);
+
+    runTest(everyReaderSeesEveryElement);
+
+    runTest(tryReadWhenCaughtUp);
+
+    runTest(publishWithoutReaders);
+
+    runTest(producerWaitsForSlowestReader);
+
+    runTest(readersReceiveWholeStream);
+
+    runTest(concurrentRegistrationsStopAtMaxReaders);
+
+    printf("\nBroadcastRing Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
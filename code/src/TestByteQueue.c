@@ -0,0 +1,280 @@
+/*
+ * TestByteQueue.c
+ *
+ * Very simple unit test file for ByteQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ByteQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_CAPACITY 64
+
+/** Number of messages and capacity used by the producer/consumer test.*/
+#define STREAM_MESSAGES 2000
+#define STREAM_CAPACITY 512
+#define STREAM_MAX_LENGTH 200
+
+/*
+ * The queue to use during tests
+ */
+static ByteQueue *queue;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_ByteQueue(DEFAULT_CAPACITY);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    ByteQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Fills a message of the given length with bytes derived from its sequence number.
+*/
+static void makeMessage(unsigned char *message, size_t length, int sequence) {
+    for (size_t i = ZERO; i < length; i++) {
+        message[i] = (unsigned char)(sequence * 31 + i);
+    }
+}
+
+/**
+ * Returns the length of the message with the given sequence number in the producer/consumer test.
+*/
+static size_t streamLength(int sequence) {
+    return (size_t)(sequence * 37) % STREAM_MAX_LENGTH + ONE;
+}
+
+
+/*
+ * Checks that the ByteQueue constructor returns a non-NULL pointer.
+ */
+int newQueueIsNotNull() {
+    assert(queue != NULL);
+    assert(ByteQueue_isEmpty(queue) == true);
+    assert(ByteQueue_bytesUsed(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a ring too small to hold a frame is refused.
+*/
+int tinyQueueIsNull() {
+    assert(new_ByteQueue(ZERO) == NULL);
+    assert(new_ByteQueue(BYTE_QUEUE_ALIGNMENT) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a message is copied in and out with its length.
+*/
+int enqAndDeqOneMessage() {
+    const char *message = "I love kiwis!";
+    char buffer[DEFAULT_CAPACITY];
+    assert(ByteQueue_enq(queue, message, strlen(message) + ONE) == true);
+    assert(ByteQueue_size(queue) == ONE);
+    assert(ByteQueue_peekLength(queue) == (ssize_t)strlen(message) + ONE);
+
+    /** A 14 byte message takes an 8 byte header and 16 bytes of padded payload.*/
+    assert(ByteQueue_bytesUsed(queue) == 24);
+    assert(ByteQueue_deq(queue, buffer, sizeof(buffer)) == (ssize_t)strlen(message) + ONE);
+    assert(strcmp(buffer, message) == ZERO);
+    assert(ByteQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that NULL messages and messages larger than the ring are refused.
+*/
+int invalidMessagesAreRefused() {
+    unsigned char message[DEFAULT_CAPACITY];
+    assert(ByteQueue_enq(queue, NULL, ONE) == false);
+    assert(ByteQueue_tryEnq(queue, NULL, ONE) == false);
+    assert(ByteQueue_enq(queue, message, DEFAULT_CAPACITY) == false);
+    assert(ByteQueue_tryEnq(queue, message, DEFAULT_CAPACITY) == false);
+    assert(ByteQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the non-blocking variants fail on a full or an empty ring.
+*/
+int tryEnqWhenFullAndTryDeqWhenEmpty() {
+    unsigned char message[24];
+    assert(ByteQueue_tryDeq(queue, message, sizeof(message)) == -1);
+    assert(ByteQueue_peekLength(queue) == -1);
+    assert(ByteQueue_tryEnq(queue, message, sizeof(message)) == true);
+    assert(ByteQueue_tryEnq(queue, message, sizeof(message)) == true);
+    assert(ByteQueue_tryEnq(queue, message, sizeof(message)) == false);
+    assert(ByteQueue_size(queue) == TWO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a message larger than the destination buffer stays in the queue.
+*/
+int smallBufferKeepsMessage() {
+    unsigned char message[20], buffer[20];
+    makeMessage(message, sizeof(message), ONE);
+    assert(ByteQueue_enq(queue, message, sizeof(message)) == true);
+    assert(ByteQueue_deq(queue, buffer, sizeof(buffer) - ONE) == -1);
+    assert(ByteQueue_tryDeq(queue, NULL, ZERO) == -1);
+    assert(ByteQueue_size(queue) == ONE);
+    assert(ByteQueue_deq(queue, buffer, sizeof(buffer)) == (ssize_t)sizeof(message));
+    assert(memcmp(buffer, message, sizeof(message)) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a frame which does not fit at the end of the ring is placed at the start after a padding frame.
+*/
+int wrapAroundUsesPadding() {
+    unsigned char first[24], second[16], third[16], buffer[24];
+    makeMessage(first, sizeof(first), ONE);
+    makeMessage(second, sizeof(second), TWO);
+    makeMessage(third, sizeof(third), THREE);
+
+    /** 32 + 24 bytes used, leaving 8 bytes at the end of the ring.*/
+    assert(ByteQueue_tryEnq(queue, first, sizeof(first)) == true);
+    assert(ByteQueue_tryEnq(queue, second, sizeof(second)) == true);
+    assert(ByteQueue_deq(queue, buffer, sizeof(buffer)) == (ssize_t)sizeof(first));
+
+    /** The third frame needs 24 bytes: the last 8 bytes become padding and the frame goes to the start.*/
+    assert(ByteQueue_tryEnq(queue, third, sizeof(third)) == true);
+    assert(ByteQueue_bytesUsed(queue) == 24 + 8 + 24);
+    assert(ByteQueue_size(queue) == TWO);
+
+    assert(ByteQueue_deq(queue, buffer, sizeof(buffer)) == (ssize_t)sizeof(second));
+    assert(memcmp(buffer, second, sizeof(second)) == ZERO);
+    assert(ByteQueue_deq(queue, buffer, sizeof(buffer)) == (ssize_t)sizeof(third));
+    assert(memcmp(buffer, third, sizeof(third)) == ZERO);
+    assert(ByteQueue_bytesUsed(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a frame as large as the ring fits once the ring is empty, wherever the previous frames ended.
+*/
+int fullSizeFrameFitsInEmptyRing() {
+    unsigned char message[DEFAULT_CAPACITY - BYTE_QUEUE_ALIGNMENT], buffer[DEFAULT_CAPACITY];
+    makeMessage(message, sizeof(message), ONE);
+    assert(ByteQueue_tryEnq(queue, message, 8) == true);
+    assert(ByteQueue_tryDeq(queue, buffer, sizeof(buffer)) == 8);
+    assert(ByteQueue_tryEnq(queue, message, sizeof(message)) == true);
+    assert(ByteQueue_bytesUsed(queue) == DEFAULT_CAPACITY);
+    assert(ByteQueue_tryDeq(queue, buffer, sizeof(buffer)) == (ssize_t)sizeof(message));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that clearing the queue releases every byte.
+*/
+int clearWorks() {
+    unsigned char message[16];
+    makeMessage(message, sizeof(message), ONE);
+    assert(ByteQueue_enq(queue, message, sizeof(message)) == true);
+    assert(ByteQueue_enq(queue, message, sizeof(message)) == true);
+    ByteQueue_clear(queue);
+    assert(ByteQueue_isEmpty(queue) == true);
+    assert(ByteQueue_bytesUsed(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread producing the stream of messages of varying lengths.
+*/
+void* producerThread(void* stream) {
+    unsigned char message[STREAM_MAX_LENGTH];
+    for (int i = ZERO; i < STREAM_MESSAGES; i++) {
+        makeMessage(message, streamLength(i), i);
+        ByteQueue_enq((ByteQueue*)stream, message, streamLength(i));
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Checks that a blocking producer and consumer exchange messages of varying lengths in order through a small ring.
+*/
+int producerConsumerStream() {
+    ByteQueue *stream = new_ByteQueue(STREAM_CAPACITY);
+    assert(stream != NULL);
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, producerThread, stream);
+
+    unsigned char buffer[STREAM_MAX_LENGTH], expected[STREAM_MAX_LENGTH];
+    for (int i = ZERO; i < STREAM_MESSAGES; i++) {
+        ssize_t length = ByteQueue_deq(stream, buffer, sizeof(buffer));
+        makeMessage(expected, streamLength(i), i);
+        assert(length == (ssize_t)streamLength(i));
+        assert(memcmp(buffer, expected, (size_t)length) == ZERO);
+    }
+
+    pthread_join(producer, NULL);
+    assert(ByteQueue_isEmpty(stream) == true);
+    ByteQueue_destroy(stream);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the ByteQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(tinyQueueIsNull);
+
+    runTest(enqAndDeqOneMessage);
+
+    runTest(invalidMessagesAreRefused);
+
+    runTest(tryEnqWhenFullAndTryDeqWhenEmpty);
+
+    runTest(smallBufferKeepsMessage);
+
+    runTest(wrapAroundUsesPadding);
+
+    runTest(fullSizeFrameFitsInEmptyRing);
+
+    runTest(clearWorks);
+
+    runTest(producerConsumerStream);
+
+    printf("\nByteQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
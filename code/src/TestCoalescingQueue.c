@@ -0,0 +1,273 @@
+/*
+ * TestCoalescingQueue.c
+ *
+ * Very simple unit test file for CoalescingQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "CoalescingQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_QUEUE_SIZE 8
+
+/** Number of events and of distinct keys in the bounded backlog test.*/
+#define EVENTS 100000
+#define DISTINCT_KEYS 8
+
+/** Number of random operations, and range of the random keys, in the index test.*/
+#define RANDOM_OPERATIONS 200000
+#define RANDOM_KEYS 64
+
+/*
+ * The queue to use during tests
+ */
+static CoalescingQueue *queue;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_CoalescingQueue(DEFAULT_MAX_QUEUE_SIZE, NULL, NULL);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    CoalescingQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Merge callback adding the integer values, and counting its calls in the int pointed to by ctx.
+*/
+void* addValues(void* pending, void* update, void* ctx) {
+    (*(int*)ctx)++;
+    return (void*)((intptr_t)pending + (intptr_t)update);
+}
+
+/**
+ * Thread dequeuing one entry from the queue and returning its value.
+*/
+void* dequeueThread(void* unused) {
+    (void)unused;
+    return CoalescingQueue_deq(queue, NULL);
+}
+
+/**
+ * Thread enqueuing a new key into the queue.
+*/
+void* enqueueThread(void* value) {
+    CoalescingQueue_enq(queue, DEFAULT_MAX_QUEUE_SIZE, value);
+    return NULL;
+}
+
+
+/*
+ * Checks that the constructor returns an empty queue, and refuses invalid sizes.
+ */
+int newQueueIsEmpty() {
+    assert(queue != NULL);
+    assert(new_CoalescingQueue(ZERO, NULL, NULL) == NULL);
+    assert(new_CoalescingQueue(-1, NULL, NULL) == NULL);
+    assert(CoalescingQueue_isEmpty(queue) == true);
+    assert(CoalescingQueue_tryDeq(queue, NULL) == NULL);
+    assert(CoalescingQueue_enq(queue, ONE, NULL) == false);
+    assert(CoalescingQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that distinct keys come out in FIFO order with their values.
+*/
+int distinctKeysComeOutInOrder() {
+    uint64_t key;
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(CoalescingQueue_enq(queue, (uint64_t)(i * 1000), (void*)i) == true);
+    }
+    assert(CoalescingQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(CoalescingQueue_deq(queue, &key) == (void*)i);
+        assert(key == (uint64_t)(i * 1000));
+    }
+    assert(CoalescingQueue_coalesced(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that an enq for a pending key replaces its value in place, keeping its position.
+*/
+int pendingKeyIsReplacedInPlace() {
+    uint64_t key;
+    CoalescingQueue_enq(queue, 1, (void*)(intptr_t)10);
+    CoalescingQueue_enq(queue, 2, (void*)(intptr_t)20);
+    CoalescingQueue_enq(queue, 1, (void*)(intptr_t)11);
+    CoalescingQueue_enq(queue, 3, (void*)(intptr_t)30);
+    CoalescingQueue_enq(queue, 1, (void*)(intptr_t)12);
+    assert(CoalescingQueue_size(queue) == THREE);
+    assert(CoalescingQueue_coalesced(queue) == TWO);
+
+    assert(CoalescingQueue_deq(queue, &key) == (void*)(intptr_t)12);
+    assert(key == 1);
+    assert(CoalescingQueue_deq(queue, &key) == (void*)(intptr_t)20);
+    assert(CoalescingQueue_deq(queue, &key) == (void*)(intptr_t)30);
+
+    /** Once dequeued, the key is new again and goes to the back.*/
+    CoalescingQueue_enq(queue, 2, (void*)(intptr_t)21);
+    CoalescingQueue_enq(queue, 1, (void*)(intptr_t)13);
+    assert(CoalescingQueue_deq(queue, &key) == (void*)(intptr_t)21);
+    assert(CoalescingQueue_deq(queue, &key) == (void*)(intptr_t)13);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the merge callback combines an update with the pending value.
+*/
+int mergeCallbackCombinesValues() {
+    int merges = ZERO;
+    CoalescingQueue *merging = new_CoalescingQueue(DEFAULT_MAX_QUEUE_SIZE, addValues, &merges);
+    for (intptr_t i = ONE; i <= 10; i++) {
+        CoalescingQueue_enq(merging, 7, (void*)i);
+    }
+    assert(merges == 9);
+    assert(CoalescingQueue_size(merging) == ONE);
+    assert(CoalescingQueue_tryDeq(merging, NULL) == (void*)(intptr_t)55);
+    CoalescingQueue_destroy(merging);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the backlog is bounded by the distinct keys: a full queue still coalesces without blocking.
+*/
+int backlogIsBoundedByDistinctKeys() {
+    for (intptr_t i = ONE; i <= EVENTS; i++) {
+        assert(CoalescingQueue_enq(queue, (uint64_t)(i % DISTINCT_KEYS), (void*)i) == true);
+    }
+    assert(CoalescingQueue_size(queue) == DISTINCT_KEYS);
+    assert(CoalescingQueue_coalesced(queue) == EVENTS - DISTINCT_KEYS);
+
+    /** Each key holds its latest event, in order of first appearance.*/
+    for (intptr_t i = ONE; i <= DISTINCT_KEYS; i++) {
+        intptr_t latest = EVENTS - (EVENTS - i) % DISTINCT_KEYS;
+        assert(CoalescingQueue_tryDeq(queue, NULL) == (void*)latest);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that an enq of a new key on a full queue waits for a deq, and that a deq on an empty queue waits for an enq.
+*/
+int newKeysBlockOnAFullQueue() {
+    pthread_t enqueuingThread, dequeuingThread;
+    void *result;
+    for (intptr_t i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        CoalescingQueue_enq(queue, (uint64_t)i, (void*)(i + ONE));
+    }
+    pthread_create(&enqueuingThread, NULL, enqueueThread, (void*)(intptr_t)100);
+    sched_yield();
+    assert(CoalescingQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    assert(CoalescingQueue_deq(queue, NULL) == (void*)(intptr_t)ONE);
+    pthread_join(enqueuingThread, NULL);
+    for (intptr_t i = TWO; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(CoalescingQueue_deq(queue, NULL) == (void*)i);
+    }
+    assert(CoalescingQueue_deq(queue, NULL) == (void*)(intptr_t)100);
+
+    pthread_create(&dequeuingThread, NULL, dequeueThread, NULL);
+    sched_yield();
+    CoalescingQueue_enq(queue, ONE, (void*)(intptr_t)200);
+    pthread_join(dequeuingThread, &result);
+    assert(result == (void*)(intptr_t)200);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks the hash index against a simple model over random enqs and deqs of colliding keys, so that backward-shift deletions
+ * run across the end of the index.
+*/
+int indexMatchesAModel() {
+    uint64_t model_keys[DEFAULT_MAX_QUEUE_SIZE];
+    intptr_t model_values[DEFAULT_MAX_QUEUE_SIZE];
+    int model_size = ZERO;
+    uint64_t key;
+    srand(1);
+    for (intptr_t operation = ONE; operation <= RANDOM_OPERATIONS; operation++) {
+        if (rand() % TWO == ZERO && model_size < DEFAULT_MAX_QUEUE_SIZE) {
+            /** Enq: replaces the value of a pending key, or appends a new one.*/
+            uint64_t random_key = (uint64_t)(rand() % RANDOM_KEYS);
+            int position = ZERO;
+            while (position < model_size && model_keys[position] != random_key) {
+                position++;
+            }
+            model_keys[position] = random_key;
+            model_values[position] = operation;
+            if (position == model_size) {
+                model_size++;
+            }
+            assert(CoalescingQueue_enq(queue, random_key, (void*)operation) == true);
+        } else if (model_size > ZERO) {
+            assert(CoalescingQueue_tryDeq(queue, &key) == (void*)model_values[ZERO]);
+            assert(key == model_keys[ZERO]);
+            for (int i = ONE; i < model_size; i++) {
+                model_keys[i - ONE] = model_keys[i];
+                model_values[i - ONE] = model_values[i];
+            }
+            model_size--;
+        }
+        assert(CoalescingQueue_size(queue) == model_size);
+    }
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the CoalescingQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsEmpty);
+
+    runTest(distinctKeysComeOutInOrder);
+
+    runTest(pendingKeyIsReplacedInPlace);
+
+    runTest(mergeCallbackCombinesValues);
+
+    runTest(backlogIsBoundedByDistinctKeys);
+
+    runTest(newKeysBlockOnAFullQueue);
+
+    runTest(indexMatchesAModel);
+
+    printf("\nCoalescingQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
@@ -0,0 +1,362 @@
+/*
+ * TestCombiningBlockingQueue.c
+ *
+ * Very simple unit test file for CombiningBlockingQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "CombiningBlockingQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_QUEUE_SIZE 4
+#define DEFAULT_MAX_THREADS 16
+
+/** Number of producer and consumer threads, and of elements each of them handles, in the multi-threaded test.*/
+#define STRESS_THREADS 6
+#define STRESS_ELEMENTS 5000
+
+/*
+ * The queue to use during tests
+ */
+static CombiningBlockingQueue *queue;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_CombiningBlockingQueue(DEFAULT_MAX_QUEUE_SIZE, DEFAULT_MAX_THREADS);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    CombiningBlockingQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Thread to enqueue an element at the rear of the queue.
+*/
+void* enqueueThread(void* element) {
+    pthread_exit((void*)(intptr_t)CombiningBlockingQueue_enq(queue, element));
+}
+
+/**
+ * Thread to dequeue an element from the front of the queue.
+*/
+void* dequeueThread(void* unused) {
+    (void)unused;
+    pthread_exit(CombiningBlockingQueue_deq(queue));
+}
+
+
+/*
+ * Checks that the CombiningBlockingQueue constructor returns a non-NULL pointer.
+ */
+int newQueueIsNotNull() {
+    assert(queue != NULL);
+    assert(CombiningBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that queues without slots or without publication records are refused.
+*/
+int invalidQueuesAreNull() {
+    assert(new_CombiningBlockingQueue(ZERO, DEFAULT_MAX_THREADS) == NULL);
+    assert(new_CombiningBlockingQueue(DEFAULT_MAX_QUEUE_SIZE, ZERO) == NULL);
+    assert(new_CombiningBlockingQueue(-1, -1) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that elements come out in the order they went in, and that size follows.
+*/
+int enqAndDeqInOrder() {
+    int elements[] = {1, 2, 3};
+    for (int i = ZERO; i < THREE; i++) {
+        assert(CombiningBlockingQueue_enq(queue, &elements[i]) == true);
+        assert(CombiningBlockingQueue_size(queue) == i + ONE);
+    }
+    for (int i = ZERO; i < THREE; i++) {
+        assert(CombiningBlockingQueue_deq(queue) == &elements[i]);
+    }
+    assert(CombiningBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that NULL elements are refused.
+*/
+int enqNull() {
+    assert(CombiningBlockingQueue_enq(queue, NULL) == false);
+    assert(CombiningBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that clearing empties the queue and that it keeps working afterwards.
+*/
+int clearWorks() {
+    int a = 1, b = 2;
+    assert(CombiningBlockingQueue_enq(queue, &a) == true);
+    assert(CombiningBlockingQueue_enq(queue, &a) == true);
+    CombiningBlockingQueue_clear(queue);
+    assert(CombiningBlockingQueue_isEmpty(queue) == true);
+    assert(CombiningBlockingQueue_enq(queue, &b) == true);
+    assert(CombiningBlockingQueue_deq(queue) == &b);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a dequeuing thread waits for an element enqueued after it started.
+*/
+int deqWaitsForEnq() {
+    int a = 1;
+    pthread_t dequeuingThread;
+    void *result;
+    pthread_create(&dequeuingThread, NULL, dequeueThread, NULL);
+    assert(CombiningBlockingQueue_enq(queue, &a) == true);
+    pthread_join(dequeuingThread, &result);
+    assert(result == &a);
+    assert(CombiningBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that an enqueuing thread waits for space in a full queue and enqueues once an element is dequeued.
+*/
+int enqWaitsWhenFull() {
+    int elements[] = {1, 2, 3, 4, 5};
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(CombiningBlockingQueue_enq(queue, &elements[i]) == true);
+    }
+
+    pthread_t enqueuingThread;
+    void *result;
+    pthread_create(&enqueuingThread, NULL, enqueueThread, &elements[FOUR]);
+    assert(CombiningBlockingQueue_deq(queue) == &elements[ZERO]);
+    pthread_join(enqueuingThread, &result);
+
+    assert((intptr_t)result == true);
+    assert(CombiningBlockingQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    for (int i = ONE; i <= FOUR; i++) {
+        assert(CombiningBlockingQueue_deq(queue) == &elements[i]);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that clearing a full queue lets the enqueuing threads blocked on it through.
+*/
+int clearReleasesWaitingEnqs() {
+    int elements[] = {1, 2};
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(CombiningBlockingQueue_enq(queue, &elements[ZERO]) == true);
+    }
+
+    pthread_t enqueuingThreads[TWO];
+    for (int i = ZERO; i < TWO; i++) {
+        pthread_create(&enqueuingThreads[i], NULL, enqueueThread, &elements[ONE]);
+    }
+    CombiningBlockingQueue_clear(queue);
+    for (int i = ZERO; i < TWO; i++) {
+        pthread_join(enqueuingThreads[i], NULL);
+    }
+
+    /** Whether the enqueuing threads blocked before the clear or arrived after it, they end up in the cleared queue.*/
+    assert(CombiningBlockingQueue_size(queue) == TWO);
+    assert(CombiningBlockingQueue_deq(queue) == &elements[ONE]);
+    assert(CombiningBlockingQueue_deq(queue) == &elements[ONE]);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread enqueuing the elements 1 to STRESS_ELEMENTS.
+*/
+void* producerThread(void* unused) {
+    (void)unused;
+    for (intptr_t i = ONE; i <= STRESS_ELEMENTS; i++) {
+        CombiningBlockingQueue_enq(queue, (void*)i);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Thread dequeuing STRESS_ELEMENTS elements and returning their sum.
+*/
+void* consumerThread(void* unused) {
+    (void)unused;
+    intptr_t sum = ZERO;
+    for (int i = ZERO; i < STRESS_ELEMENTS; i++) {
+        sum += (intptr_t)CombiningBlockingQueue_deq(queue);
+    }
+    pthread_exit((void*)sum);
+}
+
+/**
+ * Checks that many producers and consumers exchange every element exactly once through a small queue.
+*/
+int manyProducersAndConsumers() {
+    pthread_t producers[STRESS_THREADS], consumers[STRESS_THREADS];
+    for (int i = ZERO; i < STRESS_THREADS; i++) {
+        pthread_create(&producers[i], NULL, producerThread, NULL);
+        pthread_create(&consumers[i], NULL, consumerThread, NULL);
+    }
+
+    intptr_t total = ZERO;
+    for (int i = ZERO; i < STRESS_THREADS; i++) {
+        void *sum;
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], &sum);
+        total += (intptr_t)sum;
+    }
+
+    assert(total == (intptr_t)STRESS_THREADS * STRESS_ELEMENTS * (STRESS_ELEMENTS + ONE) / TWO);
+    assert(CombiningBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that more threads than publication records still complete, even when every record holds a deq on an empty ring.
+*/
+int moreThreadsThanRecords() {
+    CombiningBlockingQueue *shared = queue;
+    queue = new_CombiningBlockingQueue(DEFAULT_MAX_QUEUE_SIZE, TWO);
+    assert(queue != NULL);
+
+    pthread_t producers[FOUR], consumers[FOUR];
+    for (int i = ZERO; i < FOUR; i++) {
+        pthread_create(&producers[i], NULL, producerThread, NULL);
+        pthread_create(&consumers[i], NULL, consumerThread, NULL);
+    }
+    intptr_t total = ZERO;
+    for (int i = ZERO; i < FOUR; i++) {
+        void *sum;
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], &sum);
+        total += (intptr_t)sum;
+    }
+
+    CombiningBlockingQueue_destroy(queue);
+    queue = shared;
+    assert(total == (intptr_t)FOUR * STRESS_ELEMENTS * (STRESS_ELEMENTS + ONE) / TWO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a thread finding every record in use sleeps instead of spinning while its operation cannot be applied, and is
+ * woken once it can.
+*/
+int threadsWithoutRecordSleep() {
+    int a = 1, b = 2;
+    CombiningBlockingQueue *shared = queue;
+    queue = new_CombiningBlockingQueue(DEFAULT_MAX_QUEUE_SIZE, ONE);
+    pthread_t dequeuingThreads[TWO];
+    void *results[TWO];
+    for (int i = ZERO; i < TWO; i++) {
+        pthread_create(&dequeuingThreads[i], NULL, dequeueThread, NULL);
+    }
+    while (atomic_load(&queue->overflow_waiting) == ZERO) {
+        sched_yield();
+    }
+
+    assert(CombiningBlockingQueue_enq(queue, &a) == true);
+    assert(CombiningBlockingQueue_enq(queue, &b) == true);
+    for (int i = ZERO; i < TWO; i++) {
+        pthread_join(dequeuingThreads[i], &results[i]);
+    }
+    CombiningBlockingQueue_destroy(queue);
+    queue = shared;
+    assert((results[ZERO] == &a && results[ONE] == &b) || (results[ZERO] == &b && results[ONE] == &a));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that operations finding no active combiner are applied directly, and that a direct enq serves the deq published in a
+ * record while the queue was empty.
+*/
+int uncontendedOperationsApplyDirectly() {
+    int a = 1, b = 2;
+    assert(CombiningBlockingQueue_enq(queue, &a) == true);
+    assert(CombiningBlockingQueue_deq(queue) == &a);
+    assert(CombiningBlockingQueue_directOps(queue) == TWO);
+
+    /** Publishes a deq in the first record, as a consumer blocked on the empty queue would.*/
+    CombiningRecord *record = &queue->records[ZERO];
+    atomic_store(&record->op, COMBINING_OP_DEQ);
+    atomic_store(&record->element, NULL);
+    atomic_store(&record->state, COMBINING_RECORD_PENDING);
+
+    assert(CombiningBlockingQueue_enq(queue, &b) == true);
+    assert(CombiningBlockingQueue_directOps(queue) == THREE);
+    assert(atomic_load(&record->state) == COMBINING_RECORD_DONE);
+    assert(sem_trywait(&record->served) == ZERO);
+    assert(atomic_load(&record->element) == &b);
+    assert(CombiningBlockingQueue_isEmpty(queue) == true);
+    atomic_store(&record->state, COMBINING_RECORD_FREE);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the CombiningBlockingQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(invalidQueuesAreNull);
+
+    runTest(enqAndDeqInOrder);
+
+    runTest(enqNull);
+
+    runTest(clearWorks);
+
+    runTest(deqWaitsForEnq);
+
+    runTest(enqWaitsWhenFull);
+
+    runTest(clearReleasesWaitingEnqs);
+
+    runTest(manyProducersAndConsumers);
+
+    runTest(moreThreadsThanRecords);
+
+    runTest(threadsWithoutRecordSleep);
+
+    runTest(uncontendedOperationsApplyDirectly);
+
+    printf("\nCombiningBlockingQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
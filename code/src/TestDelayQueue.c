@@ -0,0 +1,245 @@
+/*
+ * TestDelayQueue.c
+ *
+ * Very simple unit test file for DelayQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "DelayQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_QUEUE_SIZE 4
+
+/** Delays used by the tests, in milliseconds. LONG_DELAY is never waited for.*/
+#define SHORT_DELAY 20
+#define LONG_DELAY 10000
+
+/*
+ * The queue to use during tests
+ */
+static DelayQueue *queue;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_DelayQueue(DEFAULT_MAX_QUEUE_SIZE);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    DelayQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Thread to enqueue an element ready at once.
+*/
+void* enqueueThread(void* element) {
+    pthread_exit((void*)(intptr_t)DelayQueue_enq(queue, element, DelayQueue_now()));
+}
+
+/**
+ * Thread to dequeue an element.
+*/
+void* dequeueThread(void* unused) {
+    (void)unused;
+    pthread_exit(DelayQueue_deq(queue));
+}
+
+
+/*
+ * Checks that the DelayQueue constructor returns a non-NULL pointer.
+ */
+int newQueueIsNotNull() {
+    assert(queue != NULL);
+    assert(DelayQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that queues without slots are refused.
+*/
+int invalidQueuesAreNull() {
+    assert(new_DelayQueue(ZERO) == NULL);
+    assert(new_DelayQueue(-1) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that NULL elements are refused.
+*/
+int enqNull() {
+    assert(DelayQueue_enq(queue, NULL, DelayQueue_now()) == false);
+    assert(DelayQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that elements whose time has passed are ready at once, in the order they were enqueued.
+*/
+int pastElementsAreReadyAtOnce() {
+    int a = 1, b = 2;
+    uint64_t now = DelayQueue_now();
+    assert(DelayQueue_enq(queue, &a, now - ONE) == true);
+    assert(DelayQueue_enq(queue, &b, ZERO) == true);
+    assert(DelayQueue_size(queue) == TWO);
+    assert(DelayQueue_tryDeq(queue) == &a);
+    assert(DelayQueue_tryDeq(queue) == &b);
+    assert(DelayQueue_tryDeq(queue) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that elements are not released before their time, whichever level of the wheel or the overflow list holds them.
+*/
+int elementsAreNotReleasedEarly() {
+    int a = 1, b = 2, c = 3;
+    uint64_t now = DelayQueue_now();
+    assert(DelayQueue_enq(queue, &a, now + LONG_DELAY) == true);
+    assert(DelayQueue_enq(queue, &b, now + (UINT64_C(1) << 40)) == true);
+    assert(DelayQueue_enq(queue, &c, now + SHORT_DELAY) == true);
+    assert(DelayQueue_tryDeq(queue) == NULL);
+    assert(DelayQueue_size(queue) == THREE);
+
+    assert(DelayQueue_deq(queue) == &c);
+    assert(DelayQueue_now() >= now + SHORT_DELAY);
+    assert(DelayQueue_tryDeq(queue) == NULL);
+    assert(DelayQueue_size(queue) == TWO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that elements come out in the order of their times, including times cascading from the higher levels.
+*/
+int deqInOrderOfTime() {
+    int elements[] = {1, 2, 3, 4};
+    int delays[] = {150, 30, 300, 70};
+    uint64_t now = DelayQueue_now();
+    for (int i = ZERO; i < FOUR; i++) {
+        assert(DelayQueue_enq(queue, &elements[i], now + delays[i]) == true);
+    }
+
+    int expected[] = {1, 3, 0, 2};
+    for (int i = ZERO; i < FOUR; i++) {
+        assert(DelayQueue_deq(queue) == &elements[expected[i]]);
+        assert(DelayQueue_now() >= now + delays[expected[i]]);
+    }
+    assert(DelayQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a dequeuing thread waits on an empty queue until an element is enqueued and due.
+*/
+int deqWaitsForEnq() {
+    int a = 1;
+    pthread_t dequeuingThread;
+    void *result;
+    pthread_create(&dequeuingThread, NULL, dequeueThread, NULL);
+    uint64_t ready_at = DelayQueue_now() + SHORT_DELAY;
+    assert(DelayQueue_enq(queue, &a, ready_at) == true);
+    pthread_join(dequeuingThread, &result);
+    assert(result == &a);
+    assert(DelayQueue_now() >= ready_at);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a dequeuing thread sleeping until a far time wakes up for an element enqueued with an earlier time.
+*/
+int earlierEnqWakesSleepingDeq() {
+    int a = 1, b = 2;
+    uint64_t now = DelayQueue_now();
+    assert(DelayQueue_enq(queue, &a, now + LONG_DELAY) == true);
+
+    pthread_t dequeuingThread;
+    void *result;
+    pthread_create(&dequeuingThread, NULL, dequeueThread, NULL);
+    assert(DelayQueue_enq(queue, &b, now + SHORT_DELAY) == true);
+    pthread_join(dequeuingThread, &result);
+
+    assert(result == &b);
+    assert(DelayQueue_now() < now + LONG_DELAY);
+    assert(DelayQueue_size(queue) == ONE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that an enqueuing thread waits when the queue is full, even of elements not due yet, until a clear frees it.
+*/
+int enqWaitsWhenFull() {
+    int a = 1, b = 2;
+    uint64_t now = DelayQueue_now();
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(DelayQueue_enq(queue, &a, now + LONG_DELAY) == true);
+    }
+
+    pthread_t enqueuingThread;
+    void *result;
+    pthread_create(&enqueuingThread, NULL, enqueueThread, &b);
+    DelayQueue_clear(queue);
+    pthread_join(enqueuingThread, &result);
+
+    assert((intptr_t)result == true);
+    assert(DelayQueue_size(queue) == ONE);
+    assert(DelayQueue_deq(queue) == &b);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the DelayQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(invalidQueuesAreNull);
+
+    runTest(enqNull);
+
+    runTest(pastElementsAreReadyAtOnce);
+
+    runTest(elementsAreNotReleasedEarly);
+
+    runTest(deqInOrderOfTime);
+
+    runTest(deqWaitsForEnq);
+
+    runTest(earlierEnqWakesSleepingDeq);
+
+    runTest(enqWaitsWhenFull);
+
+    printf("\nDelayQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
@@ -0,0 +1,399 @@
+/*
+ * TestDurableQueue.c
+ *
+ * Very simple unit test file for DurableQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+
+#include "DurableQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_QUEUE_SIZE 20
+
+/*
+ * The queue to use during tests
+ */
+static DurableQueue *queue;
+
+/*
+ * The path of the file backing the queue
+ */
+static char queue_path[64];
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    snprintf(queue_path, sizeof(queue_path), "/tmp/TestDurableQueue.%d", (int)getpid());
+    unlink(queue_path);
+    queue = new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE, sizeof(long), DURABLE_QUEUE_SYNC_BATCH, ZERO);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    DurableQueue_destroy(queue);
+    unlink(queue_path);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Closes the queue used by the test and opens its file again, as a restarted process would.
+*/
+static void reopen() {
+    DurableQueue_destroy(queue);
+    queue = new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE, sizeof(long), DURABLE_QUEUE_SYNC_BATCH, ZERO);
+}
+
+/**
+ * Enqueues the records first to last included.
+*/
+static bool enqRange(long first, long last) {
+    for (long record = first; record <= last; record++) {
+        if (!DurableQueue_enq(queue, &record)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Dequeues and checks the records first to last included.
+*/
+static bool deqRange(long first, long last) {
+    long record;
+    for (long expected = first; expected <= last; expected++) {
+        if (!DurableQueue_deq(queue, &record) || record != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Checks that the DurableQueue constructor returns a non-NULL pointer.
+ */
+int newQueueIsNotNull() {
+    assert(queue != NULL);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the size of a new durable queue is 0.
+ */
+int newQueueSizeZero() {
+    assert(DurableQueue_size(queue) == 0);
+    assert(DurableQueue_isEmpty(queue) == true);
+    assert(DurableQueue_recovered(queue) == 0);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that invalid parameters are refused.
+*/
+int invalidQueuesAreNull() {
+    assert(new_DurableQueue(NULL, DEFAULT_MAX_QUEUE_SIZE, sizeof(long), DURABLE_QUEUE_SYNC_NONE, ZERO) == NULL);
+    assert(new_DurableQueue("/tmp/TestDurableQueue.invalid", ZERO, sizeof(long), DURABLE_QUEUE_SYNC_NONE, ZERO) == NULL);
+    assert(new_DurableQueue("/tmp/TestDurableQueue.invalid", -1, sizeof(long), DURABLE_QUEUE_SYNC_NONE, ZERO) == NULL);
+    assert(new_DurableQueue("/tmp/TestDurableQueue.invalid", DEFAULT_MAX_QUEUE_SIZE, ZERO, DURABLE_QUEUE_SYNC_NONE, ZERO) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that enqueueing and dequeueing a record works.
+*/
+int enqAndDeqOneRecord() {
+    long record = 10;
+    assert(DurableQueue_enq(queue, &record) == true);
+    assert(DurableQueue_size(queue) == ONE);
+    record = ZERO;
+    assert(DurableQueue_deq(queue, &record) == true);
+    assert(record == 10);
+    assert(DurableQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that NULL records are refused, that enqueueing into a full queue and dequeueing from an empty one fail.
+*/
+int enqWhenFullAndDeqWhenEmpty() {
+    long record;
+    assert(DurableQueue_enq(queue, NULL) == false);
+    assert(DurableQueue_deq(queue, &record) == false);
+    assert(enqRange(ONE, DEFAULT_MAX_QUEUE_SIZE));
+    assert(DurableQueue_enq(queue, &record) == false);
+    assert(DurableQueue_deq(queue, NULL) == false);
+    assert(DurableQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a batch is enqueued entirely or not at all.
+*/
+int enqBatchIsAllOrNothing() {
+    long records[DEFAULT_MAX_QUEUE_SIZE];
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        records[i] = i;
+    }
+    assert(DurableQueue_enqBatch(queue, records, FOUR) == true);
+    assert(DurableQueue_enqBatch(queue, records, DEFAULT_MAX_QUEUE_SIZE) == false);
+    assert(DurableQueue_size(queue) == FOUR);
+    assert(deqRange(ZERO, THREE));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that queued records are found again, in order, after the queue is closed and reopened.
+*/
+int recordsSurviveReopen() {
+    assert(enqRange(ONE, 5));
+    reopen();
+    assert(queue != NULL);
+    assert(DurableQueue_recovered(queue) == 5);
+    assert(DurableQueue_size(queue) == 5);
+    assert(deqRange(ONE, 5));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that dequeued records are not delivered again after a reopen.
+*/
+int deqProgressSurvivesReopen() {
+    assert(enqRange(ONE, 5));
+    assert(deqRange(ONE, TWO));
+    reopen();
+    assert(DurableQueue_size(queue) == THREE);
+    assert(deqRange(THREE, 5));
+    assert(DurableQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that records wrapping around the end of the file are recovered in order.
+*/
+int wrappedRecordsSurviveReopen() {
+    assert(enqRange(ONE, DEFAULT_MAX_QUEUE_SIZE));
+    assert(deqRange(ONE, DEFAULT_MAX_QUEUE_SIZE - 5));
+    assert(enqRange(DEFAULT_MAX_QUEUE_SIZE + ONE, DEFAULT_MAX_QUEUE_SIZE + 10));
+    reopen();
+    assert(DurableQueue_size(queue) == 5 + 10);
+    assert(deqRange(DEFAULT_MAX_QUEUE_SIZE - FOUR, DEFAULT_MAX_QUEUE_SIZE + 10));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that recovery stops at the first record whose checksum does not match.
+*/
+int corruptedRecordEndsRecovery() {
+    assert(enqRange(ONE, 5));
+    DurableQueue_destroy(queue);
+
+    /** Flips a byte of the third record (the file layout is a 64 byte header then 24 byte slots: sequence, checksum, record).*/
+    int fd = open(queue_path, O_RDWR);
+    assert(fd >= ZERO);
+    unsigned char byte;
+    off_t offset = 64 + TWO * 24 + 16;
+    assert(pread(fd, &byte, ONE, offset) == ONE);
+    byte ^= 0xFF;
+    assert(pwrite(fd, &byte, ONE, offset) == ONE);
+    close(fd);
+
+    queue = new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE, sizeof(long), DURABLE_QUEUE_SYNC_BATCH, ZERO);
+    assert(queue != NULL);
+    assert(DurableQueue_recovered(queue) == TWO);
+    assert(deqRange(ONE, TWO));
+    assert(DurableQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Flips a byte of the record with the given sequence number in the closed queue file (the file layout is a 64 byte header
+ * then 24 byte slots: sequence, checksum, record).
+*/
+static bool corruptRecord(int sequence) {
+    int fd = open(queue_path, O_RDWR);
+    unsigned char byte;
+    off_t offset = 64 + (sequence % DEFAULT_MAX_QUEUE_SIZE) * 24 + 16;
+    bool flipped = fd >= ZERO && pread(fd, &byte, ONE, offset) == ONE;
+    byte ^= 0xFF;
+    flipped = flipped && pwrite(fd, &byte, ONE, offset) == ONE;
+    close(fd);
+    return flipped;
+}
+
+/**
+ * Checks that a corrupted record in the middle of a ring which wraps around ends recovery there: the records before it are
+ * kept and the valid records after it are dropped, never delivered after a gap.
+*/
+int corruptedRecordInWrappedRingEndsRecovery() {
+    assert(enqRange(ONE, DEFAULT_MAX_QUEUE_SIZE));
+    assert(deqRange(ONE, DEFAULT_MAX_QUEUE_SIZE - 5));
+    assert(enqRange(DEFAULT_MAX_QUEUE_SIZE + ONE, DEFAULT_MAX_QUEUE_SIZE + 10));
+    DurableQueue_destroy(queue);
+
+    /** Records are numbered from 1 and sequences from 0: corrupts the record enqueued 5th after the wrap.*/
+    assert(corruptRecord(DEFAULT_MAX_QUEUE_SIZE + FOUR));
+
+    queue = new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE, sizeof(long), DURABLE_QUEUE_SYNC_BATCH, ZERO);
+    assert(queue != NULL);
+    assert(DurableQueue_recovered(queue) == 5 + FOUR);
+    assert(deqRange(DEFAULT_MAX_QUEUE_SIZE - FOUR, DEFAULT_MAX_QUEUE_SIZE + FOUR));
+    assert(DurableQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a file left with the expected size and an all-zero header, as by a creator dying before writing its header,
+ * is created anew instead of being refused.
+*/
+int blankFileIsCreatedAnew() {
+    DurableQueue_destroy(queue);
+    unlink(queue_path);
+    int fd = open(queue_path, O_RDWR | O_CREAT, 0600);
+    assert(fd >= ZERO);
+    assert(ftruncate(fd, 64 + DEFAULT_MAX_QUEUE_SIZE * 24) == ZERO);
+    close(fd);
+
+    queue = new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE, sizeof(long), DURABLE_QUEUE_SYNC_BATCH, ZERO);
+    assert(queue != NULL);
+    assert(DurableQueue_isEmpty(queue) == true);
+    assert(enqRange(ONE, THREE));
+    reopen();
+    assert(deqRange(ONE, THREE));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the interval durability mode flushes the writes of a queue which went idle, without any later call.
+*/
+int intervalFlushesIdleQueue() {
+    DurableQueue_destroy(queue);
+    unlink(queue_path);
+    queue = new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE, sizeof(long), DURABLE_QUEUE_SYNC_INTERVAL, 10);
+    assert(queue != NULL);
+    assert(enqRange(ONE, THREE));
+
+    /** The flusher clears the dirty flag when it flushes, within a few intervals.*/
+    for (int i = ZERO; i < 5000 && atomic_load(&queue->dirty); i++) {
+        usleep(1000);
+    }
+    assert(atomic_load(&queue->dirty) == false);
+    reopen();
+    assert(deqRange(ONE, THREE));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a file created with another layout is refused.
+*/
+int mismatchedLayoutIsRefused() {
+    assert(new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE + ONE, sizeof(long), DURABLE_QUEUE_SYNC_NONE, ZERO) == NULL);
+    assert(new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE, sizeof(int), DURABLE_QUEUE_SYNC_NONE, ZERO) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that clearing the queue is durable.
+*/
+int clearSurvivesReopen() {
+    assert(enqRange(ONE, 5));
+    DurableQueue_clear(queue);
+    assert(DurableQueue_isEmpty(queue) == true);
+    reopen();
+    assert(DurableQueue_isEmpty(queue) == true);
+    assert(enqRange(6, 6));
+    assert(deqRange(6, 6));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the interval and none durability modes keep records across a reopen.
+*/
+int otherSyncModesSurviveReopen() {
+    DurableQueueSync modes[] = {DURABLE_QUEUE_SYNC_INTERVAL, DURABLE_QUEUE_SYNC_NONE};
+    for (int i = ZERO; i < TWO; i++) {
+        DurableQueue_destroy(queue);
+        unlink(queue_path);
+        queue = new_DurableQueue(queue_path, DEFAULT_MAX_QUEUE_SIZE, sizeof(long), modes[i], 10);
+        assert(queue != NULL);
+        assert(enqRange(ONE, THREE));
+        assert(deqRange(ONE, ONE));
+        reopen();
+        assert(DurableQueue_size(queue) == TWO);
+        assert(deqRange(TWO, THREE));
+    }
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the DurableQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(newQueueSizeZero);
+
+    runTest(invalidQueuesAreNull);
+
+    runTest(enqAndDeqOneRecord);
+
+    runTest(enqWhenFullAndDeqWhenEmpty);
+
+    runTest(enqBatchIsAllOrNothing);
+
+    runTest(recordsSurviveReopen);
+
+    runTest(deqProgressSurvivesReopen);
+
+    runTest(wrappedRecordsSurviveReopen);
+
+    runTest(corruptedRecordEndsRecovery);
+
+    runTest(corruptedRecordInWrappedRingEndsRecovery);
+
+    runTest(blankFileIsCreatedAnew);
+
+    runTest(intervalFlushesIdleQueue);
+
+    runTest(mismatchedLayoutIsRefused);
+
+    runTest(clearSurvivesReopen);
+
+    runTest(otherSyncModesSurviveReopen);
+
+    printf("\nDurableQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
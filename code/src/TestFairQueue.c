@@ -0,0 +1,313 @@
+/*
+ * TestFairQueue.c
+ *
+ * Very simple unit test file for FairQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "FairQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_TENANTS 3
+#define DEFAULT_CAPACITY 8
+
+/** Number of elements enqueued by each producer, one producer per tenant, in the concurrent test.*/
+#define ELEMENTS_PER_TENANT 20000
+
+/*
+ * The queue to use during tests
+ */
+static FairQueue *queue;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_FairQueue(DEFAULT_TENANTS, DEFAULT_CAPACITY);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    FairQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Thread dequeuing one element and returning it.
+*/
+void* dequeueThread(void* unused) {
+    (void)unused;
+    return FairQueue_deq(queue, NULL);
+}
+
+/**
+ * Thread enqueuing the element passed as argument for tenant 0.
+*/
+void* enqueueThread(void* element) {
+    FairQueue_enq(queue, ZERO, element);
+    return NULL;
+}
+
+/**
+ * Producer of the concurrent test, enqueuing the integers 1 to ELEMENTS_PER_TENANT for the tenant passed as argument.
+*/
+void* producerThread(void* tenant) {
+    for (intptr_t i = ONE; i <= ELEMENTS_PER_TENANT; i++) {
+        FairQueue_enq(queue, (int)(intptr_t)tenant, (void*)i);
+    }
+    return NULL;
+}
+
+
+/*
+ * Checks that the constructor returns an empty queue, and refuses invalid tenant counts and capacities.
+ */
+int newQueueIsEmpty() {
+    assert(queue != NULL);
+    assert(new_FairQueue(ZERO, DEFAULT_CAPACITY) == NULL);
+    assert(new_FairQueue(FAIR_MAX_TENANTS + ONE, DEFAULT_CAPACITY) == NULL);
+    assert(new_FairQueue(DEFAULT_TENANTS, ZERO) == NULL);
+    assert(FairQueue_size(queue) == ZERO);
+    assert(FairQueue_tryDeq(queue, NULL) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that unknown tenants, NULL elements, and invalid weights and capacities are refused.
+*/
+int invalidArgumentsAreRefused() {
+    int a = 1;
+    assert(FairQueue_enq(queue, -1, &a) == false);
+    assert(FairQueue_enq(queue, DEFAULT_TENANTS, &a) == false);
+    assert(FairQueue_enq(queue, ZERO, NULL) == false);
+    assert(FairQueue_setWeight(queue, ZERO, ZERO) == false);
+    assert(FairQueue_setWeight(queue, DEFAULT_TENANTS, ONE) == false);
+    assert(FairQueue_setCapacity(queue, ZERO, ZERO) == false);
+    assert(FairQueue_setCapacity(queue, ZERO, DEFAULT_CAPACITY + ONE) == false);
+    assert(FairQueue_tenantSize(queue, DEFAULT_TENANTS) == ZERO);
+    assert(FairQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that tenants with equal weights take turns, each keeping its own FIFO order.
+*/
+int equalWeightsTakeTurns() {
+    int tenant;
+    for (int t = ZERO; t < DEFAULT_TENANTS; t++) {
+        for (intptr_t i = ONE; i <= THREE; i++) {
+            assert(FairQueue_enq(queue, t, (void*)(t * 10 + i)) == true);
+        }
+    }
+    assert(FairQueue_size(queue) == DEFAULT_TENANTS * THREE);
+    for (intptr_t i = ONE; i <= THREE; i++) {
+        for (int t = ZERO; t < DEFAULT_TENANTS; t++) {
+            assert(FairQueue_deq(queue, &tenant) == (void*)(t * 10 + i));
+            assert(tenant == t);
+        }
+    }
+    assert(FairQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that each turn lets a tenant dequeue as many elements as its weight.
+*/
+int weightsSetTheShares() {
+    int tenant;
+    int expected[] = {0, 0, 0, 1, 0, 0, 0, 1, 1, 1};
+    assert(FairQueue_setWeight(queue, ZERO, THREE) == true);
+    for (intptr_t i = ONE; i <= 6; i++) {
+        FairQueue_enq(queue, ZERO, (void*)i);
+        FairQueue_enq(queue, ONE, (void*)i);
+    }
+    for (int i = ZERO; i < 10; i++) {
+        assert(FairQueue_deq(queue, &tenant) != NULL);
+        assert(tenant == expected[i]);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a noisy tenant is held to its capacity limit, and that the others' elements do not queue behind its backlog.
+*/
+int noisyTenantIsIsolated() {
+    int tenant;
+    assert(FairQueue_setCapacity(queue, ZERO, TWO) == true);
+    assert(FairQueue_tryEnq(queue, ZERO, (void*)(intptr_t)ONE) == true);
+    assert(FairQueue_tryEnq(queue, ZERO, (void*)(intptr_t)TWO) == true);
+    assert(FairQueue_tryEnq(queue, ZERO, (void*)(intptr_t)THREE) == false);
+    assert(FairQueue_tenantSize(queue, ZERO) == TWO);
+
+    /** The quiet tenant's element comes out after one element of the noisy one, not after its whole backlog.*/
+    assert(FairQueue_tryEnq(queue, TWO, (void*)(intptr_t)42) == true);
+    assert(FairQueue_deq(queue, &tenant) == (void*)(intptr_t)ONE);
+    assert(FairQueue_deq(queue, &tenant) == (void*)(intptr_t)42);
+    assert(tenant == TWO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that idle tenants are skipped, whichever bits of the bitmap are set.
+*/
+int idleTenantsAreSkipped() {
+    int tenant;
+    FairQueue *wide = new_FairQueue(FAIR_MAX_TENANTS, DEFAULT_CAPACITY);
+    FairQueue_enq(wide, FAIR_MAX_TENANTS - ONE, (void*)(intptr_t)ONE);
+    FairQueue_enq(wide, FAIR_MAX_TENANTS - ONE, (void*)(intptr_t)TWO);
+    FairQueue_enq(wide, 5, (void*)(intptr_t)THREE);
+    assert(FairQueue_tryDeq(wide, &tenant) == (void*)(intptr_t)THREE);
+    assert(tenant == 5);
+    assert(FairQueue_tryDeq(wide, &tenant) == (void*)(intptr_t)ONE);
+    assert(tenant == FAIR_MAX_TENANTS - ONE);
+    assert(FairQueue_tryDeq(wide, &tenant) == (void*)(intptr_t)TWO);
+    assert(FairQueue_tryDeq(wide, &tenant) == NULL);
+    FairQueue_destroy(wide);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a deq on an empty queue waits for an enq, and that an enq on a full sub-ring waits for a deq.
+*/
+int blockedThreadsAreWoken() {
+    pthread_t dequeuingThread, enqueuingThread;
+    void *result;
+    pthread_create(&dequeuingThread, NULL, dequeueThread, NULL);
+    while (atomic_load(&queue->waiting_consumers) == ZERO) {
+        sched_yield();
+    }
+    FairQueue_enq(queue, ONE, (void*)(intptr_t)7);
+    pthread_join(dequeuingThread, &result);
+    assert(result == (void*)(intptr_t)7);
+
+    for (intptr_t i = ONE; i <= DEFAULT_CAPACITY; i++) {
+        FairQueue_enq(queue, ZERO, (void*)i);
+    }
+    pthread_create(&enqueuingThread, NULL, enqueueThread, (void*)(intptr_t)100);
+    sched_yield();
+    assert(FairQueue_tenantSize(queue, ZERO) == DEFAULT_CAPACITY);
+    assert(FairQueue_deq(queue, NULL) == (void*)(intptr_t)ONE);
+    pthread_join(enqueuingThread, NULL);
+    assert(FairQueue_tenantSize(queue, ZERO) == DEFAULT_CAPACITY);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a burst of elements for one tenant wakes as many sleeping consumers as it has elements, even when the producer
+ * of the first element only signals once the whole burst is queued.
+*/
+int burstWakesEveryConsumer() {
+    pthread_t consumers[FOUR], producer;
+    void *results[FOUR];
+    for (int i = ZERO; i < FOUR; i++) {
+        pthread_create(&consumers[i], NULL, dequeueThread, NULL);
+    }
+    while (atomic_load(&queue->waiting_consumers) < FOUR) {
+        sched_yield();
+    }
+
+    /** Holding the consumers' mutex delays the producer's signal, and the later elements find the sub-ring non-empty.*/
+    pthread_mutex_lock(&queue->mutex);
+    pthread_create(&producer, NULL, enqueueThread, (void*)(intptr_t)ONE);
+    while (FairQueue_tenantSize(queue, ZERO) == ZERO) {
+        sched_yield();
+    }
+    for (intptr_t i = TWO; i <= FOUR; i++) {
+        FairQueue_enq(queue, ZERO, (void*)i);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    pthread_join(producer, NULL);
+
+    intptr_t sum = ZERO;
+    for (int i = ZERO; i < FOUR; i++) {
+        pthread_join(consumers[i], &results[i]);
+        sum += (intptr_t)results[i];
+    }
+    assert(sum == ONE + TWO + THREE + FOUR);
+    assert(FairQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that with a producer per tenant every element comes out once, in FIFO order within its tenant.
+*/
+int concurrentTenantsLoseNothing() {
+    pthread_t producers[DEFAULT_TENANTS];
+    intptr_t last[DEFAULT_TENANTS] = {ZERO};
+    int out_of_order = ZERO;
+    for (int t = ZERO; t < DEFAULT_TENANTS; t++) {
+        pthread_create(&producers[t], NULL, producerThread, (void*)(intptr_t)t);
+    }
+    for (int i = ZERO; i < DEFAULT_TENANTS * ELEMENTS_PER_TENANT; i++) {
+        int tenant;
+        intptr_t element = (intptr_t)FairQueue_deq(queue, &tenant);
+        if (element != last[tenant] + ONE) {
+            out_of_order++;
+        }
+        last[tenant] = element;
+    }
+    for (int t = ZERO; t < DEFAULT_TENANTS; t++) {
+        pthread_join(producers[t], NULL);
+    }
+    assert(out_of_order == ZERO);
+    assert(FairQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the FairQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsEmpty);
+
+    runTest(invalidArgumentsAreRefused);
+
+    runTest(equalWeightsTakeTurns);
+
+    runTest(weightsSetTheShares);
+
+    runTest(noisyTenantIsIsolated);
+
+    runTest(idleTenantsAreSkipped);
+
+    runTest(blockedThreadsAreWoken);
+
+    runTest(burstWakesEveryConsumer);
+
+    runTest(concurrentTenantsLoseNothing);
+
+    printf("\nFairQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
@@ -0,0 +1,155 @@
+/*
+ * TestHugePages.c
+ *
+ * Very simple unit test file for HugePages functionality.
+ *
+ * Whether huge pages are available depends on the machine, so the tests accept every kind of backing.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "HugePages.h"
+#include "myassert.h"
+
+
+/** Number of slots of the queues under test, large enough to need several huge pages.*/
+#define DEFAULT_MAX_QUEUE_SIZE (1 << 19)
+
+/*
+ * The queue to use during tests
+ */
+static Queue *queue;
+
+/*
+ * The kind of pages backing the queue
+ */
+static int backing;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_HugePageQueue(DEFAULT_MAX_QUEUE_SIZE, &backing);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    HugePageQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+
+/*
+ * Checks that the HugePageQueue constructor returns a non-NULL pointer and reports its backing.
+ */
+int newQueueIsNotNull() {
+    assert(queue != NULL);
+    assert(backing == HUGE_PAGES_EXPLICIT || backing == HUGE_PAGES_TRANSPARENT || backing == HUGE_PAGES_NONE);
+    assert(Queue_isEmpty(queue) == true);
+    assert(new_HugePageQueue(ZERO, NULL) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the memory is zeroed, aligned to a huge page and writable up to the rounded size.
+*/
+int allocIsAlignedAndWritable() {
+    int kind;
+    size_t size = HUGE_PAGES_SIZE + ONE;
+    unsigned char *memory = HugePages_alloc(size, &kind);
+    assert(memory != NULL);
+    assert((uintptr_t)memory % HUGE_PAGES_SIZE == ZERO);
+    assert(memory[ZERO] == ZERO && memory[TWO * HUGE_PAGES_SIZE - ONE] == ZERO);
+    memory[ZERO] = memory[TWO * HUGE_PAGES_SIZE - ONE] = ONE;
+    HugePages_free(memory, size);
+    assert(HugePages_alloc(ZERO, &kind) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that every slot of a huge page backed Queue is used in FIFO order, wrapping around once.
+*/
+int fillAndCycleEverySlot() {
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(Queue_enq(queue, (void*)i) == true);
+    }
+    assert(Queue_enq(queue, (void*)(intptr_t)ONE) == false);
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert((intptr_t)Queue_deq(queue) == i);
+        assert(Queue_enq(queue, (void*)i) == true);
+    }
+    assert(Queue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread to dequeue one element from the given BlockingQueue.
+*/
+void* blockingDeqThread(void* blocking_queue) {
+    pthread_exit(BlockingQueue_deq((BlockingQueue*)blocking_queue));
+}
+
+/**
+ * Checks that a huge page backed BlockingQueue wakes a waiting thread.
+*/
+int blockingQueueWorks() {
+    int element = 7, kind;
+    BlockingQueue *blocking = new_HugePageBlockingQueue(DEFAULT_MAX_QUEUE_SIZE, &kind);
+    assert(blocking != NULL);
+
+    pthread_t dequeuingThread;
+    void *result;
+    pthread_create(&dequeuingThread, NULL, blockingDeqThread, blocking);
+    assert(BlockingQueue_enq(blocking, &element) == true);
+    pthread_join(dequeuingThread, &result);
+
+    assert(result == &element);
+    assert(BlockingQueue_isEmpty(blocking) == true);
+    HugePageBlockingQueue_destroy(blocking);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the HugePages tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(allocIsAlignedAndWritable);
+
+    runTest(fillAndCycleEverySlot);
+
+    runTest(blockingQueueWorks);
+
+    printf("\nHugePages Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
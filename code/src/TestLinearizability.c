@@ -0,0 +1,671 @@
+/*
+ * TestLinearizability.c
+ *
+ * Randomized stress test checking that the histories of concurrent BlockingQueue operations are linearizable.
+ *
+ * Worker threads run random programs of enq, deq, size and clear against a fresh BlockingQueue. Every
+ * operation is stamped from a shared counter when it is invoked and when it returns, giving a history which is then checked
+ * with the Wing and Gong algorithm, memoized as in Lowe's variant, against a sequential model built on Queue.c.
+ *
+ * A blocking operation which nothing will ever complete would hang the round, so the main thread watches the workers: when
+ * all of them sleep without progress, it performs a filler enq or deq itself, recorded in the history like any other operation.
+ *
+ * A failing history is written to linearizability_failure.log together with the seed and the round. --replay checks the logged
+ * history again, it does not rerun its interleaving; --seed reruns the same programs, under whatever interleaving the scheduler
+ * gives them this time.
+ *
+ * Every history goes through the exponential search of the checker, which bounds the throughput to some hundreds of thousands
+ * of checked operations per run of a few seconds, rather than millions per second.
+ *
+ * Telling that the workers sleep needs /proc, so the harness is meant for Linux; elsewhere the main thread assumes they do
+ * after a few milliseconds without progress.
+ *
+ * Usage: TestLinearizability [--rounds N] [--seed S] [--replay FILE]
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "BlockingQueue.h"
+#include "myassert.h"
+
+
+/** Shape of a round: worker threads, operations each of them runs, and the most filler operations the main thread may add.*/
+#define THREADS 3
+#define OPS_PER_THREAD 6
+#define MAX_FILLERS (THREADS * OPS_PER_THREAD)
+#define MAX_OPS (THREADS * OPS_PER_THREAD + MAX_FILLERS)
+
+/** Default number of rounds of each randomized test.*/
+#define DEFAULT_ROUNDS 20000
+
+/** Capacities of the queues under test: a small one so that enqs block, and one no round can fill.*/
+#define SMALL_QUEUE_SIZE 3
+#define LARGE_QUEUE_SIZE MAX_OPS
+
+/** Entries of the memoization table of the checker, a power of two.*/
+#define MEMO_SIZE 4096
+
+/** File failing histories are written to.*/
+#define FAILURE_LOG "linearizability_failure.log"
+
+/** Operations of a history.*/
+#define OP_ENQ 0
+#define OP_DEQ 1
+#define OP_SIZE 2
+#define OP_CLEAR 3
+
+/*
+ * One operation of a history: what it did and when, on the shared counter, it was invoked and returned.
+ */
+typedef struct HistoryOp {
+    int thread;
+    int kind;
+    intptr_t argument;
+    intptr_t result;
+    long invoked, responded;
+} HistoryOp;
+
+/*
+ * A complete history, with the parameters needed to replay it.
+ */
+typedef struct History {
+    HistoryOp ops[MAX_OPS];
+    int count;
+    int max_size;
+    unsigned long seed;
+    int round;
+    bool clear;
+} History;
+
+/*
+ * Entry of the memoization table: a set of linearized operations and the hash of the model state they led to.
+ */
+typedef struct MemoEntry {
+    unsigned int generation;
+    uint64_t mask;
+    uint64_t state;
+} MemoEntry;
+
+/*
+ * The queue under test and the storage of its slots, reinitialized for every round.
+ */
+static BlockingQueue queue;
+static void *queue_storage[LARGE_QUEUE_SIZE];
+
+/*
+ * Round shared with the workers: their programs and records, and the counters the main thread watches.
+ */
+static HistoryOp programs[THREADS][OPS_PER_THREAD];
+static bool yields[THREADS][OPS_PER_THREAD];
+#ifdef __linux__
+static pid_t worker_tids[THREADS];
+#endif
+static pthread_barrier_t round_start;
+static _Atomic long ticks;
+static _Atomic long completed_ops;
+static _Atomic int finished_workers;
+static _Atomic bool worker_finished[THREADS];
+static _Atomic bool stopping;
+
+/*
+ * Model states along the current path of the checker, and its memoization table.
+ */
+static Queue models[MAX_OPS + 1];
+static void *model_storage[MAX_OPS + 1][LARGE_QUEUE_SIZE];
+static MemoEntry memo[MEMO_SIZE];
+static unsigned int memo_generation;
+
+/*
+ * Command line options.
+ */
+static int rounds = DEFAULT_ROUNDS;
+static unsigned long base_seed;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Returns the next number of a xorshift generator.
+*/
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+#ifdef __linux__
+/**
+ * Returns the scheduling state letter of the given thread of this process, or '?' if /proc cannot tell.
+*/
+static char thread_state(pid_t tid) {
+    char path[64], stat[256];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/stat", (int)tid);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return '?';
+    }
+    size_t length = fread(stat, ONE, sizeof(stat) - ONE, file);
+    fclose(file);
+    stat[length] = '\0';
+    char *end = strrchr(stat, ')');
+    return (end != NULL && end[ONE] == ' ') ? end[TWO] : '?';
+}
+#endif
+
+/**
+ * Copies the model state from into to, over the storage of to.
+*/
+static void copy_model(Queue* to, void** storage, Queue* from) {
+    Queue_init(to, from->max_size, storage);
+    memcpy(storage, from->array, from->max_size * sizeof(void*));
+    to->front = from->front;
+    to->rear = from->rear;
+    to->current_size = from->current_size;
+}
+
+/**
+ * Returns a hash of the elements of the model, front to rear.
+*/
+static uint64_t hash_model(Queue* model) {
+    uint64_t hash = (uint64_t)model->current_size + 1469598103934665603ULL;
+    for (int i = ZERO; i < model->current_size; i++) {
+        hash = (hash ^ (uint64_t)(intptr_t)((void**)model->array)[(model->front + i) % model->max_size]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Applies an operation to the model.
+ * Returns false if the sequential queue could not have returned the recorded result.
+*/
+static bool apply_model(Queue* model, HistoryOp* op) {
+    switch (op->kind) {
+        case OP_ENQ:
+            /** A blocking enq cannot take effect on a full queue.*/
+            return Queue_enq(model, (void*)op->argument) == (bool)op->result;
+        case OP_DEQ:
+            /** Nor a blocking deq on an empty one.*/
+            return !Queue_isEmpty(model) && (intptr_t)Queue_deq(model) == op->result;
+        case OP_SIZE:
+            return Queue_size(model) == op->result;
+        default:
+            Queue_clear(model);
+            return true;
+    }
+}
+
+/**
+ * Returns true, and records the pair, if the given linearized set and model state were not explored yet.
+*/
+static bool memo_insert(uint64_t mask, uint64_t state) {
+    uint64_t index = (mask * 0x9E3779B97F4A7C15ULL ^ state) & (MEMO_SIZE - ONE);
+    for (int probe = ZERO; probe < MEMO_SIZE; probe++) {
+        MemoEntry *entry = &memo[(index + probe) & (MEMO_SIZE - ONE)];
+        if (entry->generation != memo_generation) {
+            entry->generation = memo_generation;
+            entry->mask = mask;
+            entry->state = state;
+            return true;
+        }
+        if (entry->mask == mask && entry->state == state) {
+            return false;
+        }
+    }
+    /** A full table only costs the memoization, the search stays exhaustive.*/
+    return true;
+}
+
+/**
+ * Looks for an order of the operations not in mask, consistent with real time, under which the model returns the recorded results.
+*/
+static bool search(History* history, uint64_t mask, int depth) {
+    uint64_t all = (history->count == 64) ? ~(uint64_t)ZERO : (((uint64_t)ONE << history->count) - ONE);
+    if (mask == all) {
+        return true;
+    }
+
+    /** Only an operation invoked before every remaining operation returned may come next.*/
+    long first_response = INT64_MAX;
+    for (int i = ZERO; i < history->count; i++) {
+        if (!(mask & ((uint64_t)ONE << i)) && history->ops[i].responded < first_response) {
+            first_response = history->ops[i].responded;
+        }
+    }
+
+    for (int i = ZERO; i < history->count; i++) {
+        uint64_t bit = (uint64_t)ONE << i;
+        if ((mask & bit) || history->ops[i].invoked > first_response) {
+            continue;
+        }
+        copy_model(&models[depth + ONE], model_storage[depth + ONE], &models[depth]);
+        if (apply_model(&models[depth + ONE], &history->ops[i])
+                && memo_insert(mask | bit, hash_model(&models[depth + ONE]))
+                && search(history, mask | bit, depth + ONE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns true if the history is linearizable with respect to a sequential queue of the same capacity.
+*/
+static bool is_linearizable(History* history) {
+    memo_generation++;
+    Queue_init(&models[ZERO], history->max_size, model_storage[ZERO]);
+    return search(history, ZERO, ZERO);
+}
+
+/**
+ * Writes a history to the given file, in the format read by load_history.
+*/
+static void save_history(History* history, const char* path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror("Error: failed to open the failure log");
+        return;
+    }
+    fprintf(file, "seed %lu round %d max_size %d clear %d\n", history->seed, history->round, history->max_size, (int)history->clear);
+    for (int i = ZERO; i < history->count; i++) {
+        HistoryOp *op = &history->ops[i];
+        fprintf(file, "op %d %d %ld %ld %ld %ld\n", op->thread, op->kind, (long)op->argument, (long)op->result, op->invoked, op->responded);
+    }
+    fclose(file);
+}
+
+/**
+ * Reads a history written by save_history.
+ * Returns false if the file cannot be read.
+*/
+static bool load_history(History* history, const char* path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    int clear;
+    bool loaded = fscanf(file, "seed %lu round %d max_size %d clear %d\n", &history->seed, &history->round, &history->max_size, &clear) == FOUR
+            && history->max_size > ZERO && history->max_size <= LARGE_QUEUE_SIZE;
+    history->clear = clear;
+    history->count = ZERO;
+    long argument, result;
+    HistoryOp *op = &history->ops[ZERO];
+    while (loaded && history->count < MAX_OPS
+            && fscanf(file, "op %d %d %ld %ld %ld %ld\n", &op->thread, &op->kind, &argument, &result, &op->invoked, &op->responded) == 6) {
+        op->argument = argument;
+        op->result = result;
+        op = &history->ops[++history->count];
+    }
+    fclose(file);
+    return loaded;
+}
+
+/**
+ * Runs an operation on the queue under test, stamping its invocation and response.
+*/
+static void run_operation(HistoryOp* op) {
+    op->invoked = atomic_fetch_add(&ticks, ONE);
+    switch (op->kind) {
+        case OP_ENQ:
+            op->result = BlockingQueue_enq(&queue, (void*)op->argument);
+            break;
+        case OP_DEQ:
+            op->result = (intptr_t)BlockingQueue_deq(&queue);
+            break;
+        case OP_SIZE:
+            op->result = BlockingQueue_size(&queue);
+            break;
+        default:
+            BlockingQueue_clear(&queue);
+            op->result = ZERO;
+            break;
+    }
+    op->responded = atomic_fetch_add(&ticks, ONE);
+}
+
+/**
+ * Worker thread running its program of every round.
+*/
+void* workerThread(void* index) {
+    int thread = (int)(intptr_t)index;
+#ifdef __linux__
+    worker_tids[thread] = (pid_t)syscall(SYS_gettid);
+#endif
+    while (true) {
+        pthread_barrier_wait(&round_start);
+        if (atomic_load(&stopping)) {
+            break;
+        }
+        for (int i = ZERO; i < OPS_PER_THREAD; i++) {
+            run_operation(&programs[thread][i]);
+            atomic_fetch_add(&completed_ops, ONE);
+            if (yields[thread][i]) {
+                sched_yield();
+            }
+        }
+        atomic_store(&worker_finished[thread], true);
+        atomic_fetch_add(&finished_workers, ONE);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Generates the programs of a round.
+*/
+static void generate_programs(uint64_t* random, bool clear) {
+    for (int thread = ZERO; thread < THREADS; thread++) {
+        for (int i = ZERO; i < OPS_PER_THREAD; i++) {
+            HistoryOp *op = &programs[thread][i];
+            int draw = (int)(next_random(random) % 100);
+            op->thread = thread;
+            op->kind = (clear && draw < 5) ? OP_CLEAR : (draw < 50) ? OP_ENQ : (draw < 85) ? OP_DEQ : OP_SIZE;
+            op->argument = (op->kind == OP_ENQ) ? (intptr_t)(thread * 100 + i + ONE) : ZERO;
+            yields[thread][i] = (next_random(random) % FOUR) == ZERO;
+        }
+    }
+}
+
+/**
+ * Returns true when every worker which has not finished its program is asleep, blocked on the queue.
+*/
+static bool workers_blocked(void) {
+#ifdef __linux__
+    for (int thread = ZERO; thread < THREADS; thread++) {
+        if (!atomic_load(&worker_finished[thread]) && thread_state(worker_tids[thread]) != 'S') {
+            return false;
+        }
+    }
+#else
+    /** Without /proc, gives the workers time to make progress, which the caller checks they did not.*/
+    struct timespec pause = {0, 5000000};
+    nanosleep(&pause, NULL);
+#endif
+    return true;
+}
+
+/**
+ * Runs one round on a fresh queue of the given capacity and collects its history.
+ * Returns false if the workers stay blocked even after every filler operation.
+*/
+static bool run_round(History* history, int max_size) {
+    BlockingQueue_init(&queue, max_size, queue_storage);
+    atomic_store(&completed_ops, ZERO);
+    atomic_store(&finished_workers, ZERO);
+    for (int thread = ZERO; thread < THREADS; thread++) {
+        atomic_store(&worker_finished[thread], false);
+    }
+    history->count = ZERO;
+
+    pthread_barrier_wait(&round_start);
+
+    /** Unblocks operations nothing else would complete, an enq for a deq on an empty queue and a deq for an enq on a full one.*/
+    long last_progress = -ONE;
+    int fillers = ZERO;
+    while (atomic_load(&finished_workers) < THREADS) {
+        long progress = atomic_load(&completed_ops);
+        if (progress == last_progress && workers_blocked() && atomic_load(&completed_ops) == progress) {
+            if (fillers == MAX_FILLERS) {
+                return false;
+            }
+            HistoryOp *op = &history->ops[history->count++];
+            op->thread = THREADS;
+            op->kind = (BlockingQueue_size(&queue) == ZERO) ? OP_ENQ : OP_DEQ;
+            op->argument = (op->kind == OP_ENQ) ? (intptr_t)(10000 + fillers) : ZERO;
+            run_operation(op);
+            fillers++;
+        }
+        last_progress = progress;
+        sched_yield();
+    }
+
+    for (int thread = ZERO; thread < THREADS; thread++) {
+        for (int i = ZERO; i < OPS_PER_THREAD; i++) {
+            history->ops[history->count++] = programs[thread][i];
+        }
+    }
+    BlockingQueue_deinit(&queue);
+    return true;
+}
+
+/**
+ * Runs randomized rounds against queues of the given capacity, writing the first failing history to FAILURE_LOG.
+ * Returns true if every history is linearizable.
+*/
+static bool check_rounds(int max_size, bool clear, unsigned long seed) {
+    pthread_t workers[THREADS];
+    pthread_barrier_init(&round_start, NULL, THREADS + ONE);
+    atomic_store(&stopping, false);
+    for (int thread = ZERO; thread < THREADS; thread++) {
+        pthread_create(&workers[thread], NULL, workerThread, (void*)(intptr_t)thread);
+    }
+
+    static History history;
+    history.max_size = max_size;
+    history.seed = seed;
+    history.clear = clear;
+    bool success = true;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long operations = ZERO;
+
+    for (int round = ZERO; round < rounds && success; round++) {
+        uint64_t random = (seed + (uint64_t)round) * 0x9E3779B97F4A7C15ULL + ONE;
+        generate_programs(&random, clear);
+        history.round = round;
+        if (!run_round(&history, max_size)) {
+            /** The workers are stuck for good, they cannot be joined: the log is the only useful output left.*/
+            save_history(&history, FAILURE_LOG);
+            printf("Round %d of seed %lu deadlocked, history written to %s\n", round, seed, FAILURE_LOG);
+            exit(EXIT_FAILURE);
+        }
+        operations += history.count;
+        if (!is_linearizable(&history)) {
+            save_history(&history, FAILURE_LOG);
+            printf("Round %d of seed %lu is not linearizable, history written to %s\n", round, seed, FAILURE_LOG);
+            success = false;
+        }
+    }
+
+    atomic_store(&stopping, true);
+    pthread_barrier_wait(&round_start);
+    for (int thread = ZERO; thread < THREADS; thread++) {
+        pthread_join(workers[thread], NULL);
+    }
+    pthread_barrier_destroy(&round_start);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Checked %ld operations on capacity %d%s in %.2f s\n", operations, max_size, clear ? " with clear" : "", seconds);
+    return success;
+}
+
+/**
+ * Adds an operation to a handwritten history.
+*/
+static void add_op(History* history, int thread, int kind, intptr_t argument, intptr_t result, long invoked, long responded) {
+    HistoryOp *op = &history->ops[history->count++];
+    op->thread = thread;
+    op->kind = kind;
+    op->argument = argument;
+    op->result = result;
+    op->invoked = invoked;
+    op->responded = responded;
+}
+
+
+/**
+ * Checks that the checker accepts a history whose overlapping operations only fit in one order.
+*/
+int checkerAcceptsLinearizableHistory() {
+    static History history;
+    history.count = ZERO;
+    history.max_size = SMALL_QUEUE_SIZE;
+
+    /** The deq overlaps both enqs and returns the second one: only possible if the enq of 2 took effect first.*/
+    add_op(&history, ZERO, OP_ENQ, ONE, true, ZERO, 10);
+    add_op(&history, ONE, OP_ENQ, TWO, true, ONE, 3);
+    add_op(&history, TWO, OP_DEQ, ZERO, TWO, TWO, 11);
+    add_op(&history, ONE, OP_SIZE, ZERO, ONE, 12, 13);
+    assert(is_linearizable(&history) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the checker rejects a deq returning an element enqueued after the deq returned, and a wrong size.
+*/
+int checkerRejectsNonLinearizableHistories() {
+    static History history;
+    history.count = ZERO;
+    history.max_size = SMALL_QUEUE_SIZE;
+    add_op(&history, ZERO, OP_DEQ, ZERO, ONE, ZERO, ONE);
+    add_op(&history, ONE, OP_ENQ, ONE, true, TWO, THREE);
+    assert(is_linearizable(&history) == false);
+
+    history.count = ZERO;
+    add_op(&history, ZERO, OP_ENQ, ONE, true, ZERO, ONE);
+    add_op(&history, ONE, OP_SIZE, ZERO, TWO, TWO, THREE);
+    assert(is_linearizable(&history) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a history written to the failure log reads back identically.
+*/
+int historiesReplayFromTheLog() {
+    static History history, replayed;
+    history.count = ZERO;
+    history.max_size = SMALL_QUEUE_SIZE;
+    history.seed = 42;
+    history.round = 7;
+    history.clear = true;
+    add_op(&history, ZERO, OP_ENQ, ONE, true, ZERO, ONE);
+    add_op(&history, ONE, OP_CLEAR, ZERO, ZERO, TWO, THREE);
+    add_op(&history, TWO, OP_SIZE, ZERO, ZERO, FOUR, 5);
+
+    char path[] = "/tmp/linearizabilityXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= ZERO);
+    close(fd);
+    save_history(&history, path);
+    bool loaded = load_history(&replayed, path);
+    unlink(path);
+
+    assert(loaded == true);
+    assert(replayed.count == THREE && replayed.seed == 42 && replayed.round == 7 && replayed.clear == true);
+    assert(memcmp(replayed.ops, history.ops, THREE * sizeof(HistoryOp)) == ZERO);
+    assert(is_linearizable(&replayed) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks random histories on a small queue, where enqs block on a full queue and deqs on an empty one.
+*/
+int smallQueueHistoriesAreLinearizable() {
+    assert(check_rounds(SMALL_QUEUE_SIZE, false, base_seed) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks random histories on a queue which never fills up.
+*/
+int largeQueueHistoriesAreLinearizable() {
+    assert(check_rounds(LARGE_QUEUE_SIZE, false, base_seed + ONE) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks random histories which also clear the queue while other threads use it.
+*/
+int historiesWithClearAreLinearizable() {
+    assert(check_rounds(SMALL_QUEUE_SIZE, true, base_seed + TWO) == true);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the linearizability tests which will run each user-defined test in turn, or replay a logged history.
+ */
+
+int main(int argc, char** argv) {
+    base_seed = (unsigned long)time(NULL);
+    for (int i = ONE; i < argc; i++) {
+        if (!strcmp(argv[i], "--rounds") && i + ONE < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + ONE < argc) {
+            base_seed = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--replay") && i + ONE < argc) {
+            static History history;
+            if (!load_history(&history, argv[++i])) {
+                printf("Could not read the history in %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            bool linearizable = is_linearizable(&history);
+            printf("Round %d of seed %lu, %d operations: %s\n", history.round, history.seed, history.count,
+                    linearizable ? "linearizable" : "NOT linearizable");
+            return linearizable ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else {
+            printf("Usage: %s [--rounds N] [--seed S] [--replay FILE]\n", argv[ZERO]);
+            return EXIT_FAILURE;
+        }
+    }
+    printf("Seed %lu\n", base_seed);
+
+    runTest(checkerAcceptsLinearizableHistory);
+
+    runTest(checkerRejectsNonLinearizableHistories);
+
+    runTest(historiesReplayFromTheLog);
+
+    runTest(smallQueueHistoriesAreLinearizable);
+
+    runTest(largeQueueHistoriesAreLinearizable);
+
+    runTest(historiesWithClearAreLinearizable);
+
+    printf("\nLinearizability Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
@@ -0,0 +1,270 @@
+/*
+ * TestMailbox.c
+ *
+ * Very simple unit test file for Mailbox functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "Mailbox.h"
+#include "myassert.h"
+
+
+/** Number of words of the snapshots, and number of snapshots published in the concurrent tests.*/
+#define SNAPSHOT_WORDS 16
+#define PUBLISHES 50000
+
+/** Number of threads in the concurrent tests.*/
+#define CONCURRENT_THREADS 3
+
+/**
+ * Snapshot whose fields all hold the same number, so that a torn copy is easy to see.
+*/
+typedef struct {
+    long fields[SNAPSHOT_WORDS];
+} Snapshot;
+
+/*
+ * The mailbox to use during tests
+ */
+static Mailbox *mailbox;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    mailbox = new_Mailbox(sizeof(Snapshot));
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    Mailbox_destroy(mailbox);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Fills the given snapshot with the given number.
+*/
+void fillSnapshot(Snapshot* snapshot, long number) {
+    for (int i = ZERO; i < SNAPSHOT_WORDS; i++) {
+        snapshot->fields[i] = number;
+    }
+}
+
+/**
+ * Returns true if all the fields of the given snapshot hold the same number.
+*/
+bool isConsistent(Snapshot* snapshot) {
+    for (int i = ONE; i < SNAPSHOT_WORDS; i++) {
+        if (snapshot->fields[i] != snapshot->fields[ZERO]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Thread publishing PUBLISHES snapshots numbered from 1.
+*/
+void* publishingThread(void* unused) {
+    (void)unused;
+    Snapshot snapshot;
+    for (long i = ONE; i <= PUBLISHES; i++) {
+        fillSnapshot(&snapshot, i);
+        Mailbox_publish(mailbox, &snapshot);
+    }
+    return NULL;
+}
+
+/**
+ * Thread waiting for a version newer than 0 and returning the first field of the snapshot it got.
+*/
+void* waitingThread(void* unused) {
+    (void)unused;
+    Snapshot snapshot;
+    Mailbox_waitNewer(mailbox, ZERO, &snapshot);
+    return (void*)snapshot.fields[ZERO];
+}
+
+
+/*
+ * Checks that the constructor returns an empty mailbox, and refuses an empty value size.
+ */
+int newMailboxIsEmpty() {
+    Snapshot snapshot;
+    fillSnapshot(&snapshot, -1);
+    assert(mailbox != NULL);
+    assert(new_Mailbox(ZERO) == NULL);
+    assert(Mailbox_version(mailbox) == ZERO);
+    assert(Mailbox_read(mailbox, &snapshot) == ZERO);
+    assert(snapshot.fields[ZERO] == -1);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that publishes replace each other, and that a reader gets the latest value with its version.
+*/
+int readGetsTheLatestValue() {
+    Snapshot snapshot;
+    for (long i = ONE; i <= THREE; i++) {
+        fillSnapshot(&snapshot, i);
+        assert(Mailbox_publish(mailbox, &snapshot) == (unsigned long)i);
+    }
+    assert(Mailbox_publish(mailbox, NULL) == ZERO);
+
+    fillSnapshot(&snapshot, ZERO);
+    assert(Mailbox_read(mailbox, &snapshot) == THREE);
+    assert(snapshot.fields[ZERO] == THREE);
+    assert(isConsistent(&snapshot));
+
+    /** Reading does not consume the value.*/
+    assert(Mailbox_read(mailbox, &snapshot) == THREE);
+    assert(Mailbox_version(mailbox) == THREE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that values whose size is not a multiple of a word are copied exactly, without writing past them.
+*/
+int oddSizedValuesAreCopiedExactly() {
+    char buffer[8] = "zzzzzzz";
+    Mailbox *small = new_Mailbox(THREE);
+    assert(Mailbox_publish(small, "abc") == ONE);
+    assert(Mailbox_read(small, buffer) == ONE);
+    assert(buffer[ZERO] == 'a' && buffer[ONE] == 'b' && buffer[TWO] == 'c' && buffer[THREE] == 'z');
+    Mailbox_destroy(small);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that waitNewer returns at once when the value is already newer than the given version.
+*/
+int waitNewerReturnsANewerValueAtOnce() {
+    Snapshot snapshot;
+    fillSnapshot(&snapshot, 7);
+    Mailbox_publish(mailbox, &snapshot);
+    Mailbox_publish(mailbox, &snapshot);
+    fillSnapshot(&snapshot, ZERO);
+    assert(Mailbox_waitNewer(mailbox, ONE, &snapshot) == TWO);
+    assert(snapshot.fields[ZERO] == 7);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that waitNewer blocks the readers until the next publish, and wakes all of them.
+*/
+int waitNewerBlocksUntilPublish() {
+    Snapshot snapshot;
+    pthread_t readers[CONCURRENT_THREADS];
+    void *result;
+    for (int i = ZERO; i < CONCURRENT_THREADS; i++) {
+        pthread_create(&readers[i], NULL, waitingThread, NULL);
+    }
+
+    /** Waits until every reader has registered as waiting.*/
+    while (atomic_load(&mailbox->waiting) < CONCURRENT_THREADS) {
+        sched_yield();
+    }
+    fillSnapshot(&snapshot, 42);
+    Mailbox_publish(mailbox, &snapshot);
+    for (int i = ZERO; i < CONCURRENT_THREADS; i++) {
+        pthread_join(readers[i], &result);
+        assert(result == (void*)42);
+    }
+    assert(atomic_load(&mailbox->waiting) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a reader racing with a writer never sees a torn snapshot nor goes back in time.
+*/
+int readsAreNeverTorn() {
+    Snapshot snapshot;
+    pthread_t writer;
+    unsigned long last_version = ZERO;
+    long last_number = ZERO;
+    pthread_create(&writer, NULL, publishingThread, NULL);
+    while (last_number < PUBLISHES) {
+        unsigned long version = Mailbox_read(mailbox, &snapshot);
+        if (version == ZERO) {
+            continue;
+        }
+        assert(isConsistent(&snapshot));
+        assert(version >= last_version);
+        assert(snapshot.fields[ZERO] >= last_number);
+        assert(snapshot.fields[ZERO] == (long)version);
+        last_version = version;
+        last_number = snapshot.fields[ZERO];
+    }
+    pthread_join(writer, NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that concurrent writers take turns: every publish gets its own version and the last value is consistent.
+*/
+int concurrentWritersTakeTurns() {
+    Snapshot snapshot;
+    pthread_t writers[CONCURRENT_THREADS];
+    for (int i = ZERO; i < CONCURRENT_THREADS; i++) {
+        pthread_create(&writers[i], NULL, publishingThread, NULL);
+    }
+    for (int i = ZERO; i < CONCURRENT_THREADS; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    assert(Mailbox_read(mailbox, &snapshot) == (unsigned long)CONCURRENT_THREADS * PUBLISHES);
+    assert(isConsistent(&snapshot));
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the Mailbox tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newMailboxIsEmpty);
+
+    runTest(readGetsTheLatestValue);
+
+    runTest(oddSizedValuesAreCopiedExactly);
+
+    runTest(waitNewerReturnsANewerValueAtOnce);
+
+    runTest(waitNewerBlocksUntilPublish);
+
+    runTest(readsAreNeverTorn);
+
+    runTest(concurrentWritersTakeTurns);
+
+    printf("\nMailbox Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
@@ -0,0 +1,273 @@
+/*
+ * TestNumaQueue.c
+ *
+ * Very simple unit test file for NumaQueue functionality.
+ *
+ * The tests simulate several nodes, so they also run on machines with a single NUMA node.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "NumaQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_NODE_COUNT 4
+#define DEFAULT_MAX_SIZE_PER_NODE 8
+
+/** Number of elements enqueued by each producer of the multi-threaded test.*/
+#define STREAM_ELEMENTS 5000
+
+/*
+ * The queue to use during tests
+ */
+static NumaQueue *queue;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_NumaQueue(DEFAULT_NODE_COUNT, DEFAULT_MAX_SIZE_PER_NODE);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    NumaQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+
+/*
+ * Checks that the NumaQueue constructor returns a non-NULL pointer and refuses invalid sizes.
+ */
+int newQueueIsNotNull() {
+    assert(queue != NULL);
+    assert(NumaQueue_size(queue) == ZERO);
+    assert(new_NumaQueue(ZERO, DEFAULT_MAX_SIZE_PER_NODE) == NULL);
+    assert(new_NumaQueue(DEFAULT_NODE_COUNT, ZERO) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the topology of the machine is reported within range.
+*/
+int topologyIsInRange() {
+    assert(NumaQueue_nodeCount() >= ONE);
+    for (int nodes = ONE; nodes <= DEFAULT_NODE_COUNT; nodes++) {
+        int node = NumaQueue_currentNode(nodes);
+        assert(node >= ZERO && node < nodes);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that memory can be allocated on the first node and on a node the machine does not have.
+*/
+int allocOnRealAndSimulatedNodes() {
+    size_t size = 3 * 4096;
+    char *local = NumaQueue_alloc(size, ZERO);
+    char *simulated = NumaQueue_alloc(size, NUMA_QUEUE_MAX_NODES + ONE);
+    assert(local != NULL && simulated != NULL);
+    assert(local[ZERO] == ZERO && local[size - ONE] == ZERO);
+    local[ZERO] = simulated[size - ONE] = ONE;
+
+    /** The kernel either reports the first node, or cannot tell on this machine.*/
+    int node = NumaQueue_nodeOf(local);
+    assert(node == ZERO || node == -1);
+
+    NumaQueue_free(local, size);
+    NumaQueue_free(simulated, size);
+    assert(NumaQueue_alloc(ZERO, ZERO) == NULL);
+    assert(NumaQueue_alloc(size, -1) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a Queue bound to a node works like an allocated one.
+*/
+int queueOnNodeWorks() {
+    int elements[] = {1, 2};
+    for (int node = ZERO; node < TWO; node++) {
+        Queue *bound = new_QueueOnNode(TWO, node);
+        assert(bound != NULL);
+        assert(Queue_enq(bound, &elements[ZERO]) == true);
+        assert(Queue_enq(bound, &elements[ONE]) == true);
+        assert(Queue_enq(bound, &elements[ZERO]) == false);
+        assert(Queue_deq(bound) == &elements[ZERO]);
+        assert(Queue_deq(bound) == &elements[ONE]);
+        QueueOnNode_destroy(bound);
+    }
+    assert(new_QueueOnNode(ZERO, ZERO) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread to dequeue one element from the given BlockingQueue.
+*/
+void* blockingDeqThread(void* blocking_queue) {
+    pthread_exit(BlockingQueue_deq((BlockingQueue*)blocking_queue));
+}
+
+/**
+ * Checks that a BlockingQueue bound to a node wakes a waiting thread.
+*/
+int blockingQueueOnNodeWorks() {
+    int element = 7;
+    BlockingQueue *bound = new_BlockingQueueOnNode(TWO, ONE);
+    assert(bound != NULL);
+
+    pthread_t dequeuingThread;
+    void *result;
+    pthread_create(&dequeuingThread, NULL, blockingDeqThread, bound);
+    assert(BlockingQueue_enq(bound, &element) == true);
+    pthread_join(dequeuingThread, &result);
+
+    assert(result == &element);
+    assert(BlockingQueue_isEmpty(bound) == true);
+    BlockingQueueOnNode_destroy(bound);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that NULL elements and nodes out of range are refused.
+*/
+int invalidArgumentsAreRefused() {
+    int element = 1;
+    assert(NumaQueue_enq(queue, ZERO, NULL) == false);
+    assert(NumaQueue_enq(queue, -1, &element) == false);
+    assert(NumaQueue_enq(queue, DEFAULT_NODE_COUNT, &element) == false);
+    assert(NumaQueue_deq(queue, DEFAULT_NODE_COUNT) == NULL);
+    assert(NumaQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a consumer takes the elements of its own node before those of other nodes.
+*/
+int consumerPrefersLocalElements() {
+    int remote = 1, local = 2;
+    assert(NumaQueue_enq(queue, ZERO, &remote) == true);
+    assert(NumaQueue_enq(queue, TWO, &local) == true);
+    assert(NumaQueue_nodeSize(queue, TWO) == ONE);
+
+    assert(NumaQueue_deq(queue, TWO) == &local);
+    assert(NumaQueue_deqCount(queue, false) == ONE);
+    assert(NumaQueue_deqCount(queue, true) == ZERO);
+    assert(NumaQueue_size(queue) == ONE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a consumer steals from another node when its own sub-queue is empty.
+*/
+int consumerStealsWhenLocalIsEmpty() {
+    int first = 1, second = 2;
+    assert(NumaQueue_enq(queue, ONE, &first) == true);
+    assert(NumaQueue_enq(queue, ONE, &second) == true);
+
+    assert(NumaQueue_deq(queue, THREE) == &first);
+    assert(NumaQueue_deq(queue, ZERO) == &second);
+    assert(NumaQueue_deqCount(queue, true) == TWO);
+    assert(NumaQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread enqueuing the elements 1 to STREAM_ELEMENTS on the given node.
+*/
+void* producerThread(void* node) {
+    for (intptr_t i = ONE; i <= STREAM_ELEMENTS; i++) {
+        NumaQueue_enq(queue, (int)(intptr_t)node, (void*)i);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Thread dequeuing STREAM_ELEMENTS elements on the given node and returning their sum.
+*/
+void* consumerThread(void* node) {
+    intptr_t sum = ZERO;
+    for (int i = ZERO; i < STREAM_ELEMENTS; i++) {
+        sum += (intptr_t)NumaQueue_deq(queue, (int)(intptr_t)node);
+    }
+    pthread_exit((void*)sum);
+}
+
+/**
+ * Checks that every element enqueued by one producer per node is dequeued once by one consumer per node.
+*/
+int producersAndConsumersOnEveryNode() {
+    pthread_t producers[DEFAULT_NODE_COUNT], consumers[DEFAULT_NODE_COUNT];
+    for (intptr_t node = ZERO; node < DEFAULT_NODE_COUNT; node++) {
+        pthread_create(&consumers[node], NULL, consumerThread, (void*)node);
+        pthread_create(&producers[node], NULL, producerThread, (void*)node);
+    }
+
+    intptr_t total = ZERO;
+    for (int node = ZERO; node < DEFAULT_NODE_COUNT; node++) {
+        void *sum;
+        pthread_join(producers[node], NULL);
+        pthread_join(consumers[node], &sum);
+        total += (intptr_t)sum;
+    }
+
+    assert(total == (intptr_t)DEFAULT_NODE_COUNT * STREAM_ELEMENTS * (STREAM_ELEMENTS + ONE) / TWO);
+    assert(NumaQueue_deqCount(queue, false) + NumaQueue_deqCount(queue, true) == (long)DEFAULT_NODE_COUNT * STREAM_ELEMENTS);
+    assert(NumaQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the NumaQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(topologyIsInRange);
+
+    runTest(allocOnRealAndSimulatedNodes);
+
+    runTest(queueOnNodeWorks);
+
+    runTest(blockingQueueOnNodeWorks);
+
+    runTest(invalidArgumentsAreRefused);
+
+    runTest(consumerPrefersLocalElements);
+
+    runTest(consumerStealsWhenLocalIsEmpty);
+
+    runTest(producersAndConsumersOnEveryNode);
+
+    printf("\nNumaQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
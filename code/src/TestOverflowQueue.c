@@ -0,0 +1,299 @@
+/*
+ * TestOverflowQueue.c
+ *
+ * Very simple unit test file for OverflowQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "OverflowQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_QUEUE_SIZE 5
+
+/** Number of threads and of elements enqueued by each thread in the concurrent tests.*/
+#define CONCURRENT_THREADS 4
+#define ELEMENTS_PER_THREAD 20000
+
+/*
+ * The queue to use during tests
+ */
+static OverflowQueue *queue;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = NULL;
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    if (queue != NULL) {
+        OverflowQueue_destroy(queue);
+    }
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Thread dequeuing one element from the queue and returning it.
+*/
+void* dequeueThread(void* unused) {
+    (void)unused;
+    return OverflowQueue_deq(queue);
+}
+
+/**
+ * Thread enqueuing the element passed as argument.
+*/
+void* enqueueThread(void* element) {
+    OverflowQueue_enq(queue, element);
+    return NULL;
+}
+
+/**
+ * Thread enqueuing the integers 1 to ELEMENTS_PER_THREAD.
+*/
+void* producerThread(void* unused) {
+    (void)unused;
+    for (intptr_t i = ONE; i <= ELEMENTS_PER_THREAD; i++) {
+        OverflowQueue_enq(queue, (void*)i);
+    }
+    return NULL;
+}
+
+
+/*
+ * Checks that the constructor returns an empty queue.
+ */
+int newQueueIsNotNull() {
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_BLOCK);
+    assert(queue != NULL);
+    assert(OverflowQueue_size(queue) == ZERO);
+    assert(OverflowQueue_isEmpty(queue) == true);
+    assert(OverflowQueue_dropped(queue) == ZERO);
+    assert(OverflowQueue_tryDeq(queue) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that invalid sizes, unknown policies and NULL elements are refused.
+*/
+int invalidArgumentsAreRefused() {
+    assert(new_OverflowQueue(ZERO, OVERFLOW_BLOCK) == NULL);
+    assert(new_OverflowQueue(-1, OVERFLOW_DROP_NEWEST) == NULL);
+    assert(new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, -1) == NULL);
+    assert(new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_OVERWRITE_OLDEST + ONE) == NULL);
+
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_OVERWRITE_OLDEST);
+    assert(OverflowQueue_enq(queue, NULL) == false);
+    assert(OverflowQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that elements come out in order over several laps of the ring.
+*/
+int elementsComeOutInOrder() {
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_BLOCK);
+    for (intptr_t lap = ZERO; lap < THREE; lap++) {
+        for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+            assert(OverflowQueue_enq(queue, (void*)(lap * DEFAULT_MAX_QUEUE_SIZE + i)) == true);
+        }
+        assert(OverflowQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+        for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+            assert(OverflowQueue_deq(queue) == (void*)(lap * DEFAULT_MAX_QUEUE_SIZE + i));
+        }
+    }
+    assert(OverflowQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that drop-newest refuses elements on a full queue, keeps the oldest ones and counts the drops.
+*/
+int dropNewestKeepsTheOldest() {
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_DROP_NEWEST);
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(OverflowQueue_enq(queue, (void*)i) == true);
+    }
+    assert(OverflowQueue_enq(queue, (void*)(intptr_t)(DEFAULT_MAX_QUEUE_SIZE + ONE)) == false);
+    assert(OverflowQueue_enq(queue, (void*)(intptr_t)(DEFAULT_MAX_QUEUE_SIZE + TWO)) == false);
+    assert(OverflowQueue_dropped(queue) == TWO);
+    assert(OverflowQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(OverflowQueue_tryDeq(queue) == (void*)i);
+    }
+    assert(OverflowQueue_tryDeq(queue) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that overwrite-oldest always accepts elements, keeps the newest ones and counts the drops.
+*/
+int overwriteOldestKeepsTheNewest() {
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_OVERWRITE_OLDEST);
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE + THREE; i++) {
+        assert(OverflowQueue_enq(queue, (void*)i) == true);
+    }
+    assert(OverflowQueue_dropped(queue) == THREE);
+    assert(OverflowQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    for (intptr_t i = FOUR; i <= DEFAULT_MAX_QUEUE_SIZE + THREE; i++) {
+        assert(OverflowQueue_tryDeq(queue) == (void*)i);
+    }
+    assert(OverflowQueue_tryDeq(queue) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that an enq on a full blocking queue waits for a deq.
+*/
+int blockingEnqWaitsForSpace() {
+    intptr_t last = DEFAULT_MAX_QUEUE_SIZE + ONE;
+    pthread_t enqueuingThread;
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_BLOCK);
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(OverflowQueue_enq(queue, (void*)i) == true);
+    }
+
+    /** Waits until the enqueuing thread has gone to sleep on the full queue.*/
+    pthread_create(&enqueuingThread, NULL, enqueueThread, (void*)last);
+    while (atomic_load(&queue->waiting_producers) == ZERO) {
+        sched_yield();
+    }
+    assert(OverflowQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+
+    assert(OverflowQueue_deq(queue) == (void*)(intptr_t)ONE);
+    pthread_join(enqueuingThread, NULL);
+    assert(OverflowQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    assert(OverflowQueue_dropped(queue) == ZERO);
+    for (intptr_t i = TWO; i <= last; i++) {
+        assert(OverflowQueue_deq(queue) == (void*)i);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a deq on an empty queue waits for an enq, whatever the policy.
+*/
+int deqWaitsForEnq() {
+    int a = 1;
+    pthread_t dequeuingThread;
+    void *dequeuingThreadResult;
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_OVERWRITE_OLDEST);
+
+    pthread_create(&dequeuingThread, NULL, dequeueThread, NULL);
+    while (atomic_load(&queue->waiting_consumers) == ZERO) {
+        sched_yield();
+    }
+    assert(OverflowQueue_enq(queue, &a) == true);
+    pthread_join(dequeuingThread, &dequeuingThreadResult);
+    assert(dequeuingThreadResult == &a);
+    assert(OverflowQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that with concurrent overwriting producers and a consumer every element is either consumed or counted as
+ * dropped, exactly once.
+*/
+int overwriteAccountsForEveryElement() {
+    pthread_t producers[CONCURRENT_THREADS];
+    long consumed = ZERO;
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_OVERWRITE_OLDEST);
+    for (int i = ZERO; i < CONCURRENT_THREADS; i++) {
+        pthread_create(&producers[i], NULL, producerThread, NULL);
+    }
+    for (int i = ZERO; i < ELEMENTS_PER_THREAD; i++) {
+        if (OverflowQueue_tryDeq(queue) != NULL) {
+            consumed++;
+        }
+    }
+    for (int i = ZERO; i < CONCURRENT_THREADS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    while (OverflowQueue_tryDeq(queue) != NULL) {
+        consumed++;
+    }
+    assert(consumed + OverflowQueue_dropped(queue) == (long)CONCURRENT_THREADS * ELEMENTS_PER_THREAD);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that with concurrent blocking producers no element is lost nor duplicated.
+*/
+int blockingProducersLoseNothing() {
+    pthread_t producers[CONCURRENT_THREADS];
+    intptr_t sum = ZERO;
+    queue = new_OverflowQueue(DEFAULT_MAX_QUEUE_SIZE, OVERFLOW_BLOCK);
+    for (int i = ZERO; i < CONCURRENT_THREADS; i++) {
+        pthread_create(&producers[i], NULL, producerThread, NULL);
+    }
+    for (int i = ZERO; i < CONCURRENT_THREADS * ELEMENTS_PER_THREAD; i++) {
+        sum += (intptr_t)OverflowQueue_deq(queue);
+    }
+    for (int i = ZERO; i < CONCURRENT_THREADS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    assert(sum == (intptr_t)CONCURRENT_THREADS * ELEMENTS_PER_THREAD * (ELEMENTS_PER_THREAD + ONE) / TWO);
+    assert(OverflowQueue_dropped(queue) == ZERO);
+    assert(OverflowQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the OverflowQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(invalidArgumentsAreRefused);
+
+    runTest(elementsComeOutInOrder);
+
+    runTest(dropNewestKeepsTheOldest);
+
+    runTest(overwriteOldestKeepsTheNewest);
+
+    runTest(blockingEnqWaitsForSpace);
+
+    runTest(deqWaitsForEnq);
+
+    runTest(overwriteAccountsForEveryElement);
+
+    runTest(blockingProducersLoseNothing);
+
+    printf("\nOverflowQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
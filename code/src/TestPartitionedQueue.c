@@ -0,0 +1,296 @@
+/*
+ * TestPartitionedQueue.c
+ *
+ * Very simple unit test file for PartitionedQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "PartitionedQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_QUEUE_SIZE 8
+
+/** Number of keys, of elements per key and of consumers in the concurrent test.*/
+#define KEYS 16
+#define ELEMENTS_PER_KEY 2000
+#define CONSUMERS 4
+
+/** Key of the elements telling the consumers of the concurrent test to stop, one key per consumer from this one.*/
+#define STOP_KEY 1000000
+
+/*
+ * The queue to use during tests
+ */
+static PartitionedQueue *queue;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+/*
+ * State of the concurrent test: the last element seen for each key, whether a consumer is processing the key, and the
+ * number of ordering or exclusion violations.
+ */
+static intptr_t last_seen[KEYS];
+static _Atomic int in_progress[KEYS];
+static _Atomic int violations;
+static _Atomic int processed;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    queue = new_PartitionedQueue(DEFAULT_MAX_QUEUE_SIZE);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    PartitionedQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Thread dequeuing one element, releasing its key and returning the element.
+*/
+void* dequeueThread(void* unused) {
+    (void)unused;
+    uint64_t key;
+    void *element = PartitionedQueue_deq(queue, &key);
+    PartitionedQueue_done(queue, key);
+    return element;
+}
+
+/**
+ * Thread enqueuing the element passed as argument under key 0.
+*/
+void* enqueueThread(void* element) {
+    PartitionedQueue_enq(queue, ZERO, element);
+    return NULL;
+}
+
+/**
+ * Consumer of the concurrent test: checks that each key comes in order and is never processed by two consumers at once.
+*/
+void* consumerThread(void* unused) {
+    (void)unused;
+    while (true) {
+        uint64_t key;
+        intptr_t element = (intptr_t)PartitionedQueue_deq(queue, &key);
+        if (key >= STOP_KEY) {
+            PartitionedQueue_done(queue, key);
+            return NULL;
+        }
+        if (atomic_exchange(&in_progress[key], ONE) != ZERO) {
+            atomic_fetch_add(&violations, ONE);
+        }
+        if (element != last_seen[key] + ONE) {
+            atomic_fetch_add(&violations, ONE);
+        }
+        last_seen[key] = element;
+        sched_yield();
+        atomic_store(&in_progress[key], ZERO);
+        PartitionedQueue_done(queue, key);
+        atomic_fetch_add(&processed, ONE);
+    }
+}
+
+
+/*
+ * Checks that the constructor returns an empty queue, and refuses invalid sizes and NULL elements.
+ */
+int newQueueIsEmpty() {
+    uint64_t key;
+    assert(queue != NULL);
+    assert(new_PartitionedQueue(ZERO) == NULL);
+    assert(new_PartitionedQueue(-1) == NULL);
+    assert(PartitionedQueue_isEmpty(queue) == true);
+    assert(PartitionedQueue_tryDeq(queue, &key) == NULL);
+    assert(PartitionedQueue_enq(queue, ONE, NULL) == false);
+    assert(PartitionedQueue_done(queue, ONE) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the elements of one key come out in FIFO order.
+*/
+int oneKeyComesOutInOrder() {
+    uint64_t key;
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(PartitionedQueue_enq(queue, 42, (void*)i) == true);
+    }
+    assert(PartitionedQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(PartitionedQueue_deq(queue, &key) == (void*)i);
+        assert(key == 42);
+        assert(PartitionedQueue_done(queue, key) == true);
+    }
+    assert(PartitionedQueue_done(queue, 42) == false);
+    assert(PartitionedQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a held key delivers nothing until done, while other keys keep being delivered.
+*/
+int heldKeyWaitsForDone() {
+    uint64_t key;
+    PartitionedQueue_enq(queue, 1, (void*)(intptr_t)11);
+    PartitionedQueue_enq(queue, 1, (void*)(intptr_t)12);
+    PartitionedQueue_enq(queue, 2, (void*)(intptr_t)21);
+
+    assert(PartitionedQueue_tryDeq(queue, &key) == (void*)(intptr_t)11);
+    assert(key == 1);
+    assert(PartitionedQueue_tryDeq(queue, &key) == (void*)(intptr_t)21);
+    assert(key == 2);
+
+    /** Key 1 still has an element, but it is held.*/
+    assert(PartitionedQueue_tryDeq(queue, &key) == NULL);
+    assert(PartitionedQueue_size(queue) == ONE);
+
+    /** Elements for a held key wait behind its holder too.*/
+    PartitionedQueue_enq(queue, 2, (void*)(intptr_t)22);
+    assert(PartitionedQueue_tryDeq(queue, &key) == NULL);
+
+    assert(PartitionedQueue_done(queue, 2) == true);
+    assert(PartitionedQueue_done(queue, 1) == true);
+    assert(PartitionedQueue_tryDeq(queue, &key) == (void*)(intptr_t)22);
+    assert(PartitionedQueue_tryDeq(queue, &key) == (void*)(intptr_t)12);
+    assert(PartitionedQueue_done(queue, 1) == true);
+    assert(PartitionedQueue_done(queue, 2) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that keys are delivered in the order they became ready.
+*/
+int keysAreDeliveredInReadyOrder() {
+    uint64_t key;
+    for (uint64_t k = 5; k >= ONE; k--) {
+        PartitionedQueue_enq(queue, k, (void*)(intptr_t)k);
+    }
+    for (uint64_t k = 5; k >= ONE; k--) {
+        assert(PartitionedQueue_tryDeq(queue, &key) == (void*)(intptr_t)k);
+        assert(key == k);
+    }
+    for (uint64_t k = ONE; k <= 5; k++) {
+        assert(PartitionedQueue_done(queue, k) == true);
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a consumer blocked behind a held key is woken by done, and that a producer blocked on a full queue is
+ * woken by a deq.
+*/
+int blockedThreadsAreWoken() {
+    uint64_t key;
+    pthread_t dequeuingThread, enqueuingThread;
+    void *result;
+    PartitionedQueue_enq(queue, 7, (void*)(intptr_t)ONE);
+    PartitionedQueue_enq(queue, 7, (void*)(intptr_t)TWO);
+    assert(PartitionedQueue_deq(queue, &key) == (void*)(intptr_t)ONE);
+
+    pthread_create(&dequeuingThread, NULL, dequeueThread, NULL);
+    sched_yield();
+    assert(PartitionedQueue_done(queue, 7) == true);
+    pthread_join(dequeuingThread, &result);
+    assert(result == (void*)(intptr_t)TWO);
+
+    for (intptr_t i = ONE; i <= DEFAULT_MAX_QUEUE_SIZE; i++) {
+        PartitionedQueue_enq(queue, (uint64_t)i, (void*)i);
+    }
+    pthread_create(&enqueuingThread, NULL, enqueueThread, (void*)(intptr_t)100);
+    sched_yield();
+    assert(PartitionedQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    assert(PartitionedQueue_deq(queue, &key) == (void*)(intptr_t)ONE);
+    pthread_join(enqueuingThread, NULL);
+    assert(PartitionedQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that with several consumers every key is delivered in order and never processed concurrently.
+*/
+int consumersKeepPerKeyOrder() {
+    pthread_t consumers[CONSUMERS];
+    for (int k = ZERO; k < KEYS; k++) {
+        last_seen[k] = ZERO;
+        atomic_store(&in_progress[k], ZERO);
+    }
+    atomic_store(&violations, ZERO);
+    atomic_store(&processed, ZERO);
+    for (int i = ZERO; i < CONSUMERS; i++) {
+        pthread_create(&consumers[i], NULL, consumerThread, NULL);
+    }
+    for (intptr_t i = ONE; i <= ELEMENTS_PER_KEY; i++) {
+        for (uint64_t k = ZERO; k < KEYS; k++) {
+            PartitionedQueue_enq(queue, k, (void*)i);
+        }
+    }
+
+    /** Stops the consumers once every element was processed, so that none stops while another key still has elements.*/
+    while (atomic_load(&processed) < KEYS * ELEMENTS_PER_KEY) {
+        sched_yield();
+    }
+    for (int i = ZERO; i < CONSUMERS; i++) {
+        PartitionedQueue_enq(queue, STOP_KEY + i, (void*)(intptr_t)ONE);
+    }
+    for (int i = ZERO; i < CONSUMERS; i++) {
+        pthread_join(consumers[i], NULL);
+    }
+    assert(atomic_load(&violations) == ZERO);
+    for (int k = ZERO; k < KEYS; k++) {
+        assert(last_seen[k] == ELEMENTS_PER_KEY);
+    }
+    assert(PartitionedQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the PartitionedQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsEmpty);
+
+    runTest(oneKeyComesOutInOrder);
+
+    runTest(heldKeyWaitsForDone);
+
+    runTest(keysAreDeliveredInReadyOrder);
+
+    runTest(blockedThreadsAreWoken);
+
+    runTest(consumersKeepPerKeyOrder);
+
+    printf("\nPartitionedQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
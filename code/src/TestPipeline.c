@@ -0,0 +1,304 @@
+/*
+ * TestPipeline.c
+ *
+ * Very simple unit test file for Pipeline functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "Pipeline.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_STAGES 3
+#define DEFAULT_CAPACITY 4
+
+/** Number of items submitted by the streaming tests.*/
+#define STREAM_ITEMS 5000
+
+/*
+ * The pipeline to use during tests
+ */
+static Pipeline *pipeline;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    pipeline = new_Pipeline(DEFAULT_MAX_STAGES);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    Pipeline_destroy(pipeline);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/*
+ * State shared by the sink stages of the tests.
+ */
+typedef struct Sink {
+    /** Number of items received, their sum and the last item received.*/
+    _Atomic long count, sum;
+    intptr_t last;
+    /** Set when an item arrived out of order.*/
+    bool out_of_order;
+} Sink;
+
+/**
+ * Stage adding one to the item.
+*/
+static void* increment(void* item, void* context) {
+    (void)context;
+    return (void*)((intptr_t)item + ONE);
+}
+
+/**
+ * Stage dropping odd items.
+*/
+static void* keepEven(void* item, void* context) {
+    (void)context;
+    return ((intptr_t)item % TWO == ZERO) ? item : NULL;
+}
+
+/**
+ * Last stage counting and summing the items into its Sink, and checking they arrive in increasing order.
+*/
+static void* collect(void* item, void* context) {
+    Sink *sink = context;
+    if ((intptr_t)item <= sink->last) {
+        sink->out_of_order = true;
+    }
+    sink->last = (intptr_t)item;
+    atomic_fetch_add(&sink->count, ONE);
+    atomic_fetch_add(&sink->sum, (intptr_t)item);
+    return NULL;
+}
+
+/**
+ * Last stage counting and summing the items into its Sink, for sinks run by several threads.
+*/
+static void* collectUnordered(void* item, void* context) {
+    Sink *sink = context;
+    atomic_fetch_add(&sink->count, ONE);
+    atomic_fetch_add(&sink->sum, (intptr_t)item);
+    return NULL;
+}
+
+/**
+ * Stage waiting on the semaphore given as context before passing the item on.
+*/
+static void* waitForGate(void* item, void* context) {
+    sem_wait((sem_t*)context);
+    return item;
+}
+
+
+/*
+ * Checks that the Pipeline constructor returns a non-NULL pointer.
+ */
+int newPipelineIsNotNull() {
+    assert(pipeline != NULL);
+    assert(new_Pipeline(ZERO) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that stages with invalid parameters, or beyond max_stages, are refused.
+*/
+int invalidStagesAreRefused() {
+    assert(Pipeline_addStage(pipeline, NULL, NULL, ONE, DEFAULT_CAPACITY) == false);
+    assert(Pipeline_addStage(pipeline, increment, NULL, ZERO, DEFAULT_CAPACITY) == false);
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, ZERO) == false);
+    for (int i = ZERO; i < DEFAULT_MAX_STAGES; i++) {
+        assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == true);
+    }
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a Pipeline cannot be started without stages, and that stages cannot be added once it is started.
+*/
+int startRules() {
+    assert(Pipeline_start(pipeline) == false);
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_start(pipeline) == true);
+    assert(Pipeline_start(pipeline) == false);
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that single-threaded neighbours are connected by SPSC queues and the others by MPMC queues.
+*/
+int edgeKindsFollowThreadCounts() {
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_addStage(pipeline, increment, NULL, THREE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_edgeKind(pipeline, ZERO) == PIPELINE_EDGE_SPSC);
+    assert(Pipeline_edgeKind(pipeline, ONE) == PIPELINE_EDGE_MPMC);
+    assert(Pipeline_edgeKind(pipeline, TWO) == PIPELINE_EDGE_MPMC);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that NULL items, and items submitted before start or after drain, are refused.
+*/
+int submitRules() {
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_submit(pipeline, (void*)(intptr_t)ONE) == false);
+    assert(Pipeline_start(pipeline) == true);
+    assert(Pipeline_submit(pipeline, NULL) == false);
+    assert(Pipeline_submit(pipeline, (void*)(intptr_t)ONE) == true);
+    Pipeline_drain(pipeline);
+    Pipeline_drain(pipeline);
+    assert(Pipeline_submit(pipeline, (void*)(intptr_t)ONE) == false);
+    assert(Pipeline_processed(pipeline, ZERO) == ONE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a chain of single-threaded stages delivers every item, in order, before drain returns.
+*/
+int chainKeepsOrder() {
+    Sink sink = {ZERO, ZERO, ZERO, false};
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_addStage(pipeline, increment, NULL, ONE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_addStage(pipeline, collect, &sink, ONE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_start(pipeline) == true);
+
+    for (intptr_t i = ONE; i <= STREAM_ITEMS; i++) {
+        assert(Pipeline_submit(pipeline, (void*)i) == true);
+    }
+    Pipeline_drain(pipeline);
+
+    assert(atomic_load(&sink.count) == STREAM_ITEMS);
+    assert(atomic_load(&sink.sum) == (long)STREAM_ITEMS * (STREAM_ITEMS + ONE) / TWO + TWO * STREAM_ITEMS);
+    assert(sink.out_of_order == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that parallel stages and filtering stages deliver every kept item before drain returns.
+*/
+int parallelStagesDrainEverything() {
+    Sink sink = {ZERO, ZERO, ZERO, false};
+    assert(Pipeline_addStage(pipeline, increment, NULL, FOUR, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_addStage(pipeline, keepEven, NULL, THREE, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_addStage(pipeline, collectUnordered, &sink, TWO, DEFAULT_CAPACITY) == true);
+    assert(Pipeline_start(pipeline) == true);
+
+    /** Items 1 to STREAM_ITEMS become 2 to STREAM_ITEMS + 1, of which the even ones are kept.*/
+    long expected_count = ZERO, expected_sum = ZERO;
+    for (intptr_t i = ONE; i <= STREAM_ITEMS; i++) {
+        assert(Pipeline_submit(pipeline, (void*)i) == true);
+        if ((i + ONE) % TWO == ZERO) {
+            expected_count++;
+            expected_sum += i + ONE;
+        }
+    }
+    Pipeline_drain(pipeline);
+
+    assert(Pipeline_processed(pipeline, ZERO) == STREAM_ITEMS);
+    assert(Pipeline_processed(pipeline, ONE) == STREAM_ITEMS);
+    assert(atomic_load(&sink.count) == expected_count);
+    assert(atomic_load(&sink.sum) == expected_sum);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Thread submitting items 1 to 4 to the pipeline, then counting them as submitted.
+*/
+void* submitThread(void* submitted) {
+    for (intptr_t i = ONE; i <= FOUR; i++) {
+        Pipeline_submit(pipeline, (void*)i);
+        atomic_fetch_add((_Atomic int*)submitted, ONE);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Checks that a blocked stage stops the submitting thread once the queues before it are full.
+*/
+int slowStageBlocksSubmitter() {
+    sem_t gate;
+    sem_init(&gate, ZERO, ZERO);
+    Sink sink = {ZERO, ZERO, ZERO, false};
+    assert(Pipeline_addStage(pipeline, waitForGate, &gate, ONE, ONE) == true);
+    assert(Pipeline_addStage(pipeline, collect, &sink, ONE, ONE) == true);
+    assert(Pipeline_start(pipeline) == true);
+
+    /** The gated worker holds one item and its queue holds another, so the third submit blocks.*/
+    _Atomic int submitted = ZERO;
+    pthread_t submitter;
+    pthread_create(&submitter, NULL, submitThread, &submitted);
+    sleep(1);
+    assert(atomic_load(&submitted) == TWO);
+
+    /** Opening the gate lets every item through.*/
+    for (int i = ZERO; i < FOUR; i++) {
+        sem_post(&gate);
+    }
+    pthread_join(submitter, NULL);
+    Pipeline_drain(pipeline);
+    assert(atomic_load(&sink.count) == FOUR);
+    sem_destroy(&gate);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the Pipeline tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newPipelineIsNotNull);
+
+    runTest(invalidStagesAreRefused);
+
+    runTest(startRules);
+
+    runTest(edgeKindsFollowThreadCounts);
+
+    runTest(submitRules);
+
+    runTest(chainKeepsOrder);
+
+    runTest(parallelStagesDrainEverything);
+
+    runTest(slowStageBlocksSubmitter);
+
+    printf("\nPipeline Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
@@ -458,6 +458,43 @@ int enqAndDeqString() {
     return TEST_SUCCESS;
 }
 
+/**
+ * Checks that a Queue initialized over caller storage sized at compile time works like an allocated one.
+*/
+int initOnCallerStorage() {
+    /** Both the Queue and its slots live on the stack.*/
+    Queue stack_queue;
+    void *storage[QUEUE_STORAGE_SIZE(THREE) / sizeof(void*)];
+    int elements[] = {1, 2, 3};
+
+    assert(Queue_storageSize(THREE) == sizeof(storage));
+    assert(Queue_init(&stack_queue, THREE, storage) == true);
+    for (int i = ZERO; i < THREE; i++) {
+        assert(Queue_enq(&stack_queue, &elements[i]) == true);
+    }
+    assert(Queue_enq(&stack_queue, &elements[ZERO]) == false);
+    for (int i = ZERO; i < THREE; i++) {
+        assert(Queue_deq(&stack_queue) == &elements[i]);
+    }
+    assert(Queue_isEmpty(&stack_queue) == true);
+    Queue_deinit(&stack_queue);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that Queue_init refuses missing memory and invalid sizes.
+*/
+int initRejectsInvalidArguments() {
+    Queue stack_queue;
+    void *storage[ONE];
+    assert(Queue_storageSize(ZERO) == ZERO);
+    assert(Queue_storageSize(-1) == ZERO);
+    assert(Queue_init(&stack_queue, ZERO, storage) == false);
+    assert(Queue_init(&stack_queue, ONE, NULL) == false);
+    assert(Queue_init(NULL, ONE, storage) == false);
+    return TEST_SUCCESS;
+}
+
 /*
  * Main function for the Queue tests which will run each user-defined test in turn.
  */
@@ -512,6 +549,10 @@ int main() {
 
     runTest(enqAndDeqString);
 
+    runTest(initOnCallerStorage);
+
+    runTest(initRejectsInvalidArguments);
+
     printf("Queue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
 
 }
@@ -0,0 +1,279 @@
+/*
+ * TestReorderBuffer.c
+ *
+ * Very simple unit test file for ReorderBuffer functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "ReorderBuffer.h"
+#include "BlockingQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_WINDOW_SIZE 4
+
+/** Number of workers, size of the work queue, window and number of items in the fan-out test.*/
+#define WORKERS 16
+#define WORK_QUEUE_SIZE 8
+#define FAN_OUT_WINDOW 32
+#define FAN_OUT_ITEMS 20000
+
+/** Work item telling a worker of the fan-out test to stop.*/
+#define STOP_ITEM ((void*)(intptr_t)-1)
+
+/*
+ * The reorder buffer and the work queue to use during tests
+ */
+static ReorderBuffer *buffer;
+static BlockingQueue *work;
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    buffer = new_ReorderBuffer(DEFAULT_WINDOW_SIZE);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    ReorderBuffer_destroy(buffer);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Thread stamping one sequence number and returning it.
+*/
+void* stampThread(void* unused) {
+    (void)unused;
+    return (void*)(intptr_t)ReorderBuffer_nextSequence(buffer);
+}
+
+/**
+ * Thread dequeuing one result and returning it.
+*/
+void* sinkThread(void* unused) {
+    (void)unused;
+    return ReorderBuffer_deq(buffer);
+}
+
+/**
+ * Producer of the fan-out test: stamps every item and hands it to the workers, carrying its sequence number plus one.
+*/
+void* producerThread(void* unused) {
+    (void)unused;
+    for (int i = ZERO; i < FAN_OUT_ITEMS; i++) {
+        uint64_t sequence = ReorderBuffer_nextSequence(buffer);
+        BlockingQueue_enq(work, (void*)(intptr_t)(sequence + ONE));
+    }
+    for (int i = ZERO; i < WORKERS; i++) {
+        BlockingQueue_enq(work, STOP_ITEM);
+    }
+    return NULL;
+}
+
+/**
+ * Worker of the fan-out test: takes items and submits them back, yielding a varying number of times so that they finish
+ * out of order.
+*/
+void* workerThread(void* seed) {
+    unsigned int state = (unsigned int)(intptr_t)seed;
+    while (true) {
+        void *item = BlockingQueue_deq(work);
+        if (item == STOP_ITEM) {
+            return NULL;
+        }
+        for (int yields = rand_r(&state) % FOUR; yields > ZERO; yields--) {
+            sched_yield();
+        }
+        ReorderBuffer_submit(buffer, (uint64_t)(intptr_t)item - ONE, item);
+    }
+}
+
+
+/*
+ * Checks that the constructor returns an empty buffer, and refuses an invalid window.
+ */
+int newBufferIsEmpty() {
+    assert(buffer != NULL);
+    assert(new_ReorderBuffer(ZERO) == NULL);
+    assert(new_ReorderBuffer(-1) == NULL);
+    assert(ReorderBuffer_inFlight(buffer) == ZERO);
+    assert(ReorderBuffer_tryDeq(buffer) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that results submitted out of order come out in sequence order, the sink waiting for the oldest one.
+*/
+int resultsComeOutInSequenceOrder() {
+    intptr_t results[] = {10, 11, 12, 13};
+    for (uint64_t i = ZERO; i < DEFAULT_WINDOW_SIZE; i++) {
+        assert(ReorderBuffer_nextSequence(buffer) == i);
+    }
+    assert(ReorderBuffer_submit(buffer, 3, &results[3]) == true);
+    assert(ReorderBuffer_submit(buffer, 1, &results[1]) == true);
+    assert(ReorderBuffer_submit(buffer, 2, &results[2]) == true);
+    assert(ReorderBuffer_tryDeq(buffer) == NULL);
+
+    assert(ReorderBuffer_submit(buffer, ZERO, &results[ZERO]) == true);
+    for (int i = ZERO; i < DEFAULT_WINDOW_SIZE; i++) {
+        assert(ReorderBuffer_deq(buffer) == &results[i]);
+    }
+    assert(ReorderBuffer_inFlight(buffer) == ZERO);
+
+    /** Sequence numbers go on over the reused slots.*/
+    assert(ReorderBuffer_nextSequence(buffer) == DEFAULT_WINDOW_SIZE);
+    assert(ReorderBuffer_submit(buffer, DEFAULT_WINDOW_SIZE, &results[ZERO]) == true);
+    assert(ReorderBuffer_deq(buffer) == &results[ZERO]);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that NULL results, sequence numbers not in flight and second submissions are refused.
+*/
+int invalidSubmissionsAreRefused() {
+    int a = 1;
+    assert(ReorderBuffer_submit(buffer, ZERO, &a) == false);
+    assert(ReorderBuffer_nextSequence(buffer) == ZERO);
+    assert(ReorderBuffer_submit(buffer, ZERO, NULL) == false);
+    assert(ReorderBuffer_submit(buffer, ONE, &a) == false);
+    assert(ReorderBuffer_submit(buffer, ZERO, &a) == true);
+    assert(ReorderBuffer_submit(buffer, ZERO, &a) == false);
+    assert(ReorderBuffer_deq(buffer) == &a);
+    assert(ReorderBuffer_submit(buffer, ZERO, &a) == false);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that stamping blocks while the window is full, until the sink dequeues the oldest item.
+*/
+int fullWindowBlocksStamping() {
+    int a = 1;
+    pthread_t stampingThread;
+    void *sequence;
+    for (int i = ZERO; i < DEFAULT_WINDOW_SIZE; i++) {
+        ReorderBuffer_nextSequence(buffer);
+    }
+    assert(ReorderBuffer_inFlight(buffer) == DEFAULT_WINDOW_SIZE);
+
+    pthread_create(&stampingThread, NULL, stampThread, NULL);
+    while (atomic_load(&buffer->waiting_producers) == ZERO) {
+        sched_yield();
+    }
+
+    /** Later results do not free the window, only the sink moving past the oldest one does.*/
+    assert(ReorderBuffer_submit(buffer, ONE, &a) == true);
+    assert(ReorderBuffer_inFlight(buffer) == DEFAULT_WINDOW_SIZE);
+    assert(ReorderBuffer_submit(buffer, ZERO, &a) == true);
+    assert(ReorderBuffer_deq(buffer) == &a);
+    pthread_join(stampingThread, &sequence);
+    assert(sequence == (void*)(intptr_t)DEFAULT_WINDOW_SIZE);
+    assert(ReorderBuffer_inFlight(buffer) == DEFAULT_WINDOW_SIZE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a sink waiting for the oldest result is not woken by later ones, and is woken by the oldest one.
+*/
+int sinkWaitsForTheOldestResult() {
+    int a = 1, b = 2;
+    pthread_t sink;
+    void *result;
+    ReorderBuffer_nextSequence(buffer);
+    ReorderBuffer_nextSequence(buffer);
+    pthread_create(&sink, NULL, sinkThread, NULL);
+    while (atomic_load(&buffer->sink_waiting) == ZERO) {
+        sched_yield();
+    }
+    assert(ReorderBuffer_submit(buffer, ONE, &b) == true);
+    sched_yield();
+    assert(atomic_load(&buffer->sink_waiting) == ONE);
+    assert(ReorderBuffer_submit(buffer, ZERO, &a) == true);
+    pthread_join(sink, &result);
+    assert(result == &a);
+    assert(ReorderBuffer_deq(buffer) == &b);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that items fanned out from a BlockingQueue to many workers come back in input order.
+*/
+int fanOutRestoresInputOrder() {
+    pthread_t producer, workers[WORKERS];
+    ReorderBuffer *fixed = buffer;
+    buffer = new_ReorderBuffer(FAN_OUT_WINDOW);
+    work = new_BlockingQueue(WORK_QUEUE_SIZE);
+    pthread_create(&producer, NULL, producerThread, NULL);
+    for (int i = ZERO; i < WORKERS; i++) {
+        pthread_create(&workers[i], NULL, workerThread, (void*)(intptr_t)(i + ONE));
+    }
+
+    int out_of_order = ZERO;
+    for (intptr_t i = ONE; i <= FAN_OUT_ITEMS; i++) {
+        if (ReorderBuffer_deq(buffer) != (void*)i) {
+            out_of_order++;
+        }
+        assert(ReorderBuffer_inFlight(buffer) <= FAN_OUT_WINDOW);
+    }
+    pthread_join(producer, NULL);
+    for (int i = ZERO; i < WORKERS; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    BlockingQueue_destroy(work);
+    ReorderBuffer_destroy(buffer);
+    buffer = fixed;
+    assert(out_of_order == ZERO);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the ReorderBuffer tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newBufferIsEmpty);
+
+    runTest(resultsComeOutInSequenceOrder);
+
+    runTest(invalidSubmissionsAreRefused);
+
+    runTest(fullWindowBlocksStamping);
+
+    runTest(sinkWaitsForTheOldestResult);
+
+    runTest(fanOutRestoresInputOrder);
+
+    printf("\nReorderBuffer Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}
@@ -0,0 +1,482 @@
+/*
+ * TestSharedBlockingQueue.c
+ *
+ * Very simple unit test file for SharedBlockingQueue functionality.
+ *
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "SharedBlockingQueue.h"
+#include "myassert.h"
+
+
+#define DEFAULT_MAX_QUEUE_SIZE 20
+
+/** Number of records exchanged by the cross-process tests, larger than the capacity so that the producer blocks.*/
+#define CROSS_PROCESS_RECORDS 1000
+
+/*
+ * Fixed-size record exchanged through the queue during tests.
+ */
+typedef struct TestRecord {
+    int sequence;
+    double value;
+    char label[16];
+} TestRecord;
+
+/*
+ * The queue to use during tests
+ */
+static SharedBlockingQueue *queue;
+
+/*
+ * The name of the shared memory object backing the queue
+ */
+static char queue_name[64];
+
+/*
+ * The number of tests that succeeded
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run
+ */
+static int total_count = 0;
+
+
+/*
+ * Setup function to run prior to each test
+ */
+void setup(){
+    snprintf(queue_name, sizeof(queue_name), "/TestSharedBlockingQueue.%d", (int)getpid());
+    queue = new_SharedBlockingQueue(queue_name, DEFAULT_MAX_QUEUE_SIZE, sizeof(TestRecord));
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test
+ */
+void teardown(){
+    SharedBlockingQueue_destroy(queue);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function
+ */
+void runTest(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/**
+ * Fills the given record with values derived from the sequence number.
+*/
+static void makeRecord(TestRecord *record, int sequence) {
+    memset(record, ZERO, sizeof(TestRecord));
+    record->sequence = sequence;
+    record->value = sequence * 0.5;
+    snprintf(record->label, sizeof(record->label), "record-%d", sequence);
+}
+
+/**
+ * Returns true if the given record holds the values derived from the sequence number.
+*/
+static bool isRecord(TestRecord *record, int sequence) {
+    TestRecord expected;
+    makeRecord(&expected, sequence);
+    return memcmp(record, &expected, sizeof(TestRecord)) == ZERO;
+}
+
+
+/*
+ * Checks that the SharedBlockingQueue constructor returns a non-NULL pointer.
+ */
+int newQueueIsNotNull() {
+    assert(queue != NULL);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the size of an empty shared queue is 0.
+ */
+int newQueueSizeZero() {
+    assert(SharedBlockingQueue_size(queue) == 0);
+    assert(SharedBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that invalid capacities and record sizes are refused.
+*/
+int invalidQueuesAreNull() {
+    assert(new_SharedBlockingQueue("/TestSharedBlockingQueue.invalid", ZERO, sizeof(TestRecord)) == NULL);
+    assert(new_SharedBlockingQueue("/TestSharedBlockingQueue.invalid", -1, sizeof(TestRecord)) == NULL);
+    assert(new_SharedBlockingQueue("/TestSharedBlockingQueue.invalid", DEFAULT_MAX_QUEUE_SIZE, ZERO) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a second queue cannot be created under the name of an existing one.
+*/
+int duplicateNameIsRefused() {
+    assert(new_SharedBlockingQueue(queue_name, DEFAULT_MAX_QUEUE_SIZE, sizeof(TestRecord)) == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that enqueueing NULL records or dequeueing into a NULL destination fails.
+*/
+int nullRecordsAreRefused() {
+    assert(SharedBlockingQueue_enq(queue, NULL) == false);
+    assert(SharedBlockingQueue_deq(queue, NULL) == false);
+    assert(SharedBlockingQueue_size(queue) == ZERO);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a record is copied in and out of the shared region.
+*/
+int enqAndDeqOneRecord() {
+    TestRecord in, out;
+    makeRecord(&in, 7);
+    assert(SharedBlockingQueue_enq(queue, &in) == true);
+    assert(SharedBlockingQueue_size(queue) == ONE);
+
+    /** Overwrite the source to show the queue holds its own copy.*/
+    makeRecord(&in, 8);
+    assert(SharedBlockingQueue_deq(queue, &out) == true);
+    assert(isRecord(&out, 7));
+    assert(SharedBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that records keep their FIFO order while the indexes wrap around the slot array.
+*/
+int recordsWrapAround() {
+    TestRecord record;
+    for (int i = ZERO; i < THREE * DEFAULT_MAX_QUEUE_SIZE; i++) {
+        makeRecord(&record, i);
+        assert(SharedBlockingQueue_enq(queue, &record) == true);
+        assert(SharedBlockingQueue_deq(queue, &record) == true);
+        assert(isRecord(&record, i));
+    }
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a second handle, mapped at a different address, sees the same queue.
+*/
+int openedHandleSharesQueue() {
+    SharedBlockingQueue *other = SharedBlockingQueue_open(queue_name);
+    assert(other != NULL);
+    assert(other->header != queue->header);
+
+    TestRecord record;
+    makeRecord(&record, 42);
+    assert(SharedBlockingQueue_enq(queue, &record) == true);
+    assert(SharedBlockingQueue_size(other) == ONE);
+    assert(SharedBlockingQueue_deq(other, &record) == true);
+    assert(isRecord(&record, 42));
+    assert(SharedBlockingQueue_isEmpty(queue) == true);
+
+    SharedBlockingQueue_close(other);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that opening a queue which does not exist fails.
+*/
+int openMissingQueueIsNull() {
+    assert(SharedBlockingQueue_open("/TestSharedBlockingQueue.missing") == NULL);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a child process producing records through its own handle is read in order by the parent.
+ *
+ * More records than the capacity are exchanged so the child blocks on the process-shared semaphore until the parent dequeues.
+*/
+int crossProcessProducerConsumer() {
+    pid_t child = fork();
+    assert(child >= ZERO);
+
+    if (child == ZERO) {
+        /** The child attaches to the queue by name and produces every record.*/
+        SharedBlockingQueue *producer = SharedBlockingQueue_open(queue_name);
+        if (producer == NULL) { _exit(EXIT_FAILURE);}
+        TestRecord record;
+        for (int i = ZERO; i < CROSS_PROCESS_RECORDS; i++) {
+            makeRecord(&record, i);
+            SharedBlockingQueue_enq(producer, &record);
+        }
+        SharedBlockingQueue_close(producer);
+        _exit(EXIT_SUCCESS);
+    }
+
+    /** The parent consumes every record and checks the order.*/
+    TestRecord record;
+    for (int i = ZERO; i < CROSS_PROCESS_RECORDS; i++) {
+        assert(SharedBlockingQueue_deq(queue, &record) == true);
+        assert(isRecord(&record, i));
+    }
+
+    int status;
+    assert(waitpid(child, &status, ZERO) == child);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    assert(SharedBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Locks the robust mutex from a child process and journals the given operation the way the queue does before modifying it.
+ *
+ * Used to simulate a process dying part-way through an operation: the child returns from this function holding the mutex
+ * and then terminates without unlocking it.
+*/
+static SharedBlockingQueueHeader* lockAsDyingProcess(SharedBlockingQueue *handle, int op) {
+    SharedBlockingQueueHeader *header = handle->header;
+    pthread_mutex_lock(&header->mutex);
+    header->pending_op = op;
+    header->pending_copied = false;
+    header->saved_front = header->front;
+    header->saved_rear = header->rear;
+    header->saved_size = header->current_size;
+    return header;
+}
+
+/**
+ * Forks a child which attaches to the queue, runs the given simulation and dies while holding the mutex.
+ * Returns true once the child has terminated.
+*/
+static bool runDyingProcess(void (*simulation)(SharedBlockingQueue *handle)) {
+    pid_t child = fork();
+    if (child == ZERO) {
+        SharedBlockingQueue *handle = SharedBlockingQueue_open(queue_name);
+        if (handle == NULL) { _exit(EXIT_FAILURE);}
+        simulation(handle);
+        _exit(EXIT_SUCCESS);
+    }
+    int status;
+    return child > ZERO && waitpid(child, &status, ZERO) == child;
+}
+
+/**
+ * Simulation of a process dying while holding the mutex outside of enq and deq (for instance in size).
+*/
+static void dieHoldingMutex(SharedBlockingQueue *handle) {
+    lockAsDyingProcess(handle, SHARED_BLOCKING_QUEUE_OP_NONE);
+}
+
+/**
+ * Simulation of a consumer dying in deq after copying the front record and partially moving the front.
+*/
+static void dieDuringDeq(SharedBlockingQueue *handle) {
+    sem_wait(&handle->header->full_slots);
+    SharedBlockingQueueHeader *header = lockAsDyingProcess(handle, SHARED_BLOCKING_QUEUE_OP_DEQ);
+    header->front = (header->front + ONE) % header->max_size;
+}
+
+/**
+ * Simulation of a producer dying in enq after copying its record but before committing the rear and size.
+*/
+static void dieDuringEnqAfterCopy(SharedBlockingQueue *handle) {
+    sem_wait(&handle->header->empty_slots);
+    SharedBlockingQueueHeader *header = lockAsDyingProcess(handle, SHARED_BLOCKING_QUEUE_OP_ENQ);
+    TestRecord record;
+    makeRecord(&record, 99);
+    int rear = (header->rear + ONE) % header->max_size;
+    memcpy((char*)header + header->slots_offset + rear * header->record_size, &record, sizeof(TestRecord));
+    header->pending_copied = true;
+    header->rear = rear;
+}
+
+/**
+ * Simulation of a producer dying in enq before its record was completely copied.
+*/
+static void dieDuringEnqBeforeCopy(SharedBlockingQueue *handle) {
+    sem_wait(&handle->header->empty_slots);
+    SharedBlockingQueueHeader *header = lockAsDyingProcess(handle, SHARED_BLOCKING_QUEUE_OP_ENQ);
+    header->rear = (header->rear + ONE) % header->max_size;
+}
+
+/**
+ * Simulation of a consumer which dequeued a record, then died right after locking the mutex again, before journaling.
+*/
+static void dieAfterDeqBeforeJournal(SharedBlockingQueue *handle) {
+    TestRecord record;
+    SharedBlockingQueue_deq(handle, &record);
+    pthread_mutex_lock(&handle->header->mutex);
+}
+
+/**
+ * Simulation of a producer which enqueued a record, then died right after locking the mutex again, before journaling.
+*/
+static void dieAfterEnqBeforeJournal(SharedBlockingQueue *handle) {
+    TestRecord record;
+    makeRecord(&record, 99);
+    SharedBlockingQueue_enq(handle, &record);
+    pthread_mutex_lock(&handle->header->mutex);
+}
+
+/**
+ * Checks that the queue keeps working after a process died holding the mutex.
+*/
+int recoversFromDeadOwner() {
+    TestRecord record;
+    makeRecord(&record, 1);
+    assert(SharedBlockingQueue_enq(queue, &record) == true);
+
+    assert(runDyingProcess(dieHoldingMutex));
+
+    assert(SharedBlockingQueue_size(queue) == ONE);
+    assert(SharedBlockingQueue_recoveries(queue) == ONE);
+    assert(SharedBlockingQueue_deq(queue, &record) == true);
+    assert(isRecord(&record, 1));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a record being dequeued by a consumer which died is handed to the next consumer.
+*/
+int recoversRecordFromDeadConsumer() {
+    TestRecord record;
+    for (int i = ZERO; i < TWO; i++) {
+        makeRecord(&record, i);
+        assert(SharedBlockingQueue_enq(queue, &record) == true);
+    }
+
+    assert(runDyingProcess(dieDuringDeq));
+
+    /** Both records are still available, in order, and every slot can still be filled.*/
+    assert(SharedBlockingQueue_size(queue) == TWO);
+    assert(SharedBlockingQueue_deq(queue, &record) == true);
+    assert(isRecord(&record, 0));
+    assert(SharedBlockingQueue_deq(queue, &record) == true);
+    assert(isRecord(&record, 1));
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        assert(SharedBlockingQueue_enq(queue, &record) == true);
+    }
+    assert(SharedBlockingQueue_size(queue) == DEFAULT_MAX_QUEUE_SIZE);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a record completely copied by a producer which died is committed.
+*/
+int commitsRecordFromDeadProducer() {
+    assert(runDyingProcess(dieDuringEnqAfterCopy));
+
+    TestRecord record;
+    assert(SharedBlockingQueue_size(queue) == ONE);
+    assert(SharedBlockingQueue_deq(queue, &record) == true);
+    assert(isRecord(&record, 99));
+    assert(SharedBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that the slot taken by a producer which died before copying its record is returned.
+*/
+int returnsSlotFromDeadProducer() {
+    assert(runDyingProcess(dieDuringEnqBeforeCopy));
+
+    assert(SharedBlockingQueue_isEmpty(queue) == true);
+
+    /** Every slot can still be filled, the next record is read back first.*/
+    TestRecord record;
+    for (int i = ZERO; i < DEFAULT_MAX_QUEUE_SIZE; i++) {
+        makeRecord(&record, i);
+        assert(SharedBlockingQueue_enq(queue, &record) == true);
+    }
+    assert(SharedBlockingQueue_deq(queue, &record) == true);
+    assert(isRecord(&record, 0));
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a finished dequeue is not replayed when the next owner of the mutex dies before journaling its own operation:
+ * the record already delivered is not delivered a second time.
+*/
+int finishedDeqIsNotReplayed() {
+    TestRecord record;
+    for (int i = ZERO; i < TWO; i++) {
+        makeRecord(&record, i);
+        assert(SharedBlockingQueue_enq(queue, &record) == true);
+    }
+
+    assert(runDyingProcess(dieAfterDeqBeforeJournal));
+
+    assert(SharedBlockingQueue_recoveries(queue) == ONE);
+    assert(SharedBlockingQueue_size(queue) == ONE);
+    assert(SharedBlockingQueue_deq(queue, &record) == true);
+    assert(isRecord(&record, 1));
+    assert(SharedBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/**
+ * Checks that a finished enqueue is not committed a second time when the next owner of the mutex dies before journaling.
+*/
+int finishedEnqIsNotReplayed() {
+    assert(runDyingProcess(dieAfterEnqBeforeJournal));
+
+    TestRecord record;
+    assert(SharedBlockingQueue_recoveries(queue) == ONE);
+    assert(SharedBlockingQueue_size(queue) == ONE);
+    assert(SharedBlockingQueue_deq(queue, &record) == true);
+    assert(isRecord(&record, 99));
+    assert(SharedBlockingQueue_isEmpty(queue) == true);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function for the SharedBlockingQueue tests which will run each user-defined test in turn.
+ */
+
+int main() {
+    runTest(newQueueIsNotNull);
+
+    runTest(newQueueSizeZero);
+
+    runTest(invalidQueuesAreNull);
+
+    runTest(duplicateNameIsRefused);
+
+    runTest(nullRecordsAreRefused);
+
+    runTest(enqAndDeqOneRecord);
+
+    runTest(recordsWrapAround);
+
+    runTest(openedHandleSharesQueue);
+
+    runTest(openMissingQueueIsNull);
+
+    runTest(crossProcessProducerConsumer);
+
+    runTest(recoversFromDeadOwner);
+
+    runTest(recoversRecordFromDeadConsumer);
+
+    runTest(commitsRecordFromDeadProducer);
+
+    runTest(returnsSlotFromDeadProducer);
+
+    runTest(finishedDeqIsNotReplayed);
+
+    runTest(finishedEnqIsNotReplayed);
+
+    printf("\nSharedBlockingQueue Tests complete: %d / %d tests successful.\n----------------\n", success_count, total_count);
+
+}